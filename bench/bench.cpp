@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "../source/host.h"
+#include "../source/vm.h"
+#include "../source/cart.h"
+#include "../source/codeCompression.h"
+#include "../source/filehelpers.h"
+#include "../source/frameConverter.h"
+#include "../source/profiling.h"
+
+//headless throughput benchmark. Runs each cart for a fixed number of frames
+//of UpdateAndDraw, frame conversion and audio fill as fast as possible and
+//prints the results as json, one object per cart.
+//
+//usage: benchrunner [--frames n] [--parse-runs n] [--json results.json] [cart.p8 ...]
+//with no carts given, every cart in ../test/carts and ../carts is run. Json
+//goes to stdout unless a file is given (carts can printh to stdout). Each cart
+//file is also parsed --parse-runs times on its own to time cart loading.
+//
+//benchrunner --decompress [--decompress-runs n] [--json results.json] [cart.png ...]
+//instead times decompressing the lua of each png cart (all of ../test/carts by
+//default) and reports MB/s of decompressed code
+
+typedef chrono::steady_clock benchClock;
+
+struct BenchResult {
+    string cart;
+    string error;
+    int frames;
+    double parseUs;
+    double totalMs;
+    double luaMs;
+    double graphicsMs;
+    double otherApiMs;
+    double presentMs;
+    double audioMs;
+    double rewindMs;
+    vector<double> frameUs;
+};
+
+static double elapsedMs(benchClock::time_point start, benchClock::time_point end) {
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+static vector<string> listCartsInDirectory(string directory) {
+    vector<string> carts;
+
+    DIR *dir;
+    struct dirent *ent;
+    if ((dir = opendir(directory.c_str())) != NULL) {
+        while ((ent = readdir(dir)) != NULL) {
+            string name = ent->d_name;
+            if (isCartFile(name) && !isHiddenFile(name)) {
+                carts.push_back(directory + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+
+    sort(carts.begin(), carts.end());
+
+    return carts;
+}
+
+static double percentile(vector<double> sorted, double p) {
+    if (sorted.size() == 0) {
+        return 0;
+    }
+    size_t idx = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+static string jsonEscape(const string& str) {
+    string result;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        }
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        }
+        else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+//average time to read and parse the cart file, without starting lua
+static double timeCartParse(string cart, int runs) {
+    if (runs <= 0) {
+        return 0;
+    }
+
+    auto start = benchClock::now();
+    for (int i = 0; i < runs; i++) {
+        Cart* parsed = new Cart(cart, "");
+        delete parsed;
+    }
+
+    return elapsedMs(start, benchClock::now()) * 1000.0 / runs;
+}
+
+static BenchResult runCart(Host* host, string cart, int frames, int parseRuns) {
+    BenchResult result;
+    result.cart = cart;
+    result.parseUs = timeCartParse(cart, parseRuns);
+    result.frames = 0;
+    result.totalMs = 0;
+    result.luaMs = 0;
+    result.graphicsMs = 0;
+    result.otherApiMs = 0;
+    result.presentMs = 0;
+    result.audioMs = 0;
+    result.rewindMs = 0;
+
+    Vm* vm = new Vm(host);
+    vm->LoadCart(cart, false);
+    result.error = vm->GetBiosError();
+
+    FrameConverter<uint32_t> converter;
+    converter.setHostColors(host->GetPaletteColors(), colorToArgb8888);
+    vector<uint32_t> screen(128 * 128);
+    vector<uint32_t> audioBuffer(22050 / 30);
+
+    for (int i = 0; i < frames && result.error.length() == 0; i++) {
+        auto frameStart = benchClock::now();
+        vm->UpdateAndDraw();
+        auto updateEnd = benchClock::now();
+
+        converter.convertFrame(
+            vm->GetPicoInteralFb(),
+            vm->GetScreenPaletteMap(),
+            &screen[0],
+            128 * sizeof(uint32_t),
+            FrameTransform_None,
+            vm->GetAltScreenPaletteMap(),
+            vm->GetAltScreenPaletteLines());
+        auto presentEnd = benchClock::now();
+
+        size_t samples = 22050 / vm->GetTargetFps();
+        if (audioBuffer.size() < samples) {
+            audioBuffer.resize(samples);
+        }
+        vm->FillAudioBuffer(&audioBuffer[0], 0, samples);
+        auto audioEnd = benchClock::now();
+
+        //what keeping rewind snapshots costs, as the sdl2 host does
+        vm->CaptureRewindFrame();
+        auto frameEnd = benchClock::now();
+
+        //UpdateAndDraw resets the api timers when it starts a frame
+        const ProfileCounters& profile = vm->getProfileCounters();
+        double graphicsMs = profile.nanos[Profile_Graphics] / 1000000.0;
+        double apiMs = profile.total() / 1000000.0;
+        result.graphicsMs += graphicsMs;
+        result.otherApiMs += apiMs - graphicsMs;
+        result.luaMs += elapsedMs(frameStart, updateEnd) - apiMs;
+        result.presentMs += elapsedMs(updateEnd, presentEnd);
+        result.audioMs += elapsedMs(presentEnd, audioEnd);
+        result.rewindMs += elapsedMs(audioEnd, frameEnd);
+        result.totalMs += elapsedMs(frameStart, frameEnd);
+        result.frameUs.push_back(elapsedMs(frameStart, frameEnd) * 1000.0);
+        result.frames++;
+
+        result.error = vm->GetBiosError();
+    }
+
+    delete vm;
+
+    return result;
+}
+
+//stdout when no file is given
+static FILE* openResultsFile(string jsonFile) {
+    if (jsonFile.length() == 0) {
+        return stdout;
+    }
+
+    FILE* out = fopen(jsonFile.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "could not open %s\n", jsonFile.c_str());
+    }
+    return out;
+}
+
+struct DecompressResult {
+    string cart;
+    string format;
+    size_t luaBytes;
+    double mbPerSecond;
+};
+
+//the lua block of a png cart, as loaded into Cart::CartLuaData
+#define PNG_CART_CODE_SIZE (0x8000 - 0x4300)
+
+static bool runDecompress(string cart, int runs, DecompressResult& result) {
+    Cart* parsed = new Cart(cart, "");
+    const uint8_t* code = parsed->CartLuaData;
+
+    bool pxa = code[0] == '\0' && code[1] == 'p' && code[2] == 'x' && code[3] == 'a';
+    bool legacy = code[0] == ':' && code[1] == 'c' && code[2] == ':' && code[3] == '\0';
+    if (parsed->LoadError.length() > 0 || !(pxa || legacy) || runs <= 0) {
+        delete parsed;
+        return false;
+    }
+
+    result.cart = cart;
+    result.format = pxa ? "pxa" : "legacy";
+    result.luaBytes = 0;
+
+    auto start = benchClock::now();
+    for (int i = 0; i < runs; i++) {
+        string lua = pxa
+            ? decompressPxaCode(code, PNG_CART_CODE_SIZE)
+            : decompressLegacyCode(code, PNG_CART_CODE_SIZE);
+        result.luaBytes = lua.length();
+    }
+    double seconds = elapsedMs(start, benchClock::now()) / 1000.0;
+
+    result.mbPerSecond = seconds > 0 ? result.luaBytes * (double)runs / seconds / 1000000.0 : 0;
+
+    delete parsed;
+    return true;
+}
+
+static int runDecompressSuite(vector<string> carts, int runs, FILE* out) {
+    vector<DecompressResult> results;
+    for (string cart : carts) {
+        DecompressResult result;
+        if (runDecompress(cart, runs, result)) {
+            results.push_back(result);
+        }
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"version\": \"%s\",\n", VER_STR);
+    fprintf(out, "  \"runs_per_cart\": %d,\n", runs);
+    fprintf(out, "  \"decompress\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(out, "    { \"cart\": \"%s\", \"format\": \"%s\", \"lua_bytes\": %zu, \"mb_per_s\": %.1f }%s\n",
+            jsonEscape(results[i].cart).c_str(), results[i].format.c_str(), results[i].luaBytes,
+            results[i].mbPerSecond, i == results.size() - 1 ? "" : ",");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    return 0;
+}
+
+static void printResult(FILE* out, const BenchResult& result, bool last) {
+    vector<double> sorted = result.frameUs;
+    sort(sorted.begin(), sorted.end());
+    double fps = result.totalMs > 0 ? result.frames * 1000.0 / result.totalMs : 0;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"cart\": \"%s\",\n", jsonEscape(result.cart).c_str());
+    fprintf(out, "      \"error\": \"%s\",\n", jsonEscape(result.error).c_str());
+    fprintf(out, "      \"frames\": %d,\n", result.frames);
+    fprintf(out, "      \"fps\": %.1f,\n", fps);
+    fprintf(out, "      \"parse_us\": %.1f,\n", result.parseUs);
+    fprintf(out, "      \"frame_us\": { \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f },\n",
+        percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99), percentile(sorted, 1.0));
+    fprintf(out, "      \"ms\": { \"total\": %.2f, \"lua\": %.2f, \"graphics\": %.2f, \"other_api\": %.2f, \"present\": %.2f, \"audio\": %.2f, \"rewind\": %.2f }\n",
+        result.totalMs, result.luaMs, result.graphicsMs, result.otherApiMs, result.presentMs, result.audioMs, result.rewindMs);
+    fprintf(out, "    }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char* argv[]) {
+    int frames = 600;
+    int parseRuns = 50;
+    bool decompress = false;
+    int decompressRuns = 1000;
+    string jsonFile = "";
+    vector<string> carts;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--parse-runs") == 0 && i + 1 < argc) {
+            parseRuns = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--decompress") == 0) {
+            decompress = true;
+        }
+        else if (strcmp(argv[i], "--decompress-runs") == 0 && i + 1 < argc) {
+            decompressRuns = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+        else {
+            carts.push_back(argv[i]);
+        }
+    }
+
+    if (decompress) {
+        if (carts.size() == 0) {
+            for (string cart : listCartsInDirectory("../test/carts")) {
+                if (getFileExtension(cart) == ".png") {
+                    carts.push_back(cart);
+                }
+            }
+        }
+
+        FILE* out = openResultsFile(jsonFile);
+        if (out == nullptr) {
+            return 1;
+        }
+        int result = runDecompressSuite(carts, decompressRuns, out);
+        if (out != stdout) {
+            fclose(out);
+        }
+        return result;
+    }
+
+    if (carts.size() == 0) {
+        carts = listCartsInDirectory("../test/carts");
+        vector<string> moreCarts = listCartsInDirectory("../carts");
+        carts.insert(carts.end(), moreCarts.begin(), moreCarts.end());
+    }
+
+    Host* host = new Host();
+    host->setUpPaletteColors();
+
+    vector<BenchResult> results;
+    for (string cart : carts) {
+        results.push_back(runCart(host, cart, frames, parseRuns));
+    }
+
+    double totalMs = 0;
+    double totalParseUs = 0;
+    int totalFrames = 0;
+    for (const BenchResult& result : results) {
+        totalMs += result.totalMs;
+        totalParseUs += result.parseUs;
+        totalFrames += result.frames;
+    }
+
+    FILE* out = openResultsFile(jsonFile);
+    if (out == nullptr) {
+        return 1;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"version\": \"%s\",\n", VER_STR);
+    fprintf(out, "  \"frames_per_cart\": %d,\n", frames);
+    fprintf(out, "  \"total_frames\": %d,\n", totalFrames);
+    fprintf(out, "  \"total_ms\": %.2f,\n", totalMs);
+    fprintf(out, "  \"parse_runs_per_cart\": %d,\n", parseRuns);
+    fprintf(out, "  \"total_parse_us\": %.1f,\n", totalParseUs);
+    fprintf(out, "  \"fps\": %.1f,\n", totalMs > 0 ? totalFrames * 1000.0 / totalMs : 0);
+    fprintf(out, "  \"carts\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        printResult(out, results[i], i == results.size() - 1);
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    delete host;
+
+    return 0;
+}
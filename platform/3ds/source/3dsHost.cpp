@@ -19,6 +19,7 @@ using namespace std;
 #include "../../../source/nibblehelpers.h"
 #include "../../../source/PicoRam.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 #define SCREEN_WIDTH 400;
 #define SCREEN_HEIGHT 240;
@@ -42,19 +43,14 @@ const int PicoScreenHeight = 128;
 
 const int PicoFbLength = 128 * 64;
 
-u64 last_time;
-u64 now_time;
-u64 frame_time;
-float targetFrameTimeMs;
-
 u32 currKDown32;
 u32 currKHeld32;
 int touchLocationX;
 int touchLocationY;
 uint8_t mouseBtnState;
 
-uint16_t _rgb565Colors[144];
 uint32_t _rgba8Colors[144];
+FrameConverter<uint16_t> _frameConverter;
 Audio* _audio;
 
 u8 consoleModel = 0;
@@ -340,18 +336,13 @@ void Host::oneTimeSetup(Audio* audio){
     */
     bottomTarget = C2D_CreateScreenTarget(GFX_BOTTOM, GFX_LEFT);
     
-    last_time = 0;
-    now_time = 0;
-    frame_time = 0;
-    targetFrameTimeMs = 0;
-
     currKDown32 = 0;
     currKHeld32 = 0;
 
     for(int i = 0; i < 144; i++){
         _rgba8Colors[i] = 0xFF | (_paletteColors[i].Blue << 8) | (_paletteColors[i].Green << 16) | (_paletteColors[i].Red << 24);
-        _rgb565Colors[i] = (((_paletteColors[i].Red & 0xf8)<<8) + ((_paletteColors[i].Green & 0xfc)<<3)+(_paletteColors[i].Blue>>3));
     }
+    _frameConverter.setHostColors(_paletteColors, colorToRgb565);
 
     pico_tex = (C3D_Tex*)linearAlloc(sizeof(C3D_Tex));
 	//people on homebrew discord said should use this
@@ -408,7 +399,7 @@ void Host::oneTimeCleanup(){
 }
 
 void Host::setTargetFps(int targetFps){
-    targetFrameTimeMs = 1000.0 / (float)targetFps;
+    _framePacer.setTargetFps(targetFps);
 }
 
 void Host::changeStretch(){
@@ -495,41 +486,33 @@ bool Host::shouldQuit() {
 }
 
 
-void Host::waitForTargetFps(){
-    now_time = svcGetSystemTick();
-    frame_time = now_time - last_time;
-	last_time = now_time;
-
-	float frameTimeMs = frame_time / CPU_TICKS_PER_MSEC;
-
-	//sleep for remainder of time
-	if (frameTimeMs < targetFrameTimeMs) {
-		float msToSleep = targetFrameTimeMs - frameTimeMs;
-
-		svcSleepThread(msToSleep * 1000 * 1000);
-
-		last_time += CPU_TICKS_PER_MSEC * msToSleep;
-	}
+static void sleepMicroseconds(uint32_t microseconds) {
+    svcSleepThread((s64)microseconds * 1000);
 }
 
+void Host::waitForTargetFps(){
+    _framePacer.waitForNextFrame(sleepMicroseconds);
+}
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
-    size_t pixIdx = 0;
 
-    for (pixIdx = 0; pixIdx < pico_pixel_buffer_size; pixIdx++){
-        pico_pixel_buffer[pixIdx] = _rgb565Colors[screenPaletteMap[getPixelNibble(pixIdx % 128, pixIdx / 128, picoFb)]];
-    }
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
+    //an unchanged frame is already in the texture, so skip the conversion and the transfer
+    FrameDirtyRows dirtyRows = _frameConverter.findDirtyRows(picoFb, screenPaletteMap, altScreenPaletteMap, altScreenPaletteLines);
+    if (dirtyRows.any()) {
+        uint8_t* firstRow = (uint8_t*)pico_pixel_buffer + dirtyRows.first * 128 * BYTES_PER_PIXEL;
+        _frameConverter.convertRows(picoFb, screenPaletteMap, firstRow, 128 * BYTES_PER_PIXEL, dirtyRows, altScreenPaletteMap, altScreenPaletteLines);
 
-    //not sure if this is necessary?
-    GSPGPU_FlushDataCache(pico_pixel_buffer, pico_pixel_buffer_size);
+        //not sure if this is necessary?
+        GSPGPU_FlushDataCache(pico_pixel_buffer, pico_pixel_buffer_size);
 
-	C3D_SyncDisplayTransfer(
-        (u32*)pico_pixel_buffer, GX_BUFFER_DIM(128, 128),
-        (u32*)(pico_tex->data), GX_BUFFER_DIM(128, 128),
-		(GX_TRANSFER_FLIP_VERT(0) | GX_TRANSFER_OUT_TILED(1) | GX_TRANSFER_RAW_COPY(0) |
-        GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB565) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB565) |
-        GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
-    );
+        C3D_SyncDisplayTransfer(
+            (u32*)pico_pixel_buffer, GX_BUFFER_DIM(128, 128),
+            (u32*)(pico_tex->data), GX_BUFFER_DIM(128, 128),
+            (GX_TRANSFER_FLIP_VERT(0) | GX_TRANSFER_OUT_TILED(1) | GX_TRANSFER_RAW_COPY(0) |
+            GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB565) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB565) |
+            GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
+        );
+    }
 
     screenModeScaleX = 1.0f;
     screenModeScaleY = 1.0f;
@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <time.h>
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
@@ -13,6 +14,8 @@ using namespace std;
 #include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
+#include "../../../source/audioRingBuffer.h"
 
 // sdl
 #include <SDL2/SDL.h>
@@ -21,6 +24,15 @@ using namespace std;
 #define SAMPLESPERBUF (SAMPLERATE / 30)
 #define NUM_BUFFERS 2
 
+//frames the audio device asks for per callback
+#ifndef AUDIO_CALLBACK_FRAMES
+#define AUDIO_CALLBACK_FRAMES 512
+#endif
+//largest audio buffer depth the audiobuffer setting can ask for
+#define AUDIO_RING_FRAMES 8192
+//audio is rendered in multiples of this many frames
+#define AUDIO_RENDER_BLOCK 256
+
 int _windowWidth = 128;
 int _windowHeight = 128;
 
@@ -38,11 +50,6 @@ uint32_t _windowFlags;
 uint32_t _rendererFlags;
 uint32_t _pixelFormat;
 
-uint32_t last_time;
-uint32_t now_time;
-uint32_t frame_time;
-uint32_t targetFrameTimeMs;
-
 uint8_t currKDown;
 uint8_t currKHeld;
 bool stretchKeyPressed = false;
@@ -55,9 +62,12 @@ SDL_Texture *texture = NULL;
 SDL_AudioSpec want, have;
 SDL_AudioDeviceID dev;
 void *pixels;
-uint8_t *base;
 int pitch;
 
+FrameConverter<uint32_t> _frameConverter;
+//only the changed rows are locked, and nothing when the frame didn't change
+bool textureLocked = false;
+
 SDL_Rect DestR;
 SDL_Rect SrcR;
 double textureAngle;
@@ -67,10 +77,20 @@ int joystickCount = 0;
 
 bool audioInitialized = false;
 
+//the emulation thread renders ahead into the ring buffer, the audio callback
+//only copies frames out of it
+AudioRingBuffer _audioRingBuffer(AUDIO_RING_FRAMES);
+uint32_t _audioRenderBuffer[AUDIO_RING_FRAMES];
+size_t _audioRenderFrames = 0;
+size_t _audioTargetFrames = 2048;
+
 
 void postFlipFunction(){
     // We're done rendering, so we end the frame here.
-    SDL_UnlockTexture(texture);
+    if (textureLocked) {
+        SDL_UnlockTexture(texture);
+        textureLocked = false;
+    }
     SDL_RenderCopyEx(renderer, texture, &SrcR, &DestR, textureAngle, NULL, flip);
 
     SDL_RenderPresent(renderer);
@@ -85,7 +105,7 @@ void audioCleanup(){
 
 void FillAudioDeviceBuffer(void* UserData, Uint8* DeviceBuffer, int Length)
 {
-    _audio->FillAudioBuffer(DeviceBuffer, 0, Length / 4);
+    _audioRingBuffer.read((uint32_t*)DeviceBuffer, Length / 4);
 }
 
 void audioSetup(){
@@ -95,7 +115,7 @@ void audioSetup(){
     want.freq = SAMPLERATE;
     want.format = AUDIO_S16;
     want.channels = 2;
-    want.samples = 4096;
+    want.samples = AUDIO_CALLBACK_FRAMES;
     want.callback = FillAudioDeviceBuffer;
     
 
@@ -216,6 +236,8 @@ void Host::oneTimeSetup(Audio* audio){
 
     atexit(SDL_Quit);
 
+    _frameConverter.setHostColors(_paletteColors, colorToArgb8888);
+
     _audio = audio;
     audioSetup();
 
@@ -227,11 +249,6 @@ void Host::oneTimeSetup(Audio* audio){
 		}
     }
 
-    last_time = 0;
-    now_time = 0;
-    frame_time = 0;
-    targetFrameTimeMs = 0;
-
     currKDown = 0;
     currKHeld = 0;
 
@@ -257,7 +274,7 @@ void Host::oneTimeCleanup(){
 }
 
 void Host::setTargetFps(int targetFps){
-    targetFrameTimeMs = 1000 / targetFps;
+    _framePacer.setTargetFps(targetFps);
 }
 
 void Host::changeStretch(){
@@ -306,41 +323,34 @@ bool Host::shouldQuit() {
     return quit == 1;
 }
 
-void Host::waitForTargetFps(){
-    now_time = SDL_GetTicks();
-    frame_time = now_time - last_time;
-	last_time = now_time;
-
-
-	//sleep for remainder of time
-	if (frame_time < targetFrameTimeMs) {
-		uint32_t msToSleep = targetFrameTimeMs - frame_time;
-        
-        SDL_Delay(msToSleep);
+//nanosleep where there is one, SDL_Delay only sleeps whole milliseconds
+static void sleepMicroseconds(uint32_t microseconds) {
+#ifdef _WIN32
+    SDL_Delay(microseconds / 1000);
+#else
+    struct timespec duration = { (time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000 };
+    nanosleep(&duration, nullptr);
+#endif
+}
 
-		last_time += msToSleep;
-	}
+void Host::waitForTargetFps(){
+    _framePacer.waitForNextFrame(sleepMicroseconds);
 }
 
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
     //clear screen to all black
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
     SDL_RenderClear(renderer);
 
-    SDL_LockTexture(texture, NULL, &pixels, &pitch);
-
-    for (int y = 0; y < PicoScreenHeight; y ++){
-        for (int x = 0; x < PicoScreenWidth; x ++){
-            uint8_t c = getPixelNibble(x, y, picoFb);
-            Color col = _paletteColors[screenPaletteMap[c]];
+    //rows that didn't change are still in the texture from the last frame
+    FrameDirtyRows dirtyRows = _frameConverter.findDirtyRows(picoFb, screenPaletteMap, altScreenPaletteMap, altScreenPaletteLines);
+    if (dirtyRows.any()) {
+        SDL_Rect dirtyRect = { 0, dirtyRows.first, PicoScreenWidth, dirtyRows.count() };
+        SDL_LockTexture(texture, &dirtyRect, &pixels, &pitch);
+        textureLocked = true;
 
-            base = ((Uint8 *)pixels) + (4 * ( y * PicoScreenHeight + x));
-            base[0] = col.Blue;
-            base[1] = col.Green;
-            base[2] = col.Red;
-            base[3] = col.Alpha;
-        }
+        _frameConverter.convertRows(picoFb, screenPaletteMap, pixels, pitch, dirtyRows, altScreenPaletteMap, altScreenPaletteLines);
     }
 
     SrcR.x = 0;
@@ -416,18 +426,40 @@ void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMod
 }
 
 bool Host::shouldFillAudioBuff(){
-    return false;
+    if (!audioInitialized) {
+        return false;
+    }
+
+    _audioTargetFrames = audioBufferFrames;
+    if (_audioTargetFrames > AUDIO_RING_FRAMES) {
+        _audioTargetFrames = AUDIO_RING_FRAMES;
+    }
+    if (_audioTargetFrames < AUDIO_CALLBACK_FRAMES) {
+        _audioTargetFrames = AUDIO_CALLBACK_FRAMES;
+    }
+
+    size_t fillLevel = _audioRingBuffer.fillLevel();
+    if (fillLevel + AUDIO_RENDER_BLOCK > _audioTargetFrames) {
+        return false;
+    }
+
+    //top the ring buffer back up to the target depth, a whole block at a time
+    _audioRenderFrames = ((_audioTargetFrames - fillLevel) / AUDIO_RENDER_BLOCK) * AUDIO_RENDER_BLOCK;
+
+    return true;
 }
 
 void* Host::getAudioBufferPointer(){
-    return nullptr;
+    return _audioRenderBuffer;
 }
 
 size_t Host::getAudioBufferSize(){
-    return 0;
+    return _audioRenderFrames;
 }
 
 void Host::playFilledAudioBuffer(){
+    _audioRingBuffer.write(_audioRenderBuffer, _audioRenderFrames);
+    _audioRenderFrames = 0;
 }
 
 bool Host::shouldRunMainLoop(){
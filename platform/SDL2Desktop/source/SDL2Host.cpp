@@ -95,6 +95,8 @@ Host::Host()
         _desktopSdl2customBiosLua,
         fullCartDir
     );
+
+    rewindSupported = true;
 }
 
 
@@ -145,6 +147,7 @@ InputState_t Host::scanInput(){
                     case SDLK_x:     currKDown |= P8_KEY_O; break;
                     case SDLK_c:     currKDown |= P8_KEY_X; break;
                     case SDLK_r:     stretchKeyPressed = true; break;
+                    case SDLK_F3:    rewindHeld = true; break;
                     case SDLK_F2:    currKDown |= P8_KEY_7; break;
 
                     //case SDLK_F2:    currKBKey = "F2"; currKBDown = true; break;
@@ -164,6 +167,7 @@ InputState_t Host::scanInput(){
                     case SDLK_z:     kUp |= P8_KEY_X; break;
                     case SDLK_x:     kUp |= P8_KEY_O; break;
                     case SDLK_c:     kUp |= P8_KEY_X; break;
+                    case SDLK_F3:    rewindHeld = false; break;
                 }
                 break;
 
@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <time.h>
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
@@ -12,6 +13,7 @@ using namespace std;
 #include "../../../source/hostVmShared.h"
 #include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
+#include "../../../source/frameConverter.h"
 
 // sdl
 #include <SDL/SDL.h>
@@ -24,10 +26,6 @@ const int PicoScreenHeight = 128;
 
 
 StretchOption stretch;
-uint32_t last_time;
-uint32_t now_time;
-uint32_t frame_time;
-uint32_t targetFrameTimeMs;
 
 uint8_t currKDown;
 uint8_t currKHeld;
@@ -40,13 +38,12 @@ SDL_Surface *window;
 SDL_Surface *texture;
 SDL_bool done = SDL_FALSE;
 SDL_AudioSpec want, have;
-void *pixels;
-uint16_t *base;
 int pitch;
 
 bool audioInitialized = false;
 
 uint16_t _mapped16BitColors[144];
+FrameConverter<uint16_t> _frameConverter;
 
 
 void postFlipFunction(){
@@ -122,11 +119,6 @@ void Host::oneTimeSetup(Color* paletteColors, Audio* audio){
     _audio = audio;
     audioSetup();
     
-    last_time = 0;
-    now_time = 0;
-    frame_time = 0;
-    targetFrameTimeMs = 0;
-
     _paletteColors = paletteColors;
 
     SDL_PixelFormat *f = window->format;
@@ -134,6 +126,7 @@ void Host::oneTimeSetup(Color* paletteColors, Audio* audio){
     for(int i = 0; i < 144; i++){
         _mapped16BitColors[i] = SDL_MapRGB(f, _paletteColors[i].Red, _paletteColors[i].Green, _paletteColors[i].Blue);
     }
+    _frameConverter.setHostColors(_mapped16BitColors);
 }
 
 void Host::oneTimeCleanup(){
@@ -149,7 +142,7 @@ void Host::oneTimeCleanup(){
 }
 
 void Host::setTargetFps(int targetFps){
-    targetFrameTimeMs = 1000 / targetFps;
+    _framePacer.setTargetFps(targetFps);
 }
 
 void Host::changeStretch(){
@@ -235,20 +228,14 @@ bool Host::shouldQuit() {
     return done == SDL_TRUE;
 }
 
-void Host::waitForTargetFps(){
-    now_time = SDL_GetTicks();
-    frame_time = now_time - last_time;
-	last_time = now_time;
-
-
-	//sleep for remainder of time
-	if (frame_time < targetFrameTimeMs) {
-		uint32_t msToSleep = targetFrameTimeMs - frame_time;
-        
-        SDL_Delay(msToSleep);
+//SDL_Delay would round down to whole milliseconds
+static void sleepMicroseconds(uint32_t microseconds) {
+    struct timespec duration = { (time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000 };
+    nanosleep(&duration, nullptr);
+}
 
-		last_time += msToSleep;
-	}
+void Host::waitForTargetFps(){
+    _framePacer.waitForNextFrame(sleepMicroseconds);
 }
 
 /*
@@ -261,18 +248,12 @@ void set_pixel(SDL_Surface *surface, int x, int y, uint16_t pixel)
 }
 */
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
-    
-    pixels = texture->pixels;
-
-    for (int y = 0; y < (PicoScreenHeight); y ++){
-        for (int x = 0; x < PicoScreenWidth; x ++){
-            uint8_t c = getPixelNibble(x, y, picoFb);
-            uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-            base = ((uint16_t *)pixels) + ( y * PicoScreenHeight + x);
-            base[0] = col;
-        }
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
+    //rows that didn't change are still in the surface from the last frame
+    FrameDirtyRows dirtyRows = _frameConverter.findDirtyRows(picoFb, screenPaletteMap, altScreenPaletteMap, altScreenPaletteLines);
+    if (dirtyRows.any()) {
+        uint8_t* firstRow = (uint8_t*)texture->pixels + dirtyRows.first * texture->pitch;
+        _frameConverter.convertRows(picoFb, screenPaletteMap, firstRow, texture->pitch, dirtyRows, altScreenPaletteMap, altScreenPaletteLines);
     }
 
     postFlipFunction();
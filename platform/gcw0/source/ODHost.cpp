@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <time.h>
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
@@ -16,6 +17,7 @@ using namespace std;
 #include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 // sdl
 #include <SDL/SDL.h>
@@ -41,14 +43,9 @@ int _maxNoStretchHeight = 384;
 
 const int PicoScreenWidth = 128;
 const int PicoScreenHeight = 128;
-const int pixelBlocksPerLine = PicoScreenWidth / 8;
 
 
 StretchOption stretch;
-uint32_t last_time;
-uint32_t now_time;
-uint32_t frame_time;
-uint32_t targetFrameTimeMs;
 
 uint8_t currKDown;
 uint8_t currKHeld;
@@ -61,7 +58,6 @@ SDL_Surface *texture;
 SDL_bool done = SDL_FALSE;
 SDL_AudioSpec want, have;
 void *pixels;
-uint16_t *base;
 int pitch;
 
 SDL_Rect SrcR;
@@ -75,6 +71,7 @@ int drawModeScaleY = 1;
 bool audioInitialized = false;
 
 uint16_t _mapped16BitColors[144];
+FrameConverter<uint16_t> _frameConverter;
 
 /*
  * Gameblabla 
@@ -234,16 +231,12 @@ void Host::oneTimeSetup(Audio* audio){
     _audio = audio;
     audioSetup();
     
-    last_time = 0;
-    now_time = 0;
-    frame_time = 0;
-    targetFrameTimeMs = 0;
-
     SDL_PixelFormat *f = window->format;
 
     for(int i = 0; i < 144; i++){
         _mapped16BitColors[i] = SDL_MapRGB(f, _paletteColors[i].Red, _paletteColors[i].Green, _paletteColors[i].Blue);
     }
+    _frameConverter.setHostColors(_mapped16BitColors);
 
     const SDL_VideoInfo* info = SDL_GetVideoInfo();
     _windowWidth = info->current_w;
@@ -276,7 +269,7 @@ void Host::oneTimeCleanup(){
 }
 
 void Host::setTargetFps(int targetFps){
-    targetFrameTimeMs = 1000 / targetFps;
+    _framePacer.setTargetFps(targetFps);
 }
 
 void Host::changeStretch(){
@@ -403,20 +396,14 @@ bool Host::shouldQuit() {
     return done == SDL_TRUE;
 }
 
-void Host::waitForTargetFps(){
-    now_time = SDL_GetTicks();
-    frame_time = now_time - last_time;
-	last_time = now_time;
-
-
-	//sleep for remainder of time
-	if (frame_time < targetFrameTimeMs) {
-		uint32_t msToSleep = targetFrameTimeMs - frame_time;
-        
-        SDL_Delay(msToSleep);
+//SDL_Delay would round down to whole milliseconds
+static void sleepMicroseconds(uint32_t microseconds) {
+    struct timespec duration = { (time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000 };
+    nanosleep(&duration, nullptr);
+}
 
-		last_time += msToSleep;
-	}
+void Host::waitForTargetFps(){
+    _framePacer.waitForNextFrame(sleepMicroseconds);
 }
 
 /*
@@ -429,7 +416,7 @@ void set_pixel(SDL_Surface *surface, int x, int y, uint16_t pixel)
 }
 */
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
     #ifdef OPENDINGUX_IPU
     pixels = window->pixels;
     #else
@@ -488,129 +475,27 @@ void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMod
 
     _setSourceRect(0, yoffset);
 
-    pixels = texture->pixels;
-
-    //horizontal flip
+    FrameTransform transform = FrameTransform_None;
     if (textureAngle == 0 && flip == 1) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ( y * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
+        transform = FrameTransform_FlipH;
     }
-    //vertical flip
     else if (textureAngle == 0 && flip == 2) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - y) * PicoScreenHeight + x);
-                base[0] = col;
-            }
-        }
+        transform = FrameTransform_FlipV;
     }
-    //horizontal and vertical flip
     else if (textureAngle == 0 && flip == 3) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
+        transform = FrameTransform_FlipHV;
     }
-    //rotated 90 degrees
-    else if (textureAngle == 90 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + (x * PicoScreenHeight + (127 - y));
-                base[0] = col;
-            }
-        }
-    }
-    //rotated 180 degrees
-    else if (textureAngle == 180 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
+    else if (textureAngle == 90 && flip == 0) {
+        transform = FrameTransform_Rotate90;
     }
-    //rotated 270 degrees
-    else if (textureAngle == 270 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint16_t col = _mapped16BitColors[screenPaletteMap[c]];
-
-                base = ((uint16_t *)pixels) + ((127 - x) * PicoScreenHeight + y);
-                base[0] = col;
-            }
-        }
+    else if (textureAngle == 180 && flip == 0) {
+        transform = FrameTransform_Rotate180;
     }
-    else { //default
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < pixelBlocksPerLine; x ++){
-                int32_t eightPix = ((int32_t*)picoFb)[y * pixelBlocksPerLine + x];
-
-                int h = (eightPix >> 28) & 0x0f;
-                int g = (eightPix >> 24) & 0x0f;
-                int f = (eightPix >> 20) & 0x0f;
-                int e = (eightPix >> 16) & 0x0f;
-                int d = (eightPix >> 12) & 0x0f;
-                int c = (eightPix >>  8) & 0x0f;
-                int b = (eightPix >>  4) & 0x0f;
-                int a = (eightPix)       & 0x0f;
-
-                int32_t cola = _mapped16BitColors[screenPaletteMap[a]];
-                int32_t colb = _mapped16BitColors[screenPaletteMap[b]];
-                int32_t colc = _mapped16BitColors[screenPaletteMap[c]];
-                int32_t cold = _mapped16BitColors[screenPaletteMap[d]];
-                int32_t cole = _mapped16BitColors[screenPaletteMap[e]];
-                int32_t colf = _mapped16BitColors[screenPaletteMap[f]];
-                int32_t colg = _mapped16BitColors[screenPaletteMap[g]];
-                int32_t colh = _mapped16BitColors[screenPaletteMap[h]];
-
-                
-                base = ((uint16_t *)pixels + (y * PicoScreenHeight + x * 8));
-                base[0] = cola;
-                base[1] = colb;
-                base[2] = colc;
-                base[3] = cold;
-                base[4] = cole;
-                base[5] = colf;
-                base[6] = colg;
-                base[7] = colh;
-                
-
-                //----OR something like this for further optimization?
-                //not exactly this. its broken
-                /*
-                int32_t* base32 = ((int32_t *)pixels + (y * PicoScreenHeight + x * 8));
-                base32[0] = cola << 16 & colb;
-                base32[1] = colc << 16 & cold;
-                base32[2] = cole << 16 & colf;
-                base32[3] = colg << 16 & colh;
-                */
-                
-                
-            }
-        }
+    else if (textureAngle == 270 && flip == 0) {
+        transform = FrameTransform_Rotate270;
     }
+
+    _frameConverter.convertFrame(picoFb, screenPaletteMap, texture->pixels, texture->pitch, transform, altScreenPaletteMap, altScreenPaletteLines);
     #endif
 
     postFlipFunction();
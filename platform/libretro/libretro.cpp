@@ -11,6 +11,8 @@
 #include "../../source/hostVmShared.h"
 #include "../../source/nibblehelpers.h"
 #include "../../source/filehelpers.h"
+#include "../../source/frameConverter.h"
+#include "../../source/saveState.h"
 #include "libretrohosthelpers.h"
 
 
@@ -44,7 +46,7 @@ const size_t screenBufferSize = PicoScreenWidth*PicoScreenHeight;
 
 uint16_t screenBuffer[screenBufferSize];
 
-uint16_t _rgb565Colors[144];
+FrameConverter<uint16_t> _frameConverter;
 
 Vm* _vm;
 PicoRam* _memory;
@@ -118,9 +120,7 @@ EXPORT void retro_init()
 
 	_host->oneTimeSetup(_audio);
 
-    for(int i = 0; i < 144; i++){
-        _rgb565Colors[i] = (((paletteColors[i].Red & 0xf8)<<8) + ((paletteColors[i].Green & 0xfc)<<3)+(paletteColors[i].Blue>>3));
-    }
+    _frameConverter.setHostColors(paletteColors, colorToRgb565);
 
     _vm->SetCartList(_host->listcarts());
 
@@ -252,6 +252,8 @@ EXPORT void retro_run()
 
     uint8_t* picoFb = _vm->GetPicoInteralFb();
     uint8_t* screenPaletteMap = _vm->GetScreenPaletteMap();
+    uint8_t* altScreenPaletteMap = _vm->GetAltScreenPaletteMap();
+    uint8_t* altScreenPaletteLines = _vm->GetAltScreenPaletteLines();
 
     drawMode = _memory->drawState.drawMode;
 
@@ -307,11 +309,24 @@ EXPORT void retro_run()
     }
 
     //TODO: handle rotation/flip/mirroring
-    for(int scry = 0; scry < PicoScreenHeight; scry++) {
-        for (int scrx = 0; scrx < PicoScreenWidth; scrx++) {
-            int picox = scrx / drawModeScaleX;
+    if (drawModeScaleX == 1 && drawModeScaleY == 1) {
+        //rows that didn't change are still in screenBuffer from the last frame
+        FrameDirtyRows dirtyRows = _frameConverter.findDirtyRows(picoFb, screenPaletteMap, altScreenPaletteMap, altScreenPaletteLines);
+        if (dirtyRows.any()) {
+            _frameConverter.convertRows(picoFb, screenPaletteMap, &screenBuffer[dirtyRows.first * PicoScreenWidth], PicoScreenWidth * BytesPerPixel, dirtyRows, altScreenPaletteMap, altScreenPaletteLines);
+        }
+    }
+    else {
+        //screenBuffer no longer holds the unscaled frame
+        _frameConverter.invalidateShownFrame();
+        _frameConverter.updateScreenPalette(screenPaletteMap, altScreenPaletteMap, altScreenPaletteLines);
+        uint16_t picoRow[PicoScreenWidth];
+        for(int scry = 0; scry < PicoScreenHeight; scry++) {
             int picoy = scry / drawModeScaleY;
-            screenBuffer[scry*128+scrx] = _rgb565Colors[screenPaletteMap[getPixelNibble(picox, picoy, picoFb)]];
+            _frameConverter.convertRow(picoFb, picoy, picoRow);
+            for (int scrx = 0; scrx < PicoScreenWidth; scrx++) {
+                screenBuffer[scry*128+scrx] = picoRow[scrx / drawModeScaleX];
+            }
         }
     }
 
@@ -323,126 +338,76 @@ EXPORT void retro_run()
 //lua memory is 2 MB in size. 1 MB enough for non-globals?
 //https://www.lexaloffle.com/dl/docs/pico-8_manual.html
 //section 6.7: Memory
+//only used to size states for frontends that need a size that never grows
 #define LUASTATEBUFFSIZE 1024*1024
-char luaStateBuffer[LUASTATEBUFFSIZE];
 
-EXPORT size_t retro_serialize_size()
-{
-    return sizeof(PicoRam) + sizeof(audioState_t) + LUASTATEBUFFSIZE;
-}
+//whether the frontend accepted RETRO_SERIALIZATION_QUIRK_CORE_VARIABLE_SIZE,
+//so retro_serialize_size can report the size of the actual state
+static bool variableSizeStates = false;
 
-EXPORT bool retro_serialize(void *data, size_t size)
-{
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "retro_serialize. Checking size\n");
-    }
-    const size_t expectedSize = retro_serialize_size();
-    if (size > expectedSize) {
-        size = expectedSize;
-    }
-    else if (size < expectedSize) {
-        return false;
-    }
+//state built by retro_serialize_size, reused by a retro_serialize call in the
+//same frame (the frontend asks for the size right before saving)
+static std::string pendingState;
+static size_t pendingStateFrame = (size_t)-1;
 
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "got size %d\n", size);
-    }
+//loaded states are decoded here before anything is applied
+static PicoRam loadedRam;
+static std::string loadedLuaState;
 
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "setting up lua state buffer\n");
-    }
-    
-    memset(luaStateBuffer, 0, LUASTATEBUFFSIZE);
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "serializing lua state\n");
+static const std::string& buildState()
+{
+    if (pendingStateFrame != frame) {
+        writeSaveState(pendingState, *_memory, *_audio->getAudioState(), _vm->serializeLuaState());
+        pendingStateFrame = frame;
     }
-    size_t offset = 0;
-    size_t luaStateSize = _vm->serializeLuaState(luaStateBuffer);
 
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying lua state size to buffer\n");
-    }
-    memcpy(((char*)data + offset), &luaStateSize, sizeof(size_t));
-    offset += sizeof(size_t);
+    return pendingState;
+}
 
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying lua state to buffer\n");
+EXPORT size_t retro_serialize_size()
+{
+    if (variableSizeStates) {
+        return buildState().length();
     }
 
-    memcpy(((char*)data + offset), luaStateBuffer, luaStateSize);
-    offset += luaStateSize;
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying pico 8 memory to buffer\n");
-    }
+    return SAVESTATE_BOUND(LUASTATEBUFFSIZE);
+}
 
-    memcpy(((char*)data + offset), _memory->data, sizeof(PicoRam));
-    offset += sizeof(PicoRam);
+EXPORT bool retro_serialize(void *data, size_t size)
+{
+    const std::string& state = buildState();
+    //a state is only built once per frame, the next one has to be fresh
+    pendingStateFrame = (size_t)-1;
 
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying audio state size to buffer\n");
+    if (state.length() > size) {
+        if (log_cb) {
+            log_cb(RETRO_LOG_ERROR, "savestate needs %u bytes, got %u\n", (unsigned)state.length(), (unsigned)size);
+        }
+        return false;
     }
 
-    memcpy(((char*)data + offset), _audio->getAudioState(), sizeof(audioState_t));
-    offset += sizeof(audioState_t);
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "returning true\n");
-    }
+    memcpy(data, state.data(), state.length());
+    //padding up to the size the frontend asked for is ignored when loading
+    memset((char*)data + state.length(), 0, size - state.length());
 
     return true;
 }
 
 EXPORT bool retro_unserialize(const void *data, size_t size)
 {
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "lua deserialize\n");
-    }
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "setting up lua state buffer\n");
-    }
-    memset(luaStateBuffer, 0, LUASTATEBUFFSIZE);
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying lua state from buffer to var\n");
-    }
-    size_t offset = 0;
-    size_t luaStateSize;
-    memcpy(&luaStateSize, ((char*)data + offset),  sizeof(size_t));
-    offset += sizeof(size_t);
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "got lua state size %d\n", luaStateSize);
-    }
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying lua state\n");
-    }
-
-    memcpy(luaStateBuffer, ((char*)data + offset), luaStateSize);
-    offset += luaStateSize;
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "deserializing lua state\n");
-    }
-    _vm->deserializeLuaState(luaStateBuffer, luaStateSize);
-
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying pico 8 memory\n");
+    audioState_t audioState;
+    if (!readSaveState(data, size, loadedRam, audioState, loadedLuaState)) {
+        if (log_cb) {
+            log_cb(RETRO_LOG_ERROR, "not a savestate for this version of fake-08\n");
+        }
+        return false;
     }
 
-    memcpy(_memory->data, ((char*)data + offset), sizeof(PicoRam));
-    offset += sizeof(PicoRam);
+    _vm->deserializeLuaState(loadedLuaState.data(), loadedLuaState.length());
+    memcpy(_memory->data, loadedRam.data, sizeof(PicoRam));
+    *_audio->getAudioState() = audioState;
+    pendingStateFrame = (size_t)-1;
 
-    if (log_cb) {
-        log_cb(RETRO_LOG_INFO, "copying audio state\n");
-    }
-
-    memcpy(_audio->getAudioState(), ((char*)data + offset), sizeof(audioState_t));
-    offset += sizeof(audioState_t);
-    
     return true;
 }
 
@@ -456,6 +421,11 @@ EXPORT void retro_cheat_set(unsigned index, bool enabled, const char *code)
 
 EXPORT bool retro_load_game(struct retro_game_info const *info)
 {
+    //states are sized to the lua heap and compressed memory they hold
+    uint64_t quirks = RETRO_SERIALIZATION_QUIRK_CORE_VARIABLE_SIZE;
+    variableSizeStates = enviro_cb(RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &quirks)
+        && (quirks & RETRO_SERIALIZATION_QUIRK_CORE_VARIABLE_SIZE);
+
     auto containingDir = getDirectory(info->path);
 
     if (containingDir.length() > 0) {
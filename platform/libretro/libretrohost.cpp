@@ -78,7 +78,7 @@ void Host::waitForTargetFps(){
 }
 
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t screenMode){
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t screenMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
     
 }
 
@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 #include <string.h>
 #include <dirent.h>
@@ -16,6 +17,7 @@ using namespace std;
 #include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 #ifndef _DESKTOP
 #include "ao.h"
@@ -48,14 +50,9 @@ int _maxNoStretchHeight = 384;
 
 const int PicoScreenWidth = 128;
 const int PicoScreenHeight = 128;
-const int pixelBlocksPerLine = PicoScreenWidth / 8;
 
 
 StretchOption stretch;
-uint32_t last_time;
-uint32_t now_time;
-uint32_t frame_time;
-uint32_t targetFrameTimeMs;
 
 uint8_t currKDown;
 uint8_t currKHeld;
@@ -67,8 +64,6 @@ SDL_Surface *window;
 SDL_Surface *texture;
 SDL_bool done = SDL_FALSE;
 SDL_AudioSpec want, have;
-void *pixels;
-uint32_t *base;
 int pitch;
 
 SDL_Rect SrcR;
@@ -82,6 +77,7 @@ int drawModeScaleY = 1;
 bool audioInitialized = false;
 
 uint32_t _mapped32BitColors[144];
+FrameConverter<uint32_t> _frameConverter;
 
 
 void postFlipFunction(){
@@ -256,16 +252,12 @@ void Host::oneTimeSetup(Audio* audio){
     _audio = audio;
     audioSetup();
     
-    last_time = 0;
-    now_time = 0;
-    frame_time = 0;
-    targetFrameTimeMs = 0;
-
     SDL_PixelFormat *f = window->format;
 
     for(int i = 0; i < 144; i++){
         _mapped32BitColors[i] = SDL_MapRGB(f, _paletteColors[i].Red, _paletteColors[i].Green, _paletteColors[i].Blue);
     }
+    _frameConverter.setHostColors(_mapped32BitColors);
 
 
     _windowWidth = SCREEN_SIZE_X;
@@ -294,7 +286,7 @@ void Host::oneTimeCleanup(){
 }
 
 void Host::setTargetFps(int targetFps){
-    targetFrameTimeMs = 1000 / targetFps;
+    _framePacer.setTargetFps(targetFps);
 }
 
 void Host::changeStretch(){
@@ -407,20 +399,14 @@ bool Host::shouldQuit() {
     return done == SDL_TRUE;
 }
 
-void Host::waitForTargetFps(){
-    now_time = SDL_GetTicks();
-    frame_time = now_time - last_time;
-	last_time = now_time;
-
-
-	//sleep for remainder of time
-	if (frame_time < targetFrameTimeMs) {
-		uint32_t msToSleep = targetFrameTimeMs - frame_time;
-        
-        SDL_Delay(msToSleep);
+//SDL_Delay would round down to whole milliseconds
+static void sleepMicroseconds(uint32_t microseconds) {
+    struct timespec duration = { (time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000 };
+    nanosleep(&duration, nullptr);
+}
 
-		last_time += msToSleep;
-	}
+void Host::waitForTargetFps(){
+    _framePacer.waitForNextFrame(sleepMicroseconds);
 }
 
 /*
@@ -433,7 +419,7 @@ void set_pixel(SDL_Surface *surface, int x, int y, uint16_t pixel)
 }
 */
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
     drawModeScaleX = 1;
     drawModeScaleY = 1;
     switch(drawMode){
@@ -489,96 +475,35 @@ void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMod
 
     _setSourceRect(0, yoffset);
 
-    pixels = texture->pixels;
-
-    //horizontal flip
+    FrameTransform transform = FrameTransform_None;
     if (textureAngle == 0 && flip == 1) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ( y * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
+        transform = FrameTransform_FlipH;
     }
-    //vertical flip
     else if (textureAngle == 0 && flip == 2) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + x);
-                base[0] = col;
-            }
-        }
+        transform = FrameTransform_FlipV;
     }
-    //horizontal and vertical flip
     else if (textureAngle == 0 && flip == 3) {
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
+        transform = FrameTransform_FlipHV;
     }
-    //rotated 90 degrees
-    else if (textureAngle == 90 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + (x * PicoScreenHeight + (127 - y));
-                base[0] = col;
-            }
-        }
+    else if (textureAngle == 90 && flip == 0) {
+        transform = FrameTransform_Rotate90;
     }
-    //rotated 180 degrees
-    else if (textureAngle == 180 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                base[0] = col;
-            }
-        }
+    else if (textureAngle == 180 && flip == 0) {
+        transform = FrameTransform_Rotate180;
     }
-    //rotated 270 degrees
-    else if (textureAngle == 270 && flip == 0) { 
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                base = ((uint32_t *)pixels) + ((127 - x) * PicoScreenHeight + y);
-                base[0] = col;
-            }
-        }
+    else if (textureAngle == 270 && flip == 0) {
+        transform = FrameTransform_Rotate270;
     }
-    else { //default
-        for (int y = 0; y < PicoScreenHeight; y ++){
-            for (int x = 0; x < PicoScreenWidth; x ++){
-                uint8_t c = getPixelNibble(x, y, picoFb);
-                uint32_t col = _mapped32BitColors[screenPaletteMap[c]];
-
-                #ifdef _DESKTOP
-                base = ((uint32_t *)pixels) + (y * PicoScreenHeight + x);
-                #else
-                base = ((uint32_t *)pixels) + ((127 - y) * PicoScreenHeight + (127 - x));
-                #endif
-                base[0] = col;
-            }
-        }
+    else {
+        #ifdef _DESKTOP
+        transform = FrameTransform_None;
+        #else
+        transform = FrameTransform_Rotate180;
+        #endif
     }
 
+    _frameConverter.convertFrame(picoFb, screenPaletteMap, texture->pixels, texture->pitch, transform, altScreenPaletteMap, altScreenPaletteLines);
+
     postFlipFunction();
 }
 
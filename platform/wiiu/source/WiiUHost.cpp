@@ -4,6 +4,7 @@ Wii U port todo:
 2) Fix buttons being very confusing
 */
 #include <stdio.h>
+#include <time.h>
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
@@ -18,6 +19,7 @@ using namespace std;
 #include "../../../source/nibblehelpers.h"
 #include "../../../source/logger.h"
 #include "../../../source/filehelpers.h"
+#include "../../../source/frameConverter.h"
 
 // sdl
 #include <SDL2/SDL.h>
@@ -57,11 +59,6 @@ const int PicoScreenWidth = 128;
 const int PicoScreenHeight = 128;
 
 
-uint32_t last_time;
-uint32_t now_time;
-uint32_t frame_time;
-uint32_t targetFrameTimeMs;
-
 Audio* _audio;
 
 SDL_Window* window;
@@ -75,9 +72,12 @@ SDL_RendererFlip flip;
 SDL_AudioSpec want, have;
 SDL_AudioDeviceID dev;
 void *pixels;
-uint8_t *base;
 int pitch;
 
+FrameConverter<uint32_t> _frameConverter;
+//only the changed rows are locked, and nothing when the frame didn't change
+bool textureLocked = false;
+
 SDL_Point touchLocation = { 128 / 2, 128 / 2 };
 
 
@@ -85,7 +85,10 @@ SDL_Point touchLocation = { 128 / 2, 128 / 2 };
 void postFlipFunction(){
     //flush switch frame buffers
     // We're done rendering, so we end the frame here.
-    SDL_UnlockTexture(texture);
+    if (textureLocked) {
+        SDL_UnlockTexture(texture);
+        textureLocked = false;
+    }
     SDL_RenderCopyEx(renderer, texture, &SrcR, &DestR, textureAngle, NULL, flip);
 
     SDL_RenderPresent(renderer);
@@ -239,6 +242,8 @@ void Host::oneTimeSetup(Audio* audio){
     DestR.w = SCREEN_SIZE_X;
     DestR.h = SCREEN_SIZE_Y;
 
+    _frameConverter.setHostColors(_paletteColors, colorToRgba8888);
+
     _audio = audio;
     audioSetup();
 
@@ -251,11 +256,6 @@ void Host::oneTimeSetup(Audio* audio){
 
     stretch = PixelPerfectStretch;
 
-    last_time = 0;
-    now_time = 0;
-    frame_time = 0;
-    targetFrameTimeMs = 0;
-
     currKDown = 0;
     currKHeld = 0;
 
@@ -281,7 +281,7 @@ void Host::oneTimeCleanup(){
 }
 
 void Host::setTargetFps(int targetFps){
-    targetFrameTimeMs = 1000 / targetFps;
+    _framePacer.setTargetFps(targetFps);
 }
 
 void Host::changeStretch(){
@@ -415,44 +415,32 @@ bool Host::shouldQuit() {
     return quit > 0;
 }
 
-void Host::waitForTargetFps(){
-    now_time = SDL_GetTicks();
-    frame_time = now_time - last_time;
-	last_time = now_time;
-
-
-	//sleep for remainder of time
-	if (frame_time < targetFrameTimeMs) {
-		uint32_t msToSleep = targetFrameTimeMs - frame_time;
-        
-        SDL_Delay(msToSleep);
+//SDL_Delay would round down to whole milliseconds
+static void sleepMicroseconds(uint32_t microseconds) {
+    struct timespec duration = { (time_t)(microseconds / 1000000), (long)(microseconds % 1000000) * 1000 };
+    nanosleep(&duration, nullptr);
+}
 
-		last_time += msToSleep;
-	}
+void Host::waitForTargetFps(){
+    _framePacer.waitForNextFrame(sleepMicroseconds);
 }
 
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode){
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
     //clear screen to all black
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
     SDL_RenderClear(renderer);
 
-    SDL_LockTexture(texture, NULL, &pixels, &pitch);
+    //rows that didn't change are still in the texture from the last frame
+    FrameDirtyRows dirtyRows = _frameConverter.findDirtyRows(picoFb, screenPaletteMap, altScreenPaletteMap, altScreenPaletteLines);
+    if (dirtyRows.any()) {
+        SDL_Rect dirtyRect = { 0, dirtyRows.first, PicoScreenWidth, dirtyRows.count() };
+        SDL_LockTexture(texture, &dirtyRect, &pixels, &pitch);
+        textureLocked = true;
 
-    for (int y = 0; y < PicoScreenHeight; y ++){
-        for (int x = 0; x < PicoScreenWidth; x ++){
-            uint8_t c = getPixelNibble(x, y, picoFb);
-            Color col = _paletteColors[screenPaletteMap[c]];
-
-            base = ((Uint8 *)pixels) + (4 * ( y * PicoScreenHeight + x));
-            base[0] = col.Red;
-            base[1] = col.Green;
-            base[2] = col.Blue;
-            base[3] = col.Alpha;
-        }
+        _frameConverter.convertRows(picoFb, screenPaletteMap, pixels, pitch, dirtyRows, altScreenPaletteMap, altScreenPaletteLines);
     }
 
-
     SrcR.x = 0;
     SrcR.y = 0;
 
@@ -27,8 +27,9 @@ void Audio::resetAudioState() {
         _audioState._sfxChannels[i].current_note.phi = 0;
         _audioState._sfxChannels[i].can_loop = true;
         _audioState._sfxChannels[i].is_music = false;
-        _audioState._sfxChannels[i].prev_note.n.setKey(0);
-        _audioState._sfxChannels[i].prev_note.n.setVolume(0);
+        _audioState._sfxChannels[i].current_note.n = {};
+        _audioState._sfxChannels[i].prev_note.n = {};
+        _audioState._sfxChannels[i].prev_note.phi = 0;
     }
     _audioState._musicChannel.count = 0;
     _audioState._musicChannel.pattern = -1;
@@ -38,6 +39,8 @@ void Audio::resetAudioState() {
     _audioState._musicChannel.volume = 0.f;
     _audioState._musicChannel.volume_step = 0.f;
     _audioState._musicChannel.offset = 0.f;
+
+    memset(_channelEffects, 0, sizeof(_channelEffects));
 }
 
 audioState_t* Audio::getAudioState() {
@@ -223,18 +226,20 @@ void Audio::FillAudioBuffer(void *audioBuffer, size_t offset, size_t size){
     }
 
     uint32_t *buffer = (uint32_t *)audioBuffer;
+    int16_t channelSamples[4][AUDIO_MIX_BLOCK];
 
-    for (size_t i = 0; i < size; ++i){
-        int32_t sample = 0;
+    for (size_t done = 0; done < size; done += AUDIO_MIX_BLOCK){
+        int count = (int)std::min((size_t)AUDIO_MIX_BLOCK, size - done);
+        renderBlock(channelSamples, count);
 
-        for (int c = 0; c < 4; ++c) {
-            sample += this->getSampleForChannel(c);
-        }
+        for (int i = 0; i < count; ++i){
+            int32_t sample = channelSamples[0][i] + channelSamples[1][i] + channelSamples[2][i] + channelSamples[3][i];
 
-	    if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+            if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
 
-        //buffer is stereo, so just send the mono sample to both channels
-        buffer[i] = (sample<<16) | (sample & 0xffff);
+            //buffer is stereo, so just send the mono sample to both channels
+            buffer[done + i] = (sample<<16) | (sample & 0xffff);
+        }
     }
 }
 
@@ -245,17 +250,19 @@ void Audio::FillMonoAudioBuffer(void *audioBuffer, size_t offset, size_t size){
     }
 
     int16_t *buffer = (int16_t *)audioBuffer;
+    int16_t channelSamples[4][AUDIO_MIX_BLOCK];
 
-    for (size_t i = 0; i < size; ++i){
-        int32_t sample = 0;
+    for (size_t done = 0; done < size; done += AUDIO_MIX_BLOCK){
+        int count = (int)std::min((size_t)AUDIO_MIX_BLOCK, size - done);
+        renderBlock(channelSamples, count);
 
-        for (int c = 0; c < 4; ++c) {
-            sample += this->getSampleForChannel(c);
-        }
+        for (int i = 0; i < count; ++i){
+            int32_t sample = channelSamples[0][i] + channelSamples[1][i] + channelSamples[2][i] + channelSamples[3][i];
 
-	    if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+            if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
 
-        buffer[i] = sample;
+            buffer[done + i] = sample;
+        }
     }
 }
 
@@ -267,6 +274,19 @@ static float key_to_freq(float key)
 
 const float C2_FREQ = key_to_freq(24);
 
+//key_to_freq for every key, so the block mixer doesn't call exp2 per sample
+struct keyFrequencyTable {
+    float freq[64];
+
+    keyFrequencyTable() {
+        for (int key = 0; key < 64; key++) {
+            freq[key] = key_to_freq(key);
+        }
+    }
+};
+
+static const keyFrequencyTable keyFrequencies;
+
 int16_t Audio::getCurrentSfxId(int channel){
     return _audioState._sfxChannels[channel].sfxId;
 }
@@ -289,7 +309,7 @@ int16_t Audio::getMusicTickCount(){
     return _audioState._musicChannel.offset * _audioState._musicChannel.speed;
 }
 
-float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift) {
+float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift, float musicVolume) {
     using std::max;
     int const samples_per_second = 22050;
 
@@ -358,7 +378,7 @@ float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift) {
     float waveform = this->getSampleForNote(channel.current_note, channel, channel.getChildChannel(), channel.prev_note.n, freqShift, false);
     if (crossfade > 0) {
       waveform *= (1.0f-crossfade);
-      note dummyNote;
+      note dummyNote = {};
       waveform+= crossfade * this->getSampleForNote(channel.prev_note, channel, channel.getPrevChildChannel(), dummyNote, freqShift, true);
     }
     uint8_t len = sfx.loopRangeEnd == 0 ? 32 : sfx.loopRangeEnd;
@@ -370,7 +390,7 @@ float Audio::getSampleForSfx(rawSfxChannel &channel, float freqShift) {
     // Apply master music volume from fade in/out
     // FIXME: check whether this should be done after distortion
     if (channel.is_music) {
-        waveform *= _audioState._musicChannel.volume;
+        waveform *= musicVolume;
     }
 
     channel.offset = next_offset;
@@ -541,11 +561,358 @@ int16_t Audio::getSampleForChannel(int channel){
         }
     }
 
-    sample = (int16_t) (32767.99f * this->getSampleForSfx(_audioState._sfxChannels[channel]));
+    sample = (int16_t) (32767.99f * this->getSampleForSfx(_audioState._sfxChannels[channel], 1.0f, _audioState._musicChannel.volume));
 
-    // TODO: Apply hardware effects
+    //the other hardware effects are applied by the block mixer, see applyChannelEffects
     if (_memory->hwState.distort & (1 << channel)) {
         sample = sample / 0x1000 * 0x1249;
     }
     return sample;
 }
+
+static inline int16_t toChannelSample(float waveform, bool distort) {
+    int16_t sample = (int16_t) (32767.99f * waveform);
+    if (distort) {
+        sample = sample / 0x1000 * 0x1249;
+    }
+    return sample;
+}
+
+//Block mixer. The per sample path above (getSampleForChannel) walks the
+//music logic, the virtual channel hierarchy and the waveform switch for every
+//sample of every channel. The block path renders each channel a note segment
+//at a time into arrays instead, and produces the same samples: the music
+//master is advanced up front, and any sample where music changes pattern or
+//finishes fading falls back to getSampleForChannel for all four channels, in
+//channel order, exactly like the per sample path.
+
+//advances the music master for up to count samples, stopping before the first
+//sample that would change pattern or end a fade out. volumeBefore/After hold
+//the music volume seen by channels before/after the master channel
+int Audio::advanceMusic(int count, float* volumeBefore, float* volumeAfter) {
+    int const samples_per_second = 22050;
+    musicChannel &music = _audioState._musicChannel;
+
+    if (music.pattern == -1 || music.master < 0 || music.master > 3) {
+        for (int i = 0; i < count; ++i) {
+            volumeBefore[i] = music.volume;
+            volumeAfter[i] = music.volume;
+        }
+        return count;
+    }
+
+    float const offset_per_second = 22050.f / (183.f * music.speed);
+    float const offset_per_sample = offset_per_second / samples_per_second;
+
+    for (int i = 0; i < count; ++i) {
+        float offset = music.offset + offset_per_sample;
+        float volume = music.volume + music.volume_step / samples_per_second;
+        volume = clamp(volume, 0.f, 1.f);
+
+        if ((music.volume_step < 0 && volume <= 0) || offset >= music.length) {
+            return i;
+        }
+
+        volumeBefore[i] = music.volume;
+        music.offset = offset;
+        music.volume = volume;
+        volumeAfter[i] = volume;
+    }
+
+    return count;
+}
+
+void Audio::renderBlock(int16_t channelSamples[4][AUDIO_MIX_BLOCK], int count) {
+    float volumeBefore[AUDIO_MIX_BLOCK];
+    float volumeAfter[AUDIO_MIX_BLOCK];
+
+    int i = 0;
+    while (i < count) {
+        int const master = _audioState._musicChannel.master;
+        int const run = advanceMusic(count - i, volumeBefore, volumeAfter);
+
+        for (int c = 0; c < 4; ++c) {
+            if (_memory->hwState.half_rate & (1 << c)) {
+                renderHalfRateChannel(c, &channelSamples[c][i], run, c < master ? volumeBefore : volumeAfter);
+            }
+            else {
+                renderChannel(c, &channelSamples[c][i], run, c < master ? volumeBefore : volumeAfter);
+            }
+        }
+        i += run;
+
+        if (i < count) {
+            //music event on this sample, render it the sample accurate way
+            for (int c = 0; c < 4; ++c) {
+                if (_memory->hwState.half_rate & (1 << c)) {
+                    channelSamples[c][i] = getHalfRateSampleForChannel(c);
+                }
+                else {
+                    channelSamples[c][i] = getSampleForChannel(c);
+                }
+            }
+            ++i;
+        }
+    }
+
+    for (int c = 0; c < 4; ++c) {
+        applyChannelEffects(c, channelSamples[c], count);
+    }
+}
+
+//half rate (0x5f40) runs the channel's clock at 11025hz: every other output
+//sample is rendered and then held, so pitch drops an octave and notes last
+//twice as long. Music pattern timing is not affected
+void Audio::renderHalfRateChannel(int channel, int16_t* out, int count, const float* musicVolume) {
+    channelEffectState &effects = _channelEffects[channel];
+    int16_t rendered[AUDIO_MIX_BLOCK];
+    float renderedVolume[AUDIO_MIX_BLOCK];
+
+    int renderCount = 0;
+    for (int i = 0; i < count; ++i) {
+        if (((effects.halfRatePhase + i) & 1) == 0) {
+            renderedVolume[renderCount++] = musicVolume[i];
+        }
+    }
+
+    //a single held sample can take the whole call
+    if (renderCount > 0) {
+        renderChannel(channel, rendered, renderCount, renderedVolume);
+    }
+
+    int next = 0;
+    for (int i = 0; i < count; ++i) {
+        if (((effects.halfRatePhase + i) & 1) == 0) {
+            effects.heldSample = rendered[next++];
+        }
+        out[i] = effects.heldSample;
+    }
+
+    effects.halfRatePhase = (effects.halfRatePhase + count) & 1;
+}
+
+int16_t Audio::getHalfRateSampleForChannel(int channel) {
+    channelEffectState &effects = _channelEffects[channel];
+    if (effects.halfRatePhase == 0) {
+        effects.heldSample = getSampleForChannel(channel);
+    }
+    effects.halfRatePhase ^= 1;
+
+    return effects.heldSample;
+}
+
+//reverb (0x5f41) feeds the channel back through a delay line at half volume,
+//lowpass (0x5f43) is a one pole filter. Channels with neither bit set are
+//left untouched
+void Audio::applyChannelEffects(int channel, int16_t* samples, int count) {
+    channelEffectState &effects = _channelEffects[channel];
+    bool const reverb = _memory->hwState.reverb & (1 << channel);
+    bool const lowpass = _memory->hwState.lowpass & (1 << channel);
+
+    if (!reverb) {
+        effects.reverbActive = false;
+    }
+    if (!lowpass) {
+        effects.lowpass = 0;
+    }
+    if (!reverb && !lowpass) {
+        return;
+    }
+
+    if (reverb) {
+        if (!effects.reverbActive) {
+            //don't replay whatever was in the line when reverb was last on
+            memset(effects.reverbLine, 0, sizeof(effects.reverbLine));
+            effects.reverbPos = 0;
+            effects.reverbActive = true;
+        }
+
+        int pos = effects.reverbPos;
+        for (int i = 0; i < count; ++i) {
+            int32_t sample = samples[i] + effects.reverbLine[pos] / 2;
+            if (sample > 0x7fff) sample = 0x7fff; else if (sample < -0x8000) sample = -0x8000;
+
+            effects.reverbLine[pos] = (int16_t)sample;
+            samples[i] = (int16_t)sample;
+            if (++pos == AUDIO_REVERB_DELAY) {
+                pos = 0;
+            }
+        }
+        effects.reverbPos = pos;
+    }
+
+    if (lowpass) {
+        int32_t state = effects.lowpass;
+        for (int i = 0; i < count; ++i) {
+            state += (samples[i] - state) / 4;
+            samples[i] = (int16_t)state;
+        }
+        effects.lowpass = state;
+    }
+}
+
+void Audio::renderChannel(int channel, int16_t* out, int count, const float* musicVolume) {
+    sfxChannel &sfxChan = _audioState._sfxChannels[channel];
+    bool const distort = _memory->hwState.distort & (1 << channel);
+
+    int i = 0;
+    while (i < count) {
+        if (sfxChan.sfxId < 0 || sfxChan.sfxId > 63) {
+            //only music events can start a channel, and they never happen mid run
+            memset(&out[i], 0, (count - i) * sizeof(int16_t));
+            return;
+        }
+
+        struct sfx const &sfx = _memory->sfx[sfxChan.sfxId];
+        int const note_idx = (int)floor(sfxChan.offset);
+
+        if (sfx.notes[note_idx].getCustom()) {
+            //custom instruments recurse into child channels, keep them per sample
+            out[i] = toChannelSample(getSampleForSfx(sfxChan, 1.0f, musicVolume[i]), distort);
+            ++i;
+            continue;
+        }
+
+        i += renderNoteSegment(sfxChan, &out[i], count - i, &musicVolume[i], distort);
+    }
+}
+
+//renders samples of the channel's current (built in instrument) note until the
+//note changes, the sfx ends or count is reached. Mirrors getSampleForSfx and
+//getSampleForNote operation for operation so results match bit for bit
+int Audio::renderNoteSegment(sfxChannel &channel, int16_t* out, int count, const float* musicVolume, bool distort) {
+    using std::max;
+    int const samples_per_second = 22050;
+
+    struct sfx const &sfx = _memory->sfx[channel.sfxId];
+
+    int const speed = max(1, (int)sfx.speed);
+    float const offset_per_second = 22050.f / (183.f * speed);
+    float const offset_per_sample = offset_per_second / samples_per_second;
+    float const loop_range = float(sfx.loopRangeEnd - sfx.loopRangeStart);
+    float const fade_duration = offset_per_sample * 25;
+    uint8_t const len = sfx.loopRangeEnd == 0 ? 32 : sfx.loopRangeEnd;
+
+    int const note_idx = (int)floor(channel.offset);
+    note const n = sfx.notes[note_idx];
+    channel.current_note.n = n;
+
+    int const fx = n.getEffect();
+    int const instrument = n.getWaveform();
+    float const noteFreq = keyFrequencies.freq[n.getKey()];
+    float const noteVolume = n.getVolume() / 7.f;
+    note const prevNote = channel.prev_note.n;
+    bool const lastNote = note_idx == len - 1;
+
+    float phi[AUDIO_MIX_BLOCK];
+    float volume[AUDIO_MIX_BLOCK];
+    float crossfade[AUDIO_MIX_BLOCK];
+    float prevWaveform[AUDIO_MIX_BLOCK];
+    float endFade[AUDIO_MIX_BLOCK];
+
+    //callers always ask for at least one sample, and a do loop lets the
+    //compiler see the blocks are written before they are read
+    int i = 0;
+    do {
+        float const offset = channel.offset;
+        float next_offset = offset + offset_per_sample;
+        if (loop_range > 0.f && next_offset >= sfx.loopRangeStart && channel.can_loop) {
+            next_offset = fmod(next_offset - sfx.loopRangeStart, loop_range)
+                        + sfx.loopRangeStart;
+        }
+        int const next_note_idx = (int)floor(next_offset);
+
+        float const offset_part = fmod(offset, 1.f);
+        crossfade[i] = 0;
+        if (offset_part < fade_duration) {
+            crossfade[i] = (fade_duration-offset_part)/fade_duration;
+        }
+
+        //current note, see getSampleForNote
+        float freq = noteFreq;
+        float vol = noteVolume;
+        float tmod = 0;
+        tmod += offset_part;
+        switch (fx)
+        {
+            case FX_NO_EFFECT:
+                break;
+            case FX_SLIDE:
+                freq = lerp(keyFrequencies.freq[prevNote.getKey()], freq, tmod);
+                if (prevNote.getVolume() > 0)
+                    vol = lerp(prevNote.getVolume() / 7.0f, vol, tmod);
+                break;
+            case FX_VIBRATO:
+            {
+                float t = fabs(fmod(7.5f * tmod / offset_per_second, 1.0f) - 0.5f) - 0.25f;
+                freq = lerp(freq, freq * 1.059463094359f, t);
+                break;
+            }
+            case FX_DROP:
+                freq *= 1.f - fmod(offset, 1.f);
+                break;
+            case FX_FADE_IN:
+                vol *= std::min(1.f, tmod);
+                break;
+            case FX_FADE_OUT:
+                vol *= max(0.0f, 1.f - tmod);
+                break;
+            case FX_ARP_FAST:
+            case FX_ARP_SLOW:
+            {
+                int const m = (speed <= 8 ? 32 : 16) / (fx == FX_ARP_FAST ? 4 : 8);
+                int const arp = (int)(m * 7.5f * offset / offset_per_second);
+                int const arp_note = (note_idx & ~3) | (arp & 3);
+                freq = keyFrequencies.freq[sfx.notes[arp_note].getKey()];
+                break;
+            }
+        }
+        phi[i] = channel.current_note.phi;
+        volume[i] = vol;
+        channel.current_note.phi = channel.current_note.phi + freq / samples_per_second;
+
+        if (crossfade[i] > 0) {
+            note dummyNote = {};
+            prevWaveform[i] = this->getSampleForNote(channel.prev_note, channel, channel.getPrevChildChannel(), dummyNote, 1.0f, true);
+        }
+
+        endFade[i] = 1.0f;
+        if (lastNote && 1.0f - offset_part < fade_duration) {
+            endFade[i] = (fade_duration - 1.0f + offset_part)/fade_duration;
+        }
+
+        channel.offset = next_offset;
+        ++i;
+
+        if (next_offset >= 32.f){
+            channel.sfxId = -1;
+            break;
+        }
+        else if (next_note_idx != note_idx){
+            channel.prev_note = channel.current_note;
+            channel.current_note.n = sfx.notes[next_note_idx];
+            channel.current_note.phi = channel.prev_note.phi;
+            break;
+        }
+    } while (i < count);
+
+    float waveform[AUDIO_MIX_BLOCK];
+    z8::synth::waveforms(instrument, phi, waveform, i);
+
+    for (int j = 0; j < i; ++j) {
+        float w = volume[j] * waveform[j];
+        if (crossfade[j] > 0) {
+            w *= (1.0f-crossfade[j]);
+            w += crossfade[j] * prevWaveform[j];
+        }
+        if (endFade[j] != 1.0f) {
+            w *= endFade[j];
+        }
+        if (channel.is_music) {
+            w *= musicVolume[j];
+        }
+        out[j] = toChannelSample(w, distort);
+    }
+
+    return i;
+}
@@ -86,14 +86,42 @@ enum
 };
 
 
+//samples the block mixer renders per channel at a time
+#define AUDIO_MIX_BLOCK 256
+//reverb delay in samples (60ms at 22050hz)
+#define AUDIO_REVERB_DELAY 1323
+
+//per channel state of the 0x5f40..0x5f43 hardware effects. Lives in the
+//Audio object so the mixer never allocates, and is not part of audioState_t
+struct channelEffectState {
+    //half rate: the channel renders every other sample and holds it
+    int halfRatePhase;
+    int16_t heldSample;
+
+    int32_t lowpass;
+
+    bool reverbActive;
+    int reverbPos;
+    int16_t reverbLine[AUDIO_REVERB_DELAY];
+};
+
 class Audio {
     PicoRam* _memory;
     audioState_t _audioState;
+    channelEffectState _channelEffects[4];
 
     void set_music_pattern(int pattern);
+
+    int advanceMusic(int count, float* volumeBefore, float* volumeAfter);
+    void renderChannel(int channel, int16_t* out, int count, const float* musicVolume);
+    int renderNoteSegment(sfxChannel &channel, int16_t* out, int count, const float* musicVolume, bool distort);
+    void renderHalfRateChannel(int channel, int16_t* out, int count, const float* musicVolume);
+    int16_t getHalfRateSampleForChannel(int channel);
+    void applyChannelEffects(int channel, int16_t* samples, int count);
+    void renderBlock(int16_t channelSamples[4][AUDIO_MIX_BLOCK], int count);
     
     public:
-    float getSampleForSfx(rawSfxChannel &channel, float freqShift = 1.0f);
+    float getSampleForSfx(rawSfxChannel &channel, float freqShift = 1.0f, float musicVolume = 1.0f);
     int16_t getSampleForChannel(int channel);
     float getSampleForNote(noteChannel &note_channel, rawSfxChannel &parentChannel, rawSfxChannel *childChannel, note prev_note, float freqShift, bool forceRemainder);
 
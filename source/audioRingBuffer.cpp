@@ -0,0 +1,100 @@
+#include <string.h>
+
+#include "audioRingBuffer.h"
+
+static size_t nextPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AudioRingBuffer::AudioRingBuffer(size_t capacityFrames) :
+    _frames(nextPowerOfTwo(capacityFrames > 0 ? capacityFrames : 1), 0),
+    _writeCount(0),
+    _readCount(0),
+    _underruns(0),
+    _underrunFrames(0)
+{
+    _mask = _frames.size() - 1;
+    _lowWaterMark = _frames.size();
+}
+
+size_t AudioRingBuffer::capacity() const {
+    return _frames.size();
+}
+
+size_t AudioRingBuffer::fillLevel() const {
+    return _writeCount.load(std::memory_order_acquire) - _readCount.load(std::memory_order_acquire);
+}
+
+size_t AudioRingBuffer::freeSpace() const {
+    return capacity() - fillLevel();
+}
+
+size_t AudioRingBuffer::write(const uint32_t* frames, size_t count) {
+    const size_t writeCount = _writeCount.load(std::memory_order_relaxed);
+    const size_t readCount = _readCount.load(std::memory_order_acquire);
+    const size_t available = capacity() - (writeCount - readCount);
+    if (count > available) {
+        count = available;
+    }
+
+    const size_t start = writeCount & _mask;
+    const size_t firstPart = count < capacity() - start ? count : capacity() - start;
+    memcpy(&_frames[start], frames, firstPart * sizeof(uint32_t));
+    memcpy(&_frames[0], frames + firstPart, (count - firstPart) * sizeof(uint32_t));
+
+    _writeCount.store(writeCount + count, std::memory_order_release);
+
+    return count;
+}
+
+size_t AudioRingBuffer::read(uint32_t* dest, size_t count) {
+    const size_t readCount = _readCount.load(std::memory_order_relaxed);
+    const size_t writeCount = _writeCount.load(std::memory_order_acquire);
+    const size_t available = writeCount - readCount;
+
+    if (available < _lowWaterMark.load(std::memory_order_relaxed)) {
+        _lowWaterMark.store(available, std::memory_order_relaxed);
+    }
+
+    const size_t toRead = count < available ? count : available;
+    const size_t start = readCount & _mask;
+    const size_t firstPart = toRead < capacity() - start ? toRead : capacity() - start;
+    memcpy(dest, &_frames[start], firstPart * sizeof(uint32_t));
+    memcpy(dest + firstPart, &_frames[0], (toRead - firstPart) * sizeof(uint32_t));
+
+    _readCount.store(readCount + toRead, std::memory_order_release);
+
+    if (toRead < count) {
+        memset(dest + toRead, 0, (count - toRead) * sizeof(uint32_t));
+        _underruns.fetch_add(1, std::memory_order_relaxed);
+        _underrunFrames.fetch_add(count - toRead, std::memory_order_relaxed);
+    }
+
+    return toRead;
+}
+
+uint32_t AudioRingBuffer::underrunCount() const {
+    return _underruns.load(std::memory_order_relaxed);
+}
+
+size_t AudioRingBuffer::underrunFrameCount() const {
+    return _underrunFrames.load(std::memory_order_relaxed);
+}
+
+size_t AudioRingBuffer::lowWaterMark() const {
+    return _lowWaterMark.load(std::memory_order_relaxed);
+}
+
+void AudioRingBuffer::resetMetrics() {
+    _underruns.store(0, std::memory_order_relaxed);
+    _underrunFrames.store(0, std::memory_order_relaxed);
+    _lowWaterMark.store(capacity(), std::memory_order_relaxed);
+}
+
+void AudioRingBuffer::clear() {
+    _readCount.store(_writeCount.load(std::memory_order_acquire), std::memory_order_release);
+}
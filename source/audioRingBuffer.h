@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+//single producer / single consumer ring of stereo frames (two int16 samples
+//packed in a uint32_t, the same layout Audio::FillAudioBuffer writes).
+//The emulation thread renders audio ahead and writes it here, and the host's
+//audio callback only copies frames out, so _audioState is never touched from
+//the audio thread. No locks: each index is only written by one side.
+class AudioRingBuffer {
+    std::vector<uint32_t> _frames;
+    size_t _mask;
+
+    //monotonic frame counts, wrapped with _mask when indexing
+    std::atomic<size_t> _writeCount;
+    std::atomic<size_t> _readCount;
+
+    std::atomic<uint32_t> _underruns;
+    std::atomic<size_t> _underrunFrames;
+    std::atomic<size_t> _lowWaterMark;
+
+    public:
+    //capacity is rounded up to a power of two
+    AudioRingBuffer(size_t capacityFrames);
+
+    size_t capacity() const;
+    //frames ready for the consumer
+    size_t fillLevel() const;
+    //frames the producer can write without overwriting unread audio
+    size_t freeSpace() const;
+
+    //producer side. Returns the number of frames written
+    size_t write(const uint32_t* frames, size_t count);
+
+    //consumer side. Always fills count frames; when there is not enough audio
+    //the rest is silence and it counts as an underrun. Returns frames read
+    size_t read(uint32_t* dest, size_t count);
+
+    //number of reads that ran dry, and the total silent frames they padded
+    uint32_t underrunCount() const;
+    size_t underrunFrameCount() const;
+    //lowest fill level seen by the consumer since the last resetMetrics
+    size_t lowWaterMark() const;
+    void resetMetrics();
+
+    //drops buffered audio. Only safe while the consumer is stopped
+    void clear();
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+//helpers for the on disk caches (CartCache, CartIndex). Their files are a
+//payload of native endian fields and length prefixed blocks, followed by an
+//fnv-1a checksum of the payload, and are replaced by writing a temp file and
+//renaming it so a reader never sees half a file
+
+static inline uint64_t fnv1a(const void* data, size_t length, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static inline void appendU32(std::string& out, uint32_t value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+static inline void appendU64(std::string& out, uint64_t value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+static inline void appendBlock(std::string& out, const void* data, size_t length) {
+    appendU32(out, (uint32_t)length);
+    out.append((const char*)data, length);
+}
+
+//reads from a cache file's payload, failing once anything runs past the end
+class CacheFileReader {
+    const std::string& _data;
+    size_t _pos;
+    size_t _end;
+    bool _ok;
+
+    public:
+    CacheFileReader(const std::string& data, size_t end) : _data(data), _pos(0), _end(end), _ok(true) { }
+
+    bool ok() const { return _ok; }
+    size_t pos() const { return _pos; }
+
+    void read(void* dest, size_t length) {
+        if (!_ok || _end - _pos < length) {
+            _ok = false;
+            return;
+        }
+        memcpy(dest, _data.data() + _pos, length);
+        _pos += length;
+    }
+
+    uint32_t readU32() {
+        uint32_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    uint64_t readU64() {
+        uint64_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    std::string readBlock() {
+        uint32_t length = readU32();
+        if (!_ok || _end - _pos < length) {
+            _ok = false;
+            return "";
+        }
+        std::string block = _data.substr(_pos, length);
+        _pos += length;
+        return block;
+    }
+};
+
+//reads a whole cache file and checks its checksum. payloadLength is the
+//length of everything before the checksum
+static inline bool readCacheFile(const std::string& path, std::string& data, size_t& payloadLength) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    data.clear();
+    char buffer[16384];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.append(buffer, read);
+    }
+    fclose(file);
+
+    if (data.length() < sizeof(uint64_t)) {
+        return false;
+    }
+    payloadLength = data.length() - sizeof(uint64_t);
+    uint64_t checksum;
+    memcpy(&checksum, data.data() + payloadLength, sizeof(checksum));
+
+    return checksum == fnv1a(data.data(), payloadLength);
+}
+
+//appends the checksum to the payload and replaces the file with it
+static inline bool writeCacheFile(const std::string& path, std::string payload) {
+    appendU64(payload, fnv1a(payload.data(), payload.length()));
+
+    std::string tempPath = path + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(payload.data(), 1, payload.length(), file) == payload.length();
+    written &= fclose(file) == 0;
+
+    if (!written) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    remove(path.c_str());
+    return rename(tempPath.c_str(), path.c_str()) == 0;
+}
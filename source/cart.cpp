@@ -1,11 +1,6 @@
 #include <string>
-#include <sstream>
 #include <cstring>
 #include <vector>
-#include <stack>
-#include <array>
-#include <algorithm>
-#include <regex>
 
 #include "lodepng.h"
 
@@ -14,6 +9,8 @@
 
 #include "stringToDataHelpers.h"
 
+#include "codeCompression.h"
+
 #include "utils.h"
 
 #include "logger.h"
@@ -25,139 +22,54 @@
 #include "FakoSettings.h"
 
 
-static char const *legacyCompressionLut = "\n 0123456789abcdefghijklmnopqrstuvwxyz!#%(){}[]<>+=/*:;.,~_";
-
-
-//https://github.com/samhocevar/zepto8/blob/b1a13516945c49e47495c739e6a43a241ad99291/src/pico8/code.cpp
-// Move to front structure
-struct move_to_front
-{
-    move_to_front()
-    {
-        reset();
-    }
-
-    void reset()
-    {
-        for (int n = 0; n < 256; ++n)
-            state[n] = uint8_t(n);
-    }
+#define HEADERLEN 8
 
-    // Get the nth byte and move it to front
-    uint8_t get(int n)
-    {
-        std::rotate(state.begin(), state.begin() + n, state.begin() + n + 1);
-        return state.front();
-    }
 
-    // Find index of a given byte in the structure
-    int find(uint8_t ch)
-    {
-        auto val = std::find(state.begin(), state.end(), ch);
-        return int(std::distance(state.begin(), val));
-    }
+//the 160x205 image holds one byte per pixel: the rom, the lua and a version byte
+#define PNG_CART_WIDTH 160
+#define PNG_CART_HEIGHT 205
+#define PNG_CART_DATA_SIZE (PNG_CART_WIDTH * PNG_CART_HEIGHT)
 
-    // Push a character and return its previous index, allowing the caller to compute the cost
-    // of the operation. This operation can be undone by pop_op().
-    int push_op(uint8_t ch)
-    {
-        int n = find(ch);
-        get(n);
-        ops.push(uint8_t(n));
-        return n;
-    }
+#define PNG_CART_LUA_START 0x4300
+#define PNG_CART_VERSION_ADDR 0x8000
 
-    // Undo an push_op() operation
-    void pop_op()
-    {
-        std::rotate(state.begin(), state.begin() + 1, state.begin() + ops.top() + 1);
-        ops.pop();
-    }
+static_assert(sizeof(CartRomData) == PNG_CART_LUA_START, "png cart bytes are copied straight into CartRomData");
 
-private:
-    std::array<uint8_t, 256> state;
-    std::stack<uint8_t> ops;
+//reused across png loads. Per thread since several Vms can load carts at once
+struct PngCartBuffers {
+    std::vector<unsigned char> file;
+    std::vector<uint8_t> data;
 };
-
-//implementation from zepto8 code.cpp, pxa_decompress
-//https://github.com/samhocevar/zepto8/blob/b1a13516945c49e47495c739e6a43a241ad99291/src/pico8/code.cpp        
-static std::string pxa_decompress(uint8_t const *input)
-{
-    size_t length = input[4] * 256 + input[5];
-    size_t compressed = input[6] * 256 + input[7];
-
-    size_t pos = size_t(8) * 8; // stream position in bits
-    auto get_bits = [&](size_t count) -> uint32_t
-    {
-        uint32_t n = 0;
-        for (size_t i = 0; i < count && pos < compressed * 8; ++i, ++pos)
-            n |= ((input[pos >> 3] >> (pos & 0x7)) & 0x1) << i;
-        return n;
-    };
-
-    move_to_front mtf;
-    std::string ret;
-
-    //TRACE("# Size: %d (%04x)\n", int(compressed), int(compressed));
-
-    while (ret.size() < length && pos < compressed * 8)
-    {
-        auto oldpos = pos; (void)oldpos;
-
-        if (get_bits(1))
-        {
-            int nbits = 4;
-            while (get_bits(1))
-                ++nbits;
-            int n = get_bits(nbits) + (1 << nbits) - 16;
-            uint8_t ch = mtf.get(n);
-            if (!ch)
-                break;
-            //TRACE("%04x [%d] %s\n", int(ret.size()), int(pos-oldpos), printable(ch).c_str());
-            ret.push_back(char(ch));
-        }
-        else
-        {
-            int nbits = get_bits(1) ? get_bits(1) ? 5 : 10 : 15;
-            int offset = get_bits(nbits) + 1;
-
-            if (nbits == 10 && offset == 1)
-            {
-                uint8_t ch = get_bits(8);
-                while (ch)
-                {
-                    ret.push_back(char(ch));
-                    ch = get_bits(8);
-                }
-                //TRACE("%04x [%d] #%d\n", int(ret.size()), int(pos-oldpos), int(pos-oldpos-21) / 8);
-            }
-            else
-            {
-                int n, len = 3;
-                do
-                    len += (n = get_bits(3));
-                while (n == 7);
-
-                //TRACE("%04x [%d] %d@-%d\n", int(ret.size()), int(pos-oldpos), len, offset);
-                for (int i = 0; i < len; ++i)
-                    ret.push_back(ret[ret.size() - offset]);
-                }
-        }
+static thread_local PngCartBuffers _pngCartBuffers;
+
+//each byte is spread over the low 2 bits of a pixel's channels, a r g b from the
+//high bits down. Kept a plain byte loop so the compiler can vectorize it for every host
+static void extractPngCartBytes(const uint8_t* rgba, uint8_t* out, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        const uint8_t* px = rgba + i * 4;
+        out[i] = ((px[3] & 3) << 6) | ((px[0] & 3) << 4) | ((px[1] & 3) << 2) | (px[2] & 3);
     }
-
-    return ret;
 }
 
-#define HEADERLEN 8
+bool Cart::loadCartFromPng(std::string filename, const std::string& fileContents){
+    PngCartBuffers& buffers = _pngCartBuffers;
 
+    unsigned error = 0;
+    if (fileContents.length() > 0) {
+        buffers.file.assign(fileContents.begin(), fileContents.end());
+    }
+    else {
+        error = lodepng::load_file(buffers.file, filename);
+    }
 
-bool Cart::loadCartFromPng(std::string filename){
-    std::vector<unsigned char> image; //the raw pixels
-    unsigned width, height;
+    unsigned width = 0, height = 0;
+    lodepng::State state;
+    state.decoder.read_text_chunks = 0;
 
-    //decode
-    unsigned error = lodepng::decode(image, width, height, filename);
-    //the pixels are now in the vector "image", 4 bytes per pixel, ordered RGBARGBA..., use it as texture, draw it,
+    //check the size from the header before inflating anything
+    if (!error) {
+        error = lodepng_inspect(&width, &height, &state, buffers.file.data(), buffers.file.size());
+    }
 
     //if there's an error, display it
     if(error) {
@@ -166,64 +78,36 @@ bool Cart::loadCartFromPng(std::string filename){
         return false;
     }
 
-    if (width != 160 || height != 205) {
+    if (width != PNG_CART_WIDTH || height != PNG_CART_HEIGHT) {
         LoadError = "Invalid png dimensions";
         Logger_Write("invalid dimensions\n");
         return false;
     }
 
-    //160x205 == 32800 == 0x8020
-    //0x8000 is actual used data size
-    size_t imageBytes = image.size();
-
-    uint8_t version = 0;
-
-    for(size_t i = 0; i < imageBytes; i += 4) {
-        //get argb values
-        uint8_t r = image[i];
-        uint8_t g = image[i + 1];
-        uint8_t b = image[i + 2];
-        uint8_t a = image[i + 3];
+    //carts are saved as 8 bit rgba, which can be decoded as is instead of going
+    //through lodepng's color conversion
+    if (state.info_png.color.colortype == LCT_RGBA && state.info_png.color.bitdepth == 8) {
+        state.decoder.color_convert = 0;
+    }
 
-        //get lower bits where pico data is encoded
-        a = a & 0x0003;
-        r = r & 0x0003;
-		g = g & 0x0003;
-		b = b & 0x0003;
+    //decode to 8 bit rgba, which lodepng mallocs itself
+    unsigned char* image = nullptr;
+    error = lodepng_decode(&image, &width, &height, &state, buffers.file.data(), buffers.file.size());
+    if(error) {
+        free(image);
+        LoadError = "png decoder error " + std::string(lodepng_error_text(error));
+        Logger_Write("%s%s", LoadError.c_str(), "\n");
+        return false;
+    }
 
-        uint8_t extractedByte = (a << 6) + (r << 4) + (g << 2) + b;
+    buffers.data.resize(PNG_CART_DATA_SIZE);
+    extractPngCartBytes(image, buffers.data.data(), PNG_CART_DATA_SIZE);
+    free(image);
 
-        //TODO: write this all to one array, then memcpy to picoram?
-        //store extracted byte in correct place
-        size_t picoDataIdx = i / 4;
-        if (picoDataIdx < 0x2000) {
-            CartRom.SpriteSheetData[picoDataIdx] = extractedByte;
-        }
-        else if (picoDataIdx < 0x3000) {
-            CartRom.MapData[picoDataIdx - 0x2000] = extractedByte;
-        }
-        else if (picoDataIdx < 0x3100) {
-            CartRom.SpriteFlagsData[picoDataIdx - 0x3000] = extractedByte;
-        }
-        else if (picoDataIdx < 0x3200) {
-            size_t offset = picoDataIdx - 0x3100;
-            size_t songIdx = offset / sizeof(song);
-            size_t channelIdx = offset % sizeof(song);
-            CartRom.SongData[songIdx].data[channelIdx] = extractedByte;
-        }
-        else if (picoDataIdx < 0x4300) {
-            size_t offset = picoDataIdx - 0x3200;
-            size_t sfxIdx = offset / sizeof(sfx);
-            size_t byteIdx = offset % sizeof(sfx);
-            CartRom.SfxData[sfxIdx].data[byteIdx] = extractedByte;
-        }
-        else if (picoDataIdx < 0x8000) {
-            CartLuaData[picoDataIdx - 0x4300] = extractedByte;
-        }
-        else if (picoDataIdx == 0x8000) {
-            version = extractedByte;
-        }
-    }
+    //the png data is laid out like CartRomData, followed by the lua
+    memcpy(CartRom.data, buffers.data.data(), sizeof(CartRom.data));
+    memcpy(CartLuaData, buffers.data.data() + PNG_CART_LUA_START, PNG_CART_VERSION_ADDR - PNG_CART_LUA_START);
+    uint8_t version = buffers.data[PNG_CART_VERSION_ADDR];
 
     uint8_t compression = 0;
 
@@ -249,58 +133,123 @@ bool Cart::loadCartFromPng(std::string filename){
         LuaString = std::string((char const *)CartLuaData, length);
     }
     else if (compression == 1){
-        //from pico 8 wiki: https://pico-8.fandom.com/wiki/P8PNGFileFormat
-        //The first four bytes (0x4300-0x4303) are :c:\x00.
-        //The next two bytes (0x4304-0x4305) are the length of the decompressed code, stored MSB first.
-        //The next two bytes (0x4306-0x4307) are always zero. 
-        size_t length = CartLuaData[4] * 256 + CartLuaData[5];
-
-        LuaString.resize(0);
-
-        for (size_t i = 8; i < sizeof(CartLuaData) && LuaString.length() < length; ++i){
-            //0x00: Copy the next byte directly to the output stream. 
-            if(CartLuaData[i] == 0x00){
-                LuaString += CartLuaData[++i];
-            }
-            //0x01-0x3b: Emit a character from a lookup table
-            else if (CartLuaData[i] < 0x3c){
-                LuaString += legacyCompressionLut[CartLuaData[i] - 1];
-            }
-            //0x3c-0xff: Calculate an offset and length from this byte and the next byte, 
-            //then copy those bytes from what has already been emitted. In other words, 
-            //go back "offset" characters in the output stream, copy "length" characters, 
-            //then paste them to the end of the output stream. Offset and length are 
-            //calculated as: 
-            //   offset = (current_byte - 0x3c) * 16 + (next_byte & 0xf)
-            //   length = (next_byte >> 4) + 2
-            else {
-                size_t offset = (CartLuaData[i] - 0x3c) * 16 + (CartLuaData[i + 1] & 0xf);
-                size_t length = (CartLuaData[i + 1] >> 4) + 2;
-
-                int startIndex = LuaString.length() - offset;
-                if (startIndex > -1) {
-                    for(size_t j = 0; j < length; ++j) {
-                        LuaString += LuaString[startIndex + j];
-                    }
-                }
+        LuaString = decompressLegacyCode(CartLuaData, PNG_CART_VERSION_ADDR - PNG_CART_LUA_START);
+    }
+    else if (compression == 2){
+        LuaString = decompressPxaCode(CartLuaData, PNG_CART_VERSION_ADDR - PNG_CART_LUA_START);
+    }
 
-                ++i;
-            }
+    return true;
+
+}
+
+enum P8Section {
+    P8Section_None,
+    P8Section_Lua,
+    P8Section_Gfx,
+    P8Section_Gff,
+    P8Section_Map,
+    P8Section_Sfx,
+    P8Section_Music,
+    P8Section_Label,
+    P8Section_Unknown
+};
+
+static P8Section sectionFromHeader(const char* line, size_t len) {
+    static const struct { const char* name; P8Section section; } headers[] = {
+        {"__lua__", P8Section_Lua},
+        {"__gfx__", P8Section_Gfx},
+        {"__gff__", P8Section_Gff},
+        {"__map__", P8Section_Map},
+        {"__sfx__", P8Section_Sfx},
+        {"__music__", P8Section_Music},
+        {"__label__", P8Section_Label},
+    };
+
+    for (auto& header : headers) {
+        if (strlen(header.name) == len && memcmp(header.name, line, len) == 0) {
+            return header.section;
         }
+    }
 
+    return P8Section_Unknown;
+}
+
+static bool isIncludeSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+static bool isIncludePathChar(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+        || c == '\\' || c == '/' || c == '_' || c == '-' || c == '.';
+}
+
+//matches a whole "#include path" line, optionally indented
+static bool matchIncludeLine(const char* line, size_t len, std::string& includePath) {
+    size_t i = 0;
+    while (i < len && isIncludeSpace(line[i])) {
+        i++;
     }
-    else if (compression == 2){
-        LuaString = pxa_decompress(CartLuaData);
-    }    
 
+    if (len - i < 8 || memcmp(line + i, "#include", 8) != 0) {
+        return false;
+    }
+    i += 8;
+
+    size_t spaceStart = i;
+    while (i < len && isIncludeSpace(line[i])) {
+        i++;
+    }
+    if (i == spaceStart || i == len) {
+        return false;
+    }
+
+    for (size_t j = i; j < len; j++) {
+        if (!isIncludePathChar(line[j])) {
+            return false;
+        }
+    }
+
+    includePath.assign(line + i, len - i);
     return true;
+}
 
+//"eettllhh" header then 32 notes of "kkwve"
+static void decodeSfxLine(struct sfx& sfx, const char* line) {
+    sfx.editorMode = (hex_nibble(line[0]) << 4) | hex_nibble(line[1]);
+    sfx.speed = (hex_nibble(line[2]) << 4) | hex_nibble(line[3]);
+    sfx.loopRangeStart = (hex_nibble(line[4]) << 4) | hex_nibble(line[5]);
+    sfx.loopRangeEnd = (hex_nibble(line[6]) << 4) | hex_nibble(line[7]);
+
+    const char* noteChars = line + 8;
+    for (int noteIdx = 0; noteIdx < 32; noteIdx++, noteChars += 5) {
+        uint8_t key = (hex_nibble(noteChars[0]) << 4) | hex_nibble(noteChars[1]);
+        uint8_t waveform = hex_nibble(noteChars[2]);
+
+        sfx.notes[noteIdx].setKey(key);
+        sfx.notes[noteIdx].setWaveform(waveform);
+        sfx.notes[noteIdx].setVolume(hex_nibble(noteChars[3]));
+        sfx.notes[noteIdx].setEffect(hex_nibble(noteChars[4]));
+        sfx.notes[noteIdx].setCustom(waveform > 7 ? 1 : 0);
+    }
 }
 
-static std::regex _includeRegex = std::regex("\\s*#include\\s+([\\\\/A-Za-z0-9_\\-\\.]+)");
+//"ff 11223344": flag byte, then the four channel sfx
+static void decodeMusicLine(struct song& song, const char* line) {
+    uint8_t flagByte = (hex_nibble(line[0]) << 4) | hex_nibble(line[1]);
 
-//tac08 based cart parsing and stripping of emoji
-Cart::Cart(std::string filename, std::string cartDirectory){
+    uint8_t mode = (flagByte & 8) >> 3;
+    uint8_t fstop = (flagByte & 4) >> 2;
+    uint8_t frepeat = (flagByte & 2) >> 1;
+    uint8_t fnext = flagByte & 1;
+
+    song.data[0] = ((hex_nibble(line[3]) << 4) | hex_nibble(line[4])) | fnext << 7;
+    song.data[1] = ((hex_nibble(line[5]) << 4) | hex_nibble(line[6])) | frepeat << 7;
+    song.data[2] = ((hex_nibble(line[7]) << 4) | hex_nibble(line[8])) | fstop << 7;
+    song.data[3] = ((hex_nibble(line[9]) << 4) | hex_nibble(line[10])) | mode << 7;
+}
+
+std::string Cart::ResolveCartPath(std::string filename, std::string cartDirectory){
     //the leading # indicates it is the BBS key. In the future, it would be nice to fetch them,
     //but for now expect the user to supply the carts
     if (filename.length() > 0 && filename[0] == '#') {
@@ -312,17 +261,32 @@ Cart::Cart(std::string filename, std::string cartDirectory){
     }
 
     if (cartDirectory.length() > 0 && ! isAbsolutePath(filename)) {
-        FullCartPath = cartDirectory + "/" + filename;
-    }
-    else {
-        FullCartPath = filename;
+        return cartDirectory + "/" + filename;
     }
+
+    return filename;
+}
+
+Cart::Cart(std::string fullCartPath, const CartRomData& cartRom, std::string luaString){
+    FullCartPath = fullCartPath;
+    LuaString = luaString;
+    CartRom = cartRom;
+    UsesIncludes = false;
+}
+
+//tac08 based cart parsing and stripping of emoji
+Cart::Cart(std::string filename, std::string cartDirectory, const std::string& fileContents){
+    FullCartPath = ResolveCartPath(filename, cartDirectory);
+    UsesIncludes = false;
+
     //zero out cart rom so no garbage is left over
     initCartRom();
 
     Logger_Write("getting file contents\n");
 
-    std::string firstFourChars = get_first_four_chars(FullCartPath);
+    std::string firstFourChars = fileContents.length() > 0
+        ? fileContents.substr(0, 4)
+        : get_first_four_chars(FullCartPath);
     
     if (FullCartPath == "__FAKE08-BIOS.p8" || FullCartPath == "__FAKE08-SETTINGS.p8" || firstFourChars == "pico"){
         std::string cartStr; 
@@ -333,6 +297,9 @@ Cart::Cart(std::string filename, std::string cartDirectory){
 		else if (FullCartPath == "__FAKE08-SETTINGS.p8") {
             cartStr = fake08SettingsP8;
         }
+        else if (fileContents.length() > 0) {
+            cartStr = fileContents;
+        }
         else {
             cartStr = get_file_contents(FullCartPath.c_str());
         }
@@ -340,70 +307,12 @@ Cart::Cart(std::string filename, std::string cartDirectory){
 
         fullCartText = cartStr;
 
-        std::istringstream s(cartStr);
-        std::string line;
-        std::string currSec = "";
-        std::smatch sm;
-        
-        while (std::getline(s, line)) {
-            line = utils::trimright(line, " \n\r");
-            line = charset::utf8_to_pico8(line);
-            //line = convert_emojis(line);
-
-            if (line.length() > 2 && line[0] == '_' && line[1] == '_') {
-                currSec = line;
-            }
-            else if (currSec == "__lua__"){
-                if (std::regex_match(line, sm, _includeRegex)) {
-                    auto dir = getDirectory(FullCartPath);
-                    auto fullPath = dir + "/" + sm[1].str();
-
-                    auto includeContents = get_file_contents(fullPath);
-                    if (includeContents.length() > 0){
-                        includeContents = charset::utf8_to_pico8(includeContents);
-                        LuaString += includeContents + "\n";
-                    }
-                    else{
-                        //todo: report error
-                        //error: can't find included file
-                        return;
-                    }
-                }
-                else {
-                    LuaString += line + "\n";
-                }
-            }
-            else if (currSec == "__gfx__"){
-                SpriteSheetString += line + "\n";
-            }
-            else if (currSec == "__gff__"){
-                SpriteFlagsString += line + "\n";
-            }
-            else if (currSec == "__map__"){
-                MapString += line + "\n";
-            }
-            else if (currSec == "__sfx__"){
-                SfxString += line + "\n";
-            }
-            else if (currSec == "__music__"){
-                MusicString += line + "\n";
-            }
-            else if (currSec == "__label__"){
-                LabelString += line + "\n";
-            }
+        if (!parseP8Text(fullCartText)) {
+            return;
         }
-
-        Logger_Write("Setting cart graphics rom data from strings\n");
-        setSpriteSheet(SpriteSheetString);
-        setSpriteFlags(SpriteFlagsString);
-        setMapData(MapString);
-
-        Logger_Write("Setting cart audio rom data from strings\n");
-        setSfx(SfxString);
-        setMusic(MusicString);
     }
     else if (firstFourChars == "\x89PNG") {
-        bool success = loadCartFromPng(FullCartPath);
+        bool success = loadCartFromPng(FullCartPath, fileContents);
 
         if (!success){
             return;
@@ -440,135 +349,113 @@ void Cart::initCartRom(){
     }
 }
 
-void Cart::setSpriteSheet(std::string spritesheetstring){
-	Logger_Write("Copying data to spritesheet\n");
-	copy_string_to_sprite_memory(CartRom.SpriteSheetData, spritesheetstring);
-}
+//single pass over the cart text. Hex sections are decoded straight into the
+//cart rom a line at a time, and only the lua is run through the utf8 conversion
+bool Cart::parseP8Text(const std::string& cartStr){
+    const char* pos = cartStr.data();
+    const char* end = pos + cartStr.size();
+    P8Section section = P8Section_None;
 
-void Cart::setSpriteFlags(std::string spriteFlagsstring){
-	Logger_Write("Copying data to sprite flags\n");
-	copy_string_to_memory(CartRom.SpriteFlagsData, spriteFlagsstring);
-}
+    //lua lines not yet converted, flushed in one conversion at #includes and the end
+    std::string pendingLua;
+    std::string includePath;
 
-void Cart::setMapData(std::string mapDataString){
-	Logger_Write("Copying data to map data\n");
-	copy_string_to_memory(CartRom.MapData, mapDataString);
-}
-
-void Cart::setMusic(std::string musicString){
-    std::istringstream s(musicString);
-    std::string line;
-    char buf[3] = {0};
+    size_t spriteSheetPos = 0;
+    size_t spriteFlagsPos = 0;
+    size_t mapPos = 0;
+    int sfxIdx = 0;
     int musicIdx = 0;
-    
-    while (std::getline(s, line)) {
-        if (line.length() < 11){
-            continue;
-        }
 
-        buf[0] = line[0];
-        buf[1] = line[1];
-        uint8_t flagByte = (uint8_t)strtol(buf, NULL, 16);
-
-        uint8_t mode = (flagByte & 8) >> 3;
-        uint8_t fstop = (flagByte & 4) >> 2;
-        uint8_t frepeat = (flagByte & 2) >> 1;
-        uint8_t fnext = flagByte & 1;
+    //SFX speed defaults to 16. Everything else should be zeroed out
+    for (int i = 0; i < 64; i++) {
+        CartRom.SfxData[i].speed = 16;
+    }
 
-        buf[0] = line[3];
-        buf[1] = line[4];
-        uint8_t channel1byte = (uint8_t)strtol(buf, NULL, 16);
+    while (pos < end) {
+        const char* lineEnd = (const char*)memchr(pos, '\n', end - pos);
+        if (lineEnd == nullptr) {
+            lineEnd = end;
+        }
+        const char* next = lineEnd < end ? lineEnd + 1 : end;
 
-        buf[0] = line[5];
-        buf[1] = line[6];
-        uint8_t channel2byte = (uint8_t)strtol(buf, NULL, 16);
+        while (lineEnd > pos && (lineEnd[-1] == ' ' || lineEnd[-1] == '\r')) {
+            lineEnd--;
+        }
+        const char* line = pos;
+        size_t len = lineEnd - pos;
+        pos = next;
 
-        buf[0] = line[7];
-        buf[1] = line[8];
-        uint8_t channel3byte = (uint8_t)strtol(buf, NULL, 16);
+        if (len > 2 && line[0] == '_' && line[1] == '_') {
+            section = sectionFromHeader(line, len);
+            continue;
+        }
 
-        buf[0] = line[9];
-        buf[1] = line[10];
-        uint8_t channel4byte = (uint8_t)strtol(buf, NULL, 16);
+        switch (section) {
+            case P8Section_Lua:
+                if (matchIncludeLine(line, len, includePath)) {
+                    UsesIncludes = true;
+                    LuaString += charset::utf8_to_pico8(pendingLua);
+                    pendingLua.clear();
 
-        CartRom.SongData[musicIdx].data[0] = channel1byte | fnext << 7;
-        CartRom.SongData[musicIdx].data[1] = channel2byte | frepeat << 7;
-        CartRom.SongData[musicIdx].data[2] = channel3byte | fstop << 7;
-        CartRom.SongData[musicIdx].data[3] = channel4byte | mode << 7;
+                    auto fullPath = getDirectory(FullCartPath) + "/" + includePath;
 
-        musicIdx++;
-        if (musicIdx >= 64) {
-            break;
+                    auto includeContents = get_file_contents(fullPath);
+                    if (includeContents.length() > 0){
+                        LuaString += charset::utf8_to_pico8(includeContents) + "\n";
+                    }
+                    else{
+                        //todo: report error
+                        //error: can't find included file
+                        return false;
+                    }
+                }
+                else {
+                    pendingLua.append(line, len);
+                    pendingLua += '\n';
+                }
+                break;
+            case P8Section_Gfx:
+                SpriteSheetString.append(line, len);
+                SpriteSheetString += '\n';
+                spriteSheetPos += copy_hex_line_to_memory(CartRom.SpriteSheetData + spriteSheetPos,
+                    sizeof(CartRom.SpriteSheetData) - spriteSheetPos, line, len, true);
+                break;
+            case P8Section_Gff:
+                SpriteFlagsString.append(line, len);
+                SpriteFlagsString += '\n';
+                spriteFlagsPos += copy_hex_line_to_memory(CartRom.SpriteFlagsData + spriteFlagsPos,
+                    sizeof(CartRom.SpriteFlagsData) - spriteFlagsPos, line, len, false);
+                break;
+            case P8Section_Map:
+                MapString.append(line, len);
+                MapString += '\n';
+                mapPos += copy_hex_line_to_memory(CartRom.MapData + mapPos,
+                    sizeof(CartRom.MapData) - mapPos, line, len, false);
+                break;
+            case P8Section_Sfx:
+                SfxString.append(line, len);
+                SfxString += '\n';
+                if (len >= 168 && sfxIdx < 64) {
+                    decodeSfxLine(CartRom.SfxData[sfxIdx++], line);
+                }
+                break;
+            case P8Section_Music:
+                MusicString.append(line, len);
+                MusicString += '\n';
+                if (len >= 11 && musicIdx < 64) {
+                    decodeMusicLine(CartRom.SongData[musicIdx++], line);
+                }
+                break;
+            case P8Section_Label:
+                LabelString.append(line, len);
+                LabelString += '\n';
+                break;
+            default:
+                break;
         }
     }
 
-}
+    LuaString += charset::utf8_to_pico8(pendingLua);
 
-void Cart::setSfx(std::string sfxString) {
-    std::istringstream s(sfxString);
-    std::string line;
-    char buf[3] = {0};
-    int sfxIdx = 0;
-
-    //SFX speed defaults to 16. Everything else should be zeroed out
-    for (int i = 0; i < 64; i++) {
-        CartRom.SfxData[i].speed = 16;
-    }
-    
-    while (std::getline(s, line)) {
-        buf[0] = line[0];
-        buf[1] = line[1];
-        uint8_t editorMode = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[2];
-        buf[1] = line[3];
-        uint8_t noteDuration = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[4];
-        buf[1] = line[5];
-        uint8_t loopRangeStart = (uint8_t)strtol(buf, NULL, 16);
-
-        buf[0] = line[6];
-        buf[1] = line[7];
-        uint8_t loopRangeEnd = (uint8_t)strtol(buf, NULL, 16);
-
-        CartRom.SfxData[sfxIdx].editorMode = editorMode;
-        CartRom.SfxData[sfxIdx].speed = noteDuration;
-        CartRom.SfxData[sfxIdx].loopRangeStart = loopRangeStart;
-        CartRom.SfxData[sfxIdx].loopRangeEnd = loopRangeEnd;
-
-        //32 notes, 5 chars each
-        int noteIdx = 0;
-        for (int i = 8; i < 168; i+=5) {
-            buf[0] = line[i];
-            buf[1] = line[i + 1];
-            uint8_t key = (uint8_t)strtol(buf, NULL, 16);
-            
-
-            buf[0] = '0';
-            buf[1] = line[i + 2];
-            uint8_t waveform = (uint8_t)strtol(buf, NULL, 16);
-            uint8_t custom = waveform > 7 ? 1 : 0;
-
-            buf[0] = '0';
-            buf[1] = line[i + 3];
-            uint8_t volume = (uint8_t)strtol(buf, NULL, 16);
-
-            buf[0] = '0';
-            buf[1] = line[i + 4];
-            uint8_t effect = (uint8_t)strtol(buf, NULL, 16);
-
-            CartRom.SfxData[sfxIdx].notes[noteIdx].setKey(key);
-            CartRom.SfxData[sfxIdx].notes[noteIdx].setWaveform(waveform);
-            CartRom.SfxData[sfxIdx].notes[noteIdx].setVolume(volume);
-            CartRom.SfxData[sfxIdx].notes[noteIdx].setEffect(effect);
-            CartRom.SfxData[sfxIdx].notes[noteIdx].setCustom(custom);
-
-            noteIdx++;
-        }
-
-        sfxIdx++;
-    } 
+    return true;
 }
-
-
@@ -27,19 +27,25 @@ class Cart {
 
     void initCartRom();
 
-    void setSpriteSheet(std::string spriteSheetString);
-	void setSpriteFlags(std::string spriteFlagsString);
-	void setMapData(std::string mapString);
+    bool parseP8Text(const std::string& cartStr);
 
-    void setSfx(std::string sfxString);
-    void setMusic(std::string musicString);
-
-    bool loadCartFromPng(std::string filename);
+    //fileContents is the png already read, or empty to read it from filename
+    bool loadCartFromPng(std::string filename, const std::string& fileContents);
 	
     public:
-    Cart (std::string filename, std::string cartDirectory);
+    //fileContents is the cart file when the caller already read it (to hash
+    //it for the CartCache), so it isn't read twice. Empty reads the file
+    Cart (std::string filename, std::string cartDirectory, const std::string& fileContents = "");
+    //a cart rebuilt from a CartCache entry, without reading the cart file
+    Cart (std::string fullCartPath, const CartRomData& cartRom, std::string luaString);
     ~Cart();
 
+    //the path the filename constructor loads from
+    static std::string ResolveCartPath(std::string filename, std::string cartDirectory);
+
+    //lua came in through #include, so the cart file alone doesn't determine it
+    bool UsesIncludes;
+
     std::string FullCartPath;
 
     std::string LuaString;
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cartCache.h"
+#include "cacheFileHelpers.h"
+
+static const char CartCacheMagic[4] = { 'F', '8', 'C', 'C' };
+static const char CartCacheLruMagic[4] = { 'F', '8', 'C', 'L' };
+
+CartCache::CartCache(std::string directory, size_t maxEntries, size_t maxBytes) :
+    _maxEntries(maxEntries),
+    _maxBytes(maxBytes),
+    _lruLoaded(false)
+{
+    setDirectory(directory);
+}
+
+void CartCache::setDirectory(std::string directory) {
+    if (directory.length() > 0 && directory[directory.length() - 1] != '/') {
+        directory += "/";
+    }
+    if (directory != _directory) {
+        _lru.clear();
+        _lruLoaded = false;
+    }
+    _directory = directory;
+}
+
+bool CartCache::isEnabled() {
+    return _directory.length() > 0;
+}
+
+std::string CartCache::entryPath(const std::string& cartPath) {
+    return entryPathForHash(fnv1a(cartPath.data(), cartPath.length()));
+}
+
+std::string CartCache::entryPathForHash(uint64_t pathHash) {
+    char name[40];
+    snprintf(name, sizeof(name), "cartcache-%016llx.bin", (unsigned long long)pathHash);
+    return _directory + name;
+}
+
+std::string CartCache::lruPath() {
+    return _directory + "cartcache-lru.bin";
+}
+
+void CartCache::loadLru() {
+    if (_lruLoaded) {
+        return;
+    }
+    _lruLoaded = true;
+    _lru.clear();
+
+    std::string data;
+    size_t payloadLength;
+    if (!readCacheFile(lruPath(), data, payloadLength)) {
+        return;
+    }
+
+    CacheFileReader reader(data, payloadLength);
+    char magic[4];
+    reader.read(magic, sizeof(magic));
+    uint32_t format = reader.readU32();
+    uint32_t count = reader.readU32();
+    if (!reader.ok() || memcmp(magic, CartCacheLruMagic, sizeof(magic)) != 0 || format != CART_CACHE_FORMAT) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count && reader.ok(); i++) {
+        LruRecord record;
+        record.pathHash = reader.readU64();
+        record.bytes = reader.readU32();
+        if (reader.ok()) {
+            _lru.push_back(record);
+        }
+    }
+}
+
+bool CartCache::saveLru() {
+    std::string data;
+    data.append(CartCacheLruMagic, sizeof(CartCacheLruMagic));
+    appendU32(data, CART_CACHE_FORMAT);
+    appendU32(data, (uint32_t)_lru.size());
+    for (const LruRecord& record : _lru) {
+        appendU64(data, record.pathHash);
+        appendU32(data, record.bytes);
+    }
+
+    return writeCacheFile(lruPath(), data);
+}
+
+void CartCache::touch(uint64_t pathHash, size_t bytes) {
+    loadLru();
+
+    if (_lru.size() > 0 && _lru[0].pathHash == pathHash && _lru[0].bytes == bytes) {
+        return;
+    }
+
+    for (size_t i = 0; i < _lru.size(); i++) {
+        if (_lru[i].pathHash == pathHash) {
+            _lru.erase(_lru.begin() + i);
+            break;
+        }
+    }
+    _lru.insert(_lru.begin(), LruRecord { pathHash, (uint32_t)bytes });
+
+    size_t totalBytes = 0;
+    for (const LruRecord& record : _lru) {
+        totalBytes += record.bytes;
+    }
+    //the entry just used always stays
+    while (_lru.size() > 1 && (_lru.size() > _maxEntries || totalBytes > _maxBytes)) {
+        totalBytes -= _lru.back().bytes;
+        remove(entryPathForHash(_lru.back().pathHash).c_str());
+        _lru.pop_back();
+    }
+
+    saveLru();
+}
+
+uint64_t CartCache::hashCartFile(const std::string& fileContents) {
+    uint32_t format = CART_CACHE_FORMAT;
+    uint64_t hash = fnv1a(&format, sizeof(format));
+    hash = fnv1a(VER_STR, strlen(VER_STR), hash);
+    return fnv1a(fileContents.data(), fileContents.length(), hash);
+}
+
+bool CartCache::load(const std::string& cartPath, uint64_t key, CartCacheEntry& entry) {
+    if (!isEnabled()) {
+        return false;
+    }
+
+    std::string data;
+    size_t payloadLength;
+    if (!readCacheFile(entryPath(cartPath), data, payloadLength)) {
+        return false;
+    }
+
+    CacheFileReader reader(data, payloadLength);
+    char magic[4];
+    reader.read(magic, sizeof(magic));
+    uint32_t format = reader.readU32();
+    uint64_t storedKey = reader.readU64();
+    std::string storedPath = reader.readBlock();
+
+    if (!reader.ok() || memcmp(magic, CartCacheMagic, sizeof(magic)) != 0 ||
+        format != CART_CACHE_FORMAT || storedKey != key || storedPath != cartPath)
+    {
+        return false;
+    }
+
+    std::string rom = reader.readBlock();
+    std::string luaString = reader.readBlock();
+    std::string bytecode = reader.readBlock();
+    if (!reader.ok() || reader.pos() != payloadLength || rom.length() != sizeof(entry.rom.data)) {
+        return false;
+    }
+
+    memcpy(entry.rom.data, rom.data(), sizeof(entry.rom.data));
+    entry.luaString = luaString;
+    entry.bytecode = bytecode;
+
+    touch(fnv1a(cartPath.data(), cartPath.length()), data.length());
+
+    return true;
+}
+
+bool CartCache::save(const std::string& cartPath, uint64_t key, const CartCacheEntry& entry) {
+    if (!isEnabled()) {
+        return false;
+    }
+
+    std::string data;
+    data.append(CartCacheMagic, sizeof(CartCacheMagic));
+    appendU32(data, CART_CACHE_FORMAT);
+    appendU64(data, key);
+    appendBlock(data, cartPath.data(), cartPath.length());
+    appendBlock(data, entry.rom.data, sizeof(entry.rom.data));
+    appendBlock(data, entry.luaString.data(), entry.luaString.length());
+    appendBlock(data, entry.bytecode.data(), entry.bytecode.length());
+
+    if (!writeCacheFile(entryPath(cartPath), data)) {
+        return false;
+    }
+
+    //the checksum writeCacheFile appends
+    touch(fnv1a(cartPath.data(), cartPath.length()), data.length() + sizeof(uint64_t));
+
+    return true;
+}
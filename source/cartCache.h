@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "cart.h"
+
+//bump when the entry layout or anything that feeds the compiled chunk changes
+#define CART_CACHE_FORMAT 1
+
+//the least recently used entries are deleted once there are more than this
+//many, or they take more than this many bytes, so carts that were renamed,
+//moved or deleted don't leave their entries behind for good
+#define CART_CACHE_MAX_ENTRIES 32
+#define CART_CACHE_MAX_BYTES (8 * 1024 * 1024)
+
+//what a cart load produces that is worth keeping: the decoded rom, the
+//converted lua source, and the chunk the lua compiler made from it (lua_dump
+//output, loadable with lua_load)
+struct CartCacheEntry {
+    CartRomData rom;
+    std::string luaString;
+    std::string bytecode;
+};
+
+//on disk cache of loaded carts, so launching a cart again skips parsing,
+//decompression and compiling. There is one file per cart path. It stores a
+//hash of the cart file's contents, and an entry whose hash doesn't match the
+//file any more (or that was written by another version) is simply a miss and
+//gets overwritten
+class CartCache {
+    struct LruRecord {
+        uint64_t pathHash;
+        uint32_t bytes;
+    };
+
+    std::string _directory;
+    size_t _maxEntries;
+    size_t _maxBytes;
+
+    //entries in the directory, most recently used first. Kept in its own
+    //file so pruning doesn't have to list the directory
+    std::vector<LruRecord> _lru;
+    bool _lruLoaded;
+
+    std::string entryPathForHash(uint64_t pathHash);
+    std::string lruPath();
+    void loadLru();
+    bool saveLru();
+    //moves an entry to the front, deleting entries past the limits
+    void touch(uint64_t pathHash, size_t bytes);
+
+    public:
+    //an empty directory disables the cache
+    CartCache(std::string directory = "", size_t maxEntries = CART_CACHE_MAX_ENTRIES, size_t maxBytes = CART_CACHE_MAX_BYTES);
+
+    void setDirectory(std::string directory);
+    bool isEnabled();
+
+    //the file holding the entry for a cart
+    std::string entryPath(const std::string& cartPath);
+
+    //key for a cart file's contents, mixed with the cache format and version
+    static uint64_t hashCartFile(const std::string& fileContents);
+
+    bool load(const std::string& cartPath, uint64_t key, CartCacheEntry& entry);
+    bool save(const std::string& cartPath, uint64_t key, const CartCacheEntry& entry);
+};
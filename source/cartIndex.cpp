@@ -0,0 +1,267 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "miniz.h"
+
+#include "cartIndex.h"
+#include "cacheFileHelpers.h"
+#include "cart.h"
+#include "filehelpers.h"
+#include "stringToDataHelpers.h"
+
+#include "logger.h"
+
+static const char CartIndexMagic[4] = { 'F', '8', 'C', 'I' };
+
+#define CART_INDEX_FILENAME "cartindex.bin"
+
+static bool statCartFile(const std::string& path, int64_t& mtime, int64_t& size) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    mtime = (int64_t)st.st_mtime;
+    size = (int64_t)st.st_size;
+    return true;
+}
+
+CartIndex::CartIndex() :
+    _loaded(false),
+    _changed(false)
+{
+}
+
+void CartIndex::setDirectories(std::string cartDirectory, std::string indexDirectory) {
+    if (indexDirectory.length() > 0 && indexDirectory[indexDirectory.length() - 1] != '/') {
+        indexDirectory += "/";
+    }
+    std::string indexPath = indexDirectory.length() > 0 ? indexDirectory + CART_INDEX_FILENAME : "";
+
+    if (cartDirectory == _cartDirectory && indexPath == _indexPath) {
+        return;
+    }
+
+    _cartDirectory = cartDirectory;
+    _indexPath = indexPath;
+    _entries.clear();
+    _loaded = false;
+    _changed = false;
+}
+
+std::string CartIndex::indexPath() {
+    return _indexPath;
+}
+
+bool CartIndex::indexCart(const std::string& cartDirectory, const std::string& filename, CartIndexEntry& entry) {
+    std::string fullPath = Cart::ResolveCartPath(filename, cartDirectory);
+
+    entry.filename = filename;
+    if (!statCartFile(fullPath, entry.mtime, entry.size)) {
+        return false;
+    }
+
+    Cart* cart = new Cart(filename, cartDirectory);
+
+    entry.type = getFileExtension(fullPath) == ".png" ? CartIndexType_Png : CartIndexType_P8;
+
+    entry.titleLines.clear();
+    std::istringstream luaStream(cart->LuaString);
+    std::string line;
+    while (entry.titleLines.size() < CART_INDEX_TITLE_LINES && std::getline(luaStream, line)) {
+        entry.titleLines.push_back(line);
+    }
+
+    //decoded the same way Vm::loadLabel used to decode the label text. The
+    //helpers don't bound their writes, so they get a whole 64k scratch
+    entry.hasLabel = cart->LabelString.length() > 0;
+    entry.label.clear();
+    entry.miniLabel.clear();
+    if (entry.hasLabel) {
+        std::vector<uint8_t> scratch(0x10000, 0);
+        copy_string_to_sprite_memory(scratch.data(), cart->LabelString);
+        entry.label.assign((const char*)scratch.data(), CART_INDEX_LABEL_BYTES);
+
+        std::fill(scratch.begin(), scratch.end(), 0);
+        copy_mini_label_to_sprite_memory(scratch.data(), cart->LabelString, 0);
+        for (int row = 0; row < CART_INDEX_MINI_LABEL_ROWS; row++) {
+            entry.miniLabel.append((const char*)scratch.data() + row * 64, CART_INDEX_MINI_LABEL_ROW_BYTES);
+        }
+    }
+
+    delete cart;
+
+    return true;
+}
+
+const CartIndexEntry* CartIndex::lookup(const std::string& filename) {
+    if (!_loaded) {
+        _loaded = true;
+        load();
+    }
+
+    std::string fullPath = Cart::ResolveCartPath(filename, _cartDirectory);
+    int64_t mtime, size;
+    if (!statCartFile(fullPath, mtime, size)) {
+        return nullptr;
+    }
+
+    auto found = _entries.find(filename);
+    if (found != _entries.end() && found->second.mtime == mtime && found->second.size == size) {
+        return &found->second;
+    }
+
+    Logger_Write("indexing cart %s\n", filename.c_str());
+    CartIndexEntry entry;
+    if (!indexCart(_cartDirectory, filename, entry)) {
+        return nullptr;
+    }
+
+    _changed = true;
+    CartIndexEntry& stored = _entries[filename];
+    stored = entry;
+    return &stored;
+}
+
+void CartIndex::removeMissing(const std::vector<std::string>& cartList) {
+    if (!_loaded) {
+        _loaded = true;
+        load();
+    }
+
+    std::map<std::string, bool> listed;
+    for (const std::string& cart : cartList) {
+        listed[cart] = true;
+    }
+
+    for (auto it = _entries.begin(); it != _entries.end(); ) {
+        if (listed.find(it->first) == listed.end()) {
+            it = _entries.erase(it);
+            _changed = true;
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+//labels are stored deflated, most of a label is runs of the same color
+static void appendCompressedBlock(std::string& out, const std::string& data) {
+    mz_ulong compressedLength = mz_compressBound((mz_ulong)data.length());
+    std::string compressed(compressedLength, '\0');
+    if (mz_compress((unsigned char*)&compressed[0], &compressedLength,
+        (const unsigned char*)data.data(), (mz_ulong)data.length()) != MZ_OK)
+    {
+        compressedLength = 0;
+    }
+    appendBlock(out, compressed.data(), compressedLength);
+}
+
+static bool decompressBlock(const std::string& compressed, std::string& data, size_t length) {
+    data.assign(length, '\0');
+    mz_ulong decompressedLength = (mz_ulong)length;
+    return mz_uncompress((unsigned char*)&data[0], &decompressedLength,
+        (const unsigned char*)compressed.data(), (mz_ulong)compressed.length()) == MZ_OK
+        && decompressedLength == length;
+}
+
+bool CartIndex::load() {
+    _entries.clear();
+
+    std::string data;
+    size_t payloadLength;
+    if (_indexPath.length() == 0 || !readCacheFile(_indexPath, data, payloadLength)) {
+        return false;
+    }
+
+    CacheFileReader reader(data, payloadLength);
+    char magic[4];
+    reader.read(magic, sizeof(magic));
+    uint32_t format = reader.readU32();
+    std::string version = reader.readBlock();
+    std::string cartDirectory = reader.readBlock();
+    uint32_t count = reader.readU32();
+
+    //entries made by another version or for another directory are rebuilt
+    if (!reader.ok() || memcmp(magic, CartIndexMagic, sizeof(magic)) != 0 ||
+        format != CART_INDEX_FORMAT || version != VER_STR || cartDirectory != _cartDirectory)
+    {
+        return false;
+    }
+
+    std::map<std::string, CartIndexEntry> entries;
+    for (uint32_t i = 0; i < count && reader.ok(); i++) {
+        CartIndexEntry entry;
+        entry.filename = reader.readBlock();
+        entry.mtime = (int64_t)reader.readU64();
+        entry.size = (int64_t)reader.readU64();
+        entry.type = (uint8_t)reader.readU32();
+
+        uint32_t titleLineCount = reader.readU32();
+        for (uint32_t line = 0; line < titleLineCount && line < CART_INDEX_TITLE_LINES && reader.ok(); line++) {
+            entry.titleLines.push_back(reader.readBlock());
+        }
+
+        entry.hasLabel = reader.readU32() != 0;
+        if (entry.hasLabel) {
+            std::string compressedLabel = reader.readBlock();
+            std::string compressedMiniLabel = reader.readBlock();
+            if (!reader.ok()
+                || !decompressBlock(compressedLabel, entry.label, CART_INDEX_LABEL_BYTES)
+                || !decompressBlock(compressedMiniLabel, entry.miniLabel,
+                    CART_INDEX_MINI_LABEL_ROWS * CART_INDEX_MINI_LABEL_ROW_BYTES))
+            {
+                return false;
+            }
+        }
+
+        entries[entry.filename] = entry;
+    }
+
+    if (!reader.ok() || reader.pos() != payloadLength) {
+        return false;
+    }
+
+    _entries = entries;
+    return true;
+}
+
+bool CartIndex::save() {
+    if (!_changed || _indexPath.length() == 0) {
+        return false;
+    }
+
+    std::string data;
+    data.append(CartIndexMagic, sizeof(CartIndexMagic));
+    appendU32(data, CART_INDEX_FORMAT);
+    appendBlock(data, VER_STR, strlen(VER_STR));
+    appendBlock(data, _cartDirectory.data(), _cartDirectory.length());
+    appendU32(data, (uint32_t)_entries.size());
+
+    for (auto& it : _entries) {
+        const CartIndexEntry& entry = it.second;
+        appendBlock(data, entry.filename.data(), entry.filename.length());
+        appendU64(data, (uint64_t)entry.mtime);
+        appendU64(data, (uint64_t)entry.size);
+        appendU32(data, entry.type);
+
+        appendU32(data, (uint32_t)entry.titleLines.size());
+        for (const std::string& line : entry.titleLines) {
+            appendBlock(data, line.data(), line.length());
+        }
+
+        appendU32(data, entry.hasLabel ? 1 : 0);
+        if (entry.hasLabel) {
+            appendCompressedBlock(data, entry.label);
+            appendCompressedBlock(data, entry.miniLabel);
+        }
+    }
+
+    if (!writeCacheFile(_indexPath, data)) {
+        return false;
+    }
+
+    _changed = false;
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+//bump when the entry layout or how entries are built changes
+#define CART_INDEX_FORMAT 1
+
+//lua lines kept per cart, for the title and author the bios shows
+#define CART_INDEX_TITLE_LINES 2
+
+//the label decoded as sprite sheet memory, and the 32x32 version the bios
+//browser draws: 16 bytes for each of 32 rows, 64 bytes apart in sprite memory
+#define CART_INDEX_LABEL_BYTES (128 * 64)
+#define CART_INDEX_MINI_LABEL_ROWS 32
+#define CART_INDEX_MINI_LABEL_ROW_BYTES 16
+
+enum CartIndexType {
+    CartIndexType_P8 = 0,
+    CartIndexType_Png = 1
+};
+
+//what the bios browser needs from a cart, without loading it
+struct CartIndexEntry {
+    std::string filename;
+    int64_t mtime;
+    int64_t size;
+    uint8_t type;
+    std::vector<std::string> titleLines;
+    bool hasLabel;
+    std::string label;
+    std::string miniLabel;
+};
+
+//persistent index of the carts in the cart directory, so browsing doesn't
+//parse every cart for a label or a line of lua. Entries are checked against
+//the file's mtime and size when they are looked up, and a cart that is new or
+//changed is parsed again right then, so the index updates incrementally as the
+//directory changes. The index file is rewritten by save() when anything changed
+class CartIndex {
+    std::string _cartDirectory;
+    std::string _indexPath;
+    std::map<std::string, CartIndexEntry> _entries;
+    bool _loaded;
+    bool _changed;
+
+    bool load();
+
+    public:
+    CartIndex();
+
+    //an empty index directory keeps the index in memory only
+    void setDirectories(std::string cartDirectory, std::string indexDirectory);
+
+    std::string indexPath();
+
+    //drops the entries of carts that are no longer in the directory
+    void removeMissing(const std::vector<std::string>& cartList);
+
+    //the entry for a cart in the cart directory, indexing it first when it
+    //isn't indexed or its file changed. Null when the cart can't be read
+    const CartIndexEntry* lookup(const std::string& filename);
+
+    //writes the index file if any entry changed since it was loaded or saved
+    bool save();
+
+    //parses a cart into an index entry
+    static bool indexCart(const std::string& cartDirectory, const std::string& filename, CartIndexEntry& entry);
+};
@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "codeCompression.h"
+
+#define CODE_HEADER_LENGTH 8
+
+static char const *legacyCompressionLut = "\n 0123456789abcdefghijklmnopqrstuvwxyz!#%(){}[]<>+=/*:;.,~_";
+
+//copies count bytes from offset bytes back in the output. When the source runs
+//into the bytes being written (offset < count) the copy repeats them, which is
+//how both formats encode runs
+static void copyBackReference(char* out, size_t outPos, size_t offset, size_t count) {
+    char* dest = out + outPos;
+    const char* src = dest - offset;
+
+    if (offset >= count) {
+        memcpy(dest, src, count);
+    }
+    else {
+        for (size_t i = 0; i < count; i++) {
+            dest[i] = src[i];
+        }
+    }
+}
+
+std::string decompressLegacyCode(const uint8_t* input, size_t inputSize) {
+    if (inputSize < CODE_HEADER_LENGTH) {
+        return "";
+    }
+
+    //from pico 8 wiki: https://pico-8.fandom.com/wiki/P8PNGFileFormat
+    //The first four bytes (0x4300-0x4303) are :c:\x00.
+    //The next two bytes (0x4304-0x4305) are the length of the decompressed code, stored MSB first.
+    //The next two bytes (0x4306-0x4307) are always zero. 
+    size_t length = input[4] * 256 + input[5];
+
+    std::string result(length, '\0');
+    char* out = &result[0];
+    size_t outPos = 0;
+
+    for (size_t i = CODE_HEADER_LENGTH; i < inputSize && outPos < length; ++i){
+        uint8_t byte = input[i];
+
+        //0x00: Copy the next byte directly to the output stream. 
+        if (byte == 0x00){
+            if (++i < inputSize) {
+                out[outPos++] = input[i];
+            }
+        }
+        //0x01-0x3b: Emit a character from a lookup table
+        else if (byte < 0x3c){
+            out[outPos++] = legacyCompressionLut[byte - 1];
+        }
+        //0x3c-0xff: Calculate an offset and length from this byte and the next byte, 
+        //then copy those bytes from what has already been emitted. In other words, 
+        //go back "offset" characters in the output stream, copy "length" characters, 
+        //then paste them to the end of the output stream. Offset and length are 
+        //calculated as: 
+        //   offset = (current_byte - 0x3c) * 16 + (next_byte & 0xf)
+        //   length = (next_byte >> 4) + 2
+        else {
+            uint8_t next = i + 1 < inputSize ? input[i + 1] : 0;
+            size_t offset = (byte - 0x3c) * 16 + (next & 0xf);
+            size_t count = (next >> 4) + 2;
+
+            if (offset <= outPos) {
+                count = std::min(count, length - outPos);
+                copyBackReference(out, outPos, offset, count);
+                outPos += count;
+            }
+
+            ++i;
+        }
+    }
+
+    result.resize(outPos);
+    return result;
+}
+
+//pxa bits are read least significant first. The reader keeps up to 64 of them
+//buffered and refills a whole word at a time while there are 8 bytes left, so
+//the common path is a shift and a mask. Past the end of the data it reads zeros
+class PxaBitReader {
+    const uint8_t* _input;
+    size_t _size;
+    size_t _nextByte;
+    uint64_t _bits;
+    int _bitCount;
+    size_t _position;
+
+    void refill() {
+        if (_nextByte + 8 <= _size) {
+            const uint8_t* p = _input + _nextByte;
+            uint64_t word = (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+                | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+
+            //take as many whole bytes as fit. The bits of the next byte that
+            //spill in are the same ones the next refill ors in again
+            _bits |= word << _bitCount;
+            int bytes = (63 - _bitCount) >> 3;
+            _nextByte += bytes;
+            _bitCount += bytes * 8;
+        }
+        else {
+            while (_bitCount <= 56) {
+                uint64_t byte = _nextByte < _size ? _input[_nextByte] : 0;
+                _bits |= byte << _bitCount;
+                _nextByte++;
+                _bitCount += 8;
+            }
+        }
+    }
+
+    public:
+    PxaBitReader(const uint8_t* input, size_t size, size_t startByte) :
+        _input(input),
+        _size(size),
+        _nextByte(startByte),
+        _bits(0),
+        _bitCount(0),
+        _position(startByte * 8)
+    {
+    }
+
+    //count is at most 32
+    uint32_t get(int count) {
+        if (_bitCount < count) {
+            refill();
+        }
+
+        uint32_t n = (uint32_t)(_bits & ((1ull << count) - 1));
+        _bits >>= count;
+        _bitCount -= count;
+        _position += count;
+
+        return n;
+    }
+
+    size_t position() const {
+        return _position;
+    }
+};
+
+//based on the implementation from zepto8 code.cpp, pxa_decompress
+//https://github.com/samhocevar/zepto8/blob/b1a13516945c49e47495c739e6a43a241ad99291/src/pico8/code.cpp        
+std::string decompressPxaCode(const uint8_t* input, size_t inputSize) {
+    if (inputSize < CODE_HEADER_LENGTH) {
+        return "";
+    }
+
+    size_t length = input[4] * 256 + input[5];
+    size_t compressed = input[6] * 256 + input[7];
+
+    PxaBitReader bits(input, std::min(compressed, inputSize), CODE_HEADER_LENGTH);
+    size_t endPosition = compressed * 8;
+
+    //move to front table of the byte values
+    uint8_t mtf[256];
+    for (int n = 0; n < 256; ++n) {
+        mtf[n] = (uint8_t)n;
+    }
+
+    std::string result(length, '\0');
+    char* out = &result[0];
+    size_t outPos = 0;
+
+    while (outPos < length && bits.position() < endPosition)
+    {
+        if (bits.get(1))
+        {
+            int nbits = 4;
+            while (nbits <= 8 && bits.get(1))
+                ++nbits;
+            int n = bits.get(nbits) + (1 << nbits) - 16;
+            //only a corrupt stream indexes past the table
+            if (n > 255)
+                break;
+
+            uint8_t ch = mtf[n];
+            memmove(mtf + 1, mtf, n);
+            mtf[0] = ch;
+            if (!ch)
+                break;
+            out[outPos++] = char(ch);
+        }
+        else
+        {
+            int nbits = bits.get(1) ? bits.get(1) ? 5 : 10 : 15;
+            size_t offset = bits.get(nbits) + 1;
+
+            if (nbits == 10 && offset == 1)
+            {
+                uint8_t ch = bits.get(8);
+                while (ch && outPos < length)
+                {
+                    out[outPos++] = char(ch);
+                    ch = bits.get(8);
+                }
+            }
+            else
+            {
+                size_t n, count = 3;
+                do
+                    count += (n = bits.get(3));
+                while (n == 7);
+
+                if (offset > outPos)
+                    break;
+
+                count = std::min(count, length - outPos);
+                copyBackReference(out, outPos, offset, count);
+                outPos += count;
+            }
+        }
+    }
+
+    result.resize(outPos);
+    return result;
+}
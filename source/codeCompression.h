@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+//decompressors for the lua code block of png carts (0x4300-0x7fff). Both take
+//the block with its 8 byte header, which holds the decompressed length, and
+//never write past that length
+
+//":c:\0" format from before pico 8 0.2.0
+std::string decompressLegacyCode(const uint8_t* input, size_t inputSize);
+
+//"\0pxa" format
+std::string decompressPxaCode(const uint8_t* input, size_t inputSize);
@@ -12,88 +12,187 @@
 //
 
 
-// I know codecvt_utf8 is deprecated, but let’s hope C++ comes with a
-// replacement before they actually remove the feature.
-#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING 1
-
-
-#include <locale>
+#include <array>
 #include <string>
-#include <codecvt>
 #include <cstring>
-#include <regex>
 #include <string_view>
-#include <map>
+#include <utility>
 
 #include "emojiconversion.h"
 
 
-std::string_view charset::to_utf8[256];
-std::u32string_view charset::to_utf32[256];
+// The complete PICO-8 charmap, from 0 to 255. We cannot just store
+// codepoints because some emoji glyphs are combinations of several
+// codepoints, e.g. ⬇️ is U+2B07 (down arrow) + U+FE0F (variation
+// selector-16).
+static constexpr char utf8_chars[] =
+    "\0¹²³⁴⁵⁶⁷⁸\t\nᵇᶜ\rᵉᶠ▮■□⁙⁘‖◀▶「」¥•、。゛゜"
+    " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNO"
+    "PQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~○"
+    "█▒🐱⬇️░✽●♥☉웃⌂⬅️😐♪🅾️◆…➡️★⧗⬆️ˇ∧❎▤▥あいうえおか"
+    "きくけこさしすせそたちつてとなにぬねのはひふへほまみむめもやゆよ"
+    "らりるれろわをんっゃゅょアイウエオカキクケコサシスセソタチツテト"
+    "ナニヌネノハヒフヘホマミムメモヤユヨラリルレロワヲンッャュョ◜◝";
+
+// Every multibyte glyph starts with a different codepoint, so a glyph is
+// found by decoding one UTF-8 sequence, looking its codepoint up in a
+// sorted table, and checking the glyph's remaining bytes.
+struct charmap_tables
+{
+    uint16_t utf8_offset[256];
+    uint8_t utf8_length[256];
+    char32_t utf32[256 + 8];
+    uint16_t utf32_offset[256];
+    uint8_t utf32_length[256];
+
+    // Multibyte glyphs, sorted by first codepoint
+    char32_t multibyte_codepoint[256];
+    uint8_t multibyte_glyph[256];
+    int multibyte_count;
+};
+
+static constexpr int utf8_sequence_length(uint8_t lead)
+{
+    return lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+}
 
-static uint8_t multibyte_start[256];
-static std::map<std::string, uint8_t> to_pico8;
-std::regex charset::utf8_regex = charset::static_init();
+// Loose decode: the caller compares the glyph bytes afterwards, which
+// rejects anything malformed
+static constexpr char32_t utf8_decode(char const *p, int len)
+{
+    uint8_t lead = (uint8_t)p[0];
+    char32_t cp = len == 4 ? lead & 0x07 : len == 3 ? lead & 0x0f : len == 2 ? lead & 0x1f : lead;
+    for (int i = 1; i < len; ++i)
+        cp = (cp << 6) | ((uint8_t)p[i] & 0x3f);
+    return cp;
+}
 
-std::regex charset::static_init()
+static constexpr charmap_tables build_charmap_tables()
 {
-    std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> cvt;
-
-    // The complete PICO-8 charmap, from 0 to 255. We cannot just store
-    // codepoints because some emoji glyphs are combinations of several
-    // codepoints, e.g. ⬇️ is U+2B07 (down arrow) + U+FE0F (variation
-    // selector-16).
-    static char const utf8_chars[] =
-        "\0¹²³⁴⁵⁶⁷⁸\t\nᵇᶜ\rᵉᶠ▮■□⁙⁘‖◀▶「」¥•、。゛゜"
-        " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNO"
-        "PQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~○"
-        "█▒🐱⬇️░✽●♥☉웃⌂⬅️😐♪🅾️◆…➡️★⧗⬆️ˇ∧❎▤▥あいうえおか"
-        "きくけこさしすせそたちつてとなにぬねのはひふへほまみむめもやゆよ"
-        "らりるれろわをんっゃゅょアイウエオカキクケコサシスセソタチツテト"
-        "ナニヌネノハヒフヘホマミムメモヤユヨラリルレロワヲンッャュョ◜◝";
-    static auto utf32_chars = cvt.from_bytes(utf8_chars, &utf8_chars[sizeof(utf8_chars)]);
-
-    // Create all sorts of lookup tables for PICO-8 character conversions
-    char const *p8 = utf8_chars;
-    auto const *p32 = (char32_t const *)utf32_chars.data();
-    std::string regex("(");
+    charmap_tables t {};
+    int offset8 = 0;
+    int offset32 = 0;
+
     for (int i = 0; i < 256; ++i)
     {
-        size_t len32 = p32[1] == 0xfe0f ? 2 : 1;
-        size_t len8 = ((0xe5000000 >> ((*p8 >> 3) & 0x1e)) & 3) + len32 * len32;
-        to_utf8[i] = std::string_view(p8, len8);
-        to_utf32[i] = std::u32string_view(p32, len32);
-        to_pico8[std::string(p8, len8)] = i;
-
-        // Build a regex that lets us do faster (maybe?) UTF-8 conversions
-        if (len8 > 1)
+        int len = utf8_sequence_length((uint8_t)utf8_chars[offset8]);
+        char32_t cp = utf8_decode(utf8_chars + offset8, len);
+
+        t.utf8_offset[i] = offset8;
+        t.utf32_offset[i] = offset32;
+        t.utf32[offset32++] = cp;
+
+        // U+FE0F is EF B8 8F in UTF-8
+        if ((uint8_t)utf8_chars[offset8 + len] == 0xef
+             && (uint8_t)utf8_chars[offset8 + len + 1] == 0xb8
+             && (uint8_t)utf8_chars[offset8 + len + 2] == 0x8f)
         {
-            multibyte_start[(uint8_t)*p8] = 1;
-            regex += std::string(p8, len8) + '|';
+            len += 3;
+            t.utf32[offset32++] = 0xfe0f;
         }
 
-        p8 += len8;
-        p32 += len32;
+        t.utf8_length[i] = len;
+        t.utf32_length[i] = offset32 - t.utf32_offset[i];
+
+        if (len > 1)
+        {
+            // Insertion sort, the table is small
+            int pos = t.multibyte_count++;
+            while (pos > 0 && t.multibyte_codepoint[pos - 1] > cp)
+            {
+                t.multibyte_codepoint[pos] = t.multibyte_codepoint[pos - 1];
+                t.multibyte_glyph[pos] = t.multibyte_glyph[pos - 1];
+                --pos;
+            }
+            t.multibyte_codepoint[pos] = cp;
+            t.multibyte_glyph[pos] = i;
+        }
+
+        offset8 += len;
+    }
+
+    return t;
+}
+
+static constexpr charmap_tables tables = build_charmap_tables();
+
+static_assert(tables.multibyte_count > 0 && tables.utf8_offset[255] + tables.utf8_length[255] == sizeof(utf8_chars) - 1,
+              "charmap must describe exactly 256 glyphs");
+
+template<size_t... I>
+static constexpr std::array<std::string_view, 256> make_utf8_views(std::index_sequence<I...>)
+{
+    return {{ std::string_view(utf8_chars + tables.utf8_offset[I], tables.utf8_length[I])... }};
+}
+
+template<size_t... I>
+static constexpr std::array<std::u32string_view, 256> make_utf32_views(std::index_sequence<I...>)
+{
+    return {{ std::u32string_view(tables.utf32 + tables.utf32_offset[I], tables.utf32_length[I])... }};
+}
+
+std::array<std::string_view, 256> const charset::to_utf8 = make_utf8_views(std::make_index_sequence<256>());
+std::array<std::u32string_view, 256> const charset::to_utf32 = make_utf32_views(std::make_index_sequence<256>());
+
+// Returns the PICO-8 glyph starting at p, or -1 if the bytes there aren't one
+static int match_glyph(char const *p, size_t remaining, size_t *matched)
+{
+    int len = utf8_sequence_length((uint8_t)*p);
+    if (len < 2 || (size_t)len > remaining)
+        return -1;
+
+    char32_t cp = utf8_decode(p, len);
+
+    int lo = 0, hi = tables.multibyte_count - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        char32_t mid_cp = tables.multibyte_codepoint[mid];
+        if (mid_cp < cp)
+            lo = mid + 1;
+        else if (mid_cp > cp)
+            hi = mid - 1;
+        else
+        {
+            uint8_t glyph = tables.multibyte_glyph[mid];
+            size_t glyph_len = tables.utf8_length[glyph];
+            if (glyph_len > remaining
+                 || memcmp(p, utf8_chars + tables.utf8_offset[glyph], glyph_len) != 0)
+                return -1;
+
+            *matched = glyph_len;
+            return glyph;
+        }
     }
-    regex += ')'; // Fall back to an empty match on purpose
 
-    return std::regex(regex);
+    return -1;
 }
 
 std::string charset::utf8_to_pico8(std::string const &str)
 {
     std::string ret;
-    std::smatch sm;
+    ret.reserve(str.size());
+
+    char const *p = str.data();
+    char const *end = p + str.size();
 
-    for (auto p = str.begin(); p != str.end(); )
+    while (p < end)
     {
-        // Only pass known start characters through the expensive regex
-        if (multibyte_start[(uint8_t)*p]
-             && std::regex_search(p, str.end(), sm, utf8_regex)
-             && sm.length() > 1)
+        // Copy runs of ASCII in one go
+        char const *run = p;
+        while (p < end && (uint8_t)*p < 0x80)
+            ++p;
+        ret.append(run, p - run);
+
+        if (p == end)
+            break;
+
+        size_t matched = 0;
+        int glyph = match_glyph(p, end - p, &matched);
+        if (glyph >= 0)
         {
-            ret += to_pico8[sm.str()];
-            p += sm.length();
+            ret += char(glyph);
+            p += matched;
         }
         else
         {
@@ -114,54 +213,17 @@ std::string charset::pico8_to_utf8(std::string const &str)
 
 
 
+// Uppercase letters type the glyphs from █ (A) to ▥ (Z)
 std::string charset::upper_to_emoji(std::string str)
 {
+    std::string ret = utf8_to_pico8(str);
 
-	std::map<std::string,std::string> uemap = {
-		{"A","█"},
-		{"B","▒"},
-		{"C","🐱"},
-		{"D","⬇️"},
-		{"E","░"},
-		{"F","✽"},
-		{"G","●"},
-		{"H","♥"},
-		{"I","☉"},
-		{"J","웃"},
-		{"K","⌂"},
-		{"L","⬅️"},
-		{"M","😐"},
-		{"N","♪"},
-		{"O","🅾️"},
-		{"P","◆"},
-		{"Q","…"},
-		{"R","➡️"},
-		{"S","★"},
-		{"T","⧗"},
-		{"U","⬆️"},
-		{"V","ˇ"},
-		{"W","∧"},
-		{"X","❎"},
-		{"Y","▤"},
-		{"Z","▥"}
-	};
-	
-	
-	std::string newstring = "";
-	
-	for(unsigned i = 0; i < str.length(); i++){
-		
-		std::string c = "";
-		c += str.at(i);
-		auto loc = uemap.find(c);
-		
-		if(loc == uemap.end()){
-			newstring += c;
-			
-		}else{
-			newstring += uemap.at(c);
-		}
-	}
-	
-    return charset::utf8_to_pico8(newstring);
-}
\ No newline at end of file
+    // Converted glyphs are all >= 0x80, so any letters left came from the input
+    for (char &ch : ret)
+    {
+        if (ch >= 'A' && ch <= 'Z')
+            ch = char(128 + (ch - 'A'));
+    }
+
+    return ret;
+}
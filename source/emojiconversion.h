@@ -1,5 +1,6 @@
+#include <array>
 #include <string>
-#include <regex>
+#include <string_view>
 
 struct charset
 {
@@ -8,15 +9,11 @@ struct charset
     static std::string pico8_to_utf8(std::string const &str);
 
     // Map 8-bit PICO-8 characters to UTF-32 codepoints
-    static std::u32string_view to_utf32[256];
+    static std::array<std::u32string_view, 256> const to_utf32;
 
     // Map 8-bit PICO-8 characters to UTF-8 string views
-    static std::string_view to_utf8[256];
+    static std::array<std::string_view, 256> const to_utf8;
 	
 	// Map uppercase letters to PICO-8 glyphs
     static std::string upper_to_emoji(std::string str);
-
-private:
-    static std::regex static_init();
-    static std::regex utf8_regex;
-};
\ No newline at end of file
+};
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hostVmShared.h"
+
+//converts the 4bpp pico 8 screen buffer into host pixels. Each source byte
+//holds two pixels, so a 256 entry table of pixel pairs is built from the
+//screen palette and the host colors, and rebuilt only when the screen
+//palette changes. A second table holds the secondary palette (0x5f60) for
+//scanlines flagged in the 0x5f70 bitfield, so switching costs one pointer
+//select per line
+//
+//hosts can also ask which scanlines changed since the last frame they showed
+//(findDirtyRows) and convert and upload only those, or nothing at all when
+//the game is paused or sitting on a menu. This compares against a copy of
+//the last frame instead of tracking every write, so pokes, memcpy and the
+//print helper's scrolling into screen memory are all caught the same way
+
+enum FrameTransform {
+    FrameTransform_None,
+    FrameTransform_FlipH,
+    FrameTransform_FlipV,
+    FrameTransform_FlipHV,
+    FrameTransform_Rotate90,
+    FrameTransform_Rotate180,
+    FrameTransform_Rotate270
+};
+
+inline uint32_t colorToArgb8888(const Color col) {
+    return ((uint32_t)col.Alpha << 24) | ((uint32_t)col.Red << 16) | ((uint32_t)col.Green << 8) | col.Blue;
+}
+
+inline uint32_t colorToRgba8888(const Color col) {
+    return ((uint32_t)col.Red << 24) | ((uint32_t)col.Green << 16) | ((uint32_t)col.Blue << 8) | col.Alpha;
+}
+
+inline uint16_t colorToRgb565(const Color col) {
+    return ((col.Red & 0xf8) << 8) | ((col.Green & 0xfc) << 3) | (col.Blue >> 3);
+}
+
+inline Bgr24Col colorToBgr24(const Color col) {
+    Bgr24Col out = { col.Blue, col.Green, col.Red };
+    return out;
+}
+
+//scanlines first to last (inclusive) changed, none when first > last
+struct FrameDirtyRows {
+    int first;
+    int last;
+
+    bool any() const {
+        return first <= last;
+    }
+
+    int count() const {
+        return any() ? last - first + 1 : 0;
+    }
+};
+
+template <typename TPixel>
+class FrameConverter {
+    public:
+    static const int FrameWidth = 128;
+    static const int FrameHeight = 128;
+    static const int BytesPerRow = FrameWidth / 2;
+
+    FrameConverter() {
+        memset(_hostColors, 0, sizeof(_hostColors));
+        memset(_pairs, 0, sizeof(_pairs));
+        memset(_palettes, 0, sizeof(_palettes));
+        _tableValid[0] = false;
+        _tableValid[1] = false;
+        _altLines = nullptr;
+        _hasShownFrame = false;
+    }
+
+    //colors for all 144 palette indexes (0-15 and 128-143), already in the host format
+    void setHostColors(const TPixel* colors) {
+        memcpy(_hostColors, colors, sizeof(_hostColors));
+        _tableValid[0] = false;
+        _tableValid[1] = false;
+        _hasShownFrame = false;
+    }
+
+    template <typename TConvert>
+    void setHostColors(const Color* colors, TConvert convert) {
+        for (int i = 0; i < 144; i++) {
+            _hostColors[i] = convert(colors[i]);
+        }
+        _tableValid[0] = false;
+        _tableValid[1] = false;
+        _hasShownFrame = false;
+    }
+
+    //altPaletteMap and altLines (the 0x5f60 palette and the 0x5f70 scanline
+    //bitfield) are null when the secondary palette is disabled
+    void updateScreenPalette(
+        const uint8_t* screenPaletteMap,
+        const uint8_t* altPaletteMap = nullptr,
+        const uint8_t* altLines = nullptr)
+    {
+        updateTable(0, screenPaletteMap);
+
+        _altLines = altPaletteMap != nullptr ? altLines : nullptr;
+        if (_altLines != nullptr) {
+            updateTable(1, altPaletteMap);
+        }
+    }
+
+    //compares the frame with the one passed in the previous call and returns
+    //the scanlines that differ, then remembers this one. Any change to the
+    //screen palette, the secondary palette or its scanline bitfield, or the
+    //host colors marks every line, as does the first call
+    FrameDirtyRows findDirtyRows(
+        const uint8_t* picoFb,
+        const uint8_t* screenPaletteMap,
+        const uint8_t* altPaletteMap = nullptr,
+        const uint8_t* altLines = nullptr)
+    {
+        uint8_t palettes[48];
+        memcpy(palettes, screenPaletteMap, 16);
+        bool hasAlt = altPaletteMap != nullptr && altLines != nullptr;
+        if (hasAlt) {
+            memcpy(palettes + 16, altPaletteMap, 16);
+            memcpy(palettes + 32, altLines, 16);
+        }
+        else {
+            memset(palettes + 16, 0, 32);
+        }
+
+        FrameDirtyRows rows = { 0, FrameHeight - 1 };
+        if (_hasShownFrame && hasAlt == _shownHasAlt && memcmp(palettes, _shownPalettes, sizeof(palettes)) == 0) {
+            while (rows.first < FrameHeight && rowMatchesShown(picoFb, rows.first)) {
+                rows.first++;
+            }
+            while (rows.last > rows.first && rowMatchesShown(picoFb, rows.last)) {
+                rows.last--;
+            }
+            if (rows.first == FrameHeight) {
+                rows.last = FrameHeight - 1;
+                return rows;
+            }
+        }
+
+        memcpy(_shownFrame + rows.first * BytesPerRow, picoFb + rows.first * BytesPerRow, rows.count() * BytesPerRow);
+        memcpy(_shownPalettes, palettes, sizeof(palettes));
+        _shownHasAlt = hasAlt;
+        _hasShownFrame = true;
+
+        return rows;
+    }
+
+    //forgets the remembered frame, so the next findDirtyRows marks every line.
+    //For hosts that lose their texture or change how it is drawn
+    void invalidateShownFrame() {
+        _hasShownFrame = false;
+    }
+
+    //converts only the given scanlines, untransformed. dest points at the
+    //first of them (the way a locked texture rect does), pitchBytes apart
+    void convertRows(
+        const uint8_t* picoFb,
+        const uint8_t* screenPaletteMap,
+        void* dest,
+        int pitchBytes,
+        FrameDirtyRows rows,
+        const uint8_t* altPaletteMap = nullptr,
+        const uint8_t* altLines = nullptr)
+    {
+        updateScreenPalette(screenPaletteMap, altPaletteMap, altLines);
+
+        uint8_t* destBytes = (uint8_t*)dest;
+        for (int y = rows.first; y <= rows.last; y++) {
+            convertRow(picoFb, y, (TPixel*)(destBytes + (y - rows.first) * pitchBytes));
+        }
+    }
+
+    //converts scanline y of the pico frame buffer with the palette selected for that line
+    void convertRow(const uint8_t* picoFb, int y, TPixel* dest) const {
+        const PixelPair* pairs = pairsForLine(y);
+        const uint8_t* picoRow = picoFb + y * BytesPerRow;
+        for (int i = 0; i < BytesPerRow; i++) {
+            const PixelPair& pair = pairs[picoRow[i]];
+            dest[0] = pair.left;
+            dest[1] = pair.right;
+            dest += 2;
+        }
+    }
+
+    void convertRowReversed(const uint8_t* picoFb, int y, TPixel* dest) const {
+        const PixelPair* pairs = pairsForLine(y);
+        const uint8_t* picoRow = picoFb + y * BytesPerRow;
+        dest += FrameWidth - 1;
+        for (int i = 0; i < BytesPerRow; i++) {
+            const PixelPair& pair = pairs[picoRow[i]];
+            dest[0] = pair.left;
+            dest[-1] = pair.right;
+            dest -= 2;
+        }
+    }
+
+    //dest is a FrameWidth x FrameHeight surface, pitchBytes apart per row
+    void convertFrame(
+        const uint8_t* picoFb,
+        const uint8_t* screenPaletteMap,
+        void* dest,
+        int pitchBytes,
+        FrameTransform transform = FrameTransform_None,
+        const uint8_t* altPaletteMap = nullptr,
+        const uint8_t* altLines = nullptr)
+    {
+        updateScreenPalette(screenPaletteMap, altPaletteMap, altLines);
+
+        uint8_t* destBytes = (uint8_t*)dest;
+
+        switch (transform) {
+            case FrameTransform_None:
+            case FrameTransform_FlipV:
+                for (int y = 0; y < FrameHeight; y++) {
+                    int destY = transform == FrameTransform_FlipV ? FrameHeight - 1 - y : y;
+                    convertRow(picoFb, y, (TPixel*)(destBytes + destY * pitchBytes));
+                }
+                break;
+            case FrameTransform_FlipH:
+            case FrameTransform_FlipHV:
+            case FrameTransform_Rotate180:
+                for (int y = 0; y < FrameHeight; y++) {
+                    int destY = transform == FrameTransform_FlipH ? y : FrameHeight - 1 - y;
+                    convertRowReversed(picoFb, y, (TPixel*)(destBytes + destY * pitchBytes));
+                }
+                break;
+            case FrameTransform_Rotate90:
+            case FrameTransform_Rotate270: {
+                //pico pixel (x, y) goes to row x, column 127 - y when rotated 90
+                //degrees and to row 127 - x, column y when rotated 270 degrees
+                TPixel row[FrameWidth];
+                for (int y = 0; y < FrameHeight; y++) {
+                    convertRow(picoFb, y, row);
+                    if (transform == FrameTransform_Rotate90) {
+                        const int destX = FrameHeight - 1 - y;
+                        for (int x = 0; x < FrameWidth; x++) {
+                            ((TPixel*)(destBytes + x * pitchBytes))[destX] = row[x];
+                        }
+                    }
+                    else {
+                        for (int x = 0; x < FrameWidth; x++) {
+                            ((TPixel*)(destBytes + (FrameWidth - 1 - x) * pitchBytes))[y] = row[x];
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    private:
+    struct PixelPair {
+        TPixel left;
+        TPixel right;
+    };
+
+    void updateTable(int table, const uint8_t* paletteMap) {
+        if (_tableValid[table] && memcmp(_palettes[table], paletteMap, 16) == 0) {
+            return;
+        }
+
+        memcpy(_palettes[table], paletteMap, 16);
+
+        TPixel mapped[16];
+        for (int i = 0; i < 16; i++) {
+            mapped[i] = _hostColors[paletteMap[i] & 0x8f];
+        }
+
+        PixelPair* pairs = _pairs[table];
+        for (int i = 0; i < 256; i++) {
+            pairs[i].left = mapped[i & 0x0f];
+            pairs[i].right = mapped[i >> 4];
+        }
+
+        _tableValid[table] = true;
+    }
+
+    bool rowMatchesShown(const uint8_t* picoFb, int y) const {
+        return memcmp(picoFb + y * BytesPerRow, _shownFrame + y * BytesPerRow, BytesPerRow) == 0;
+    }
+
+    const PixelPair* pairsForLine(int y) const {
+        if (_altLines != nullptr && (_altLines[y >> 3] >> (y & 7)) & 1) {
+            return _pairs[1];
+        }
+        return _pairs[0];
+    }
+
+    TPixel _hostColors[144];
+    //0 is the screen palette, 1 the secondary palette at 0x5f60
+    PixelPair _pairs[2][256];
+    uint8_t _palettes[2][16];
+    bool _tableValid[2];
+    const uint8_t* _altLines;
+
+    //what findDirtyRows saw last: the frame, then the screen palette, the
+    //secondary palette and its scanline bitfield
+    uint8_t _shownFrame[BytesPerRow * FrameHeight];
+    uint8_t _shownPalettes[48];
+    bool _shownHasAlt;
+    bool _hasShownFrame;
+};
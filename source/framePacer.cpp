@@ -0,0 +1,127 @@
+#include <math.h>
+
+#include <thread>
+
+#include "framePacer.h"
+
+FramePacer::FramePacer() :
+    _framePeriod(clock::duration::zero()),
+    _started(false)
+{
+    setTargetFps(30);
+    resetStats();
+}
+
+void FramePacer::setTargetFps(int targetFps) {
+    if (targetFps <= 0) {
+        targetFps = 30;
+    }
+
+    clock::duration framePeriod = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / targetFps));
+
+    if (framePeriod != _framePeriod) {
+        _framePeriod = framePeriod;
+        _started = false;
+    }
+}
+
+void FramePacer::waitForNextFrame(FramePacerSleepFunction sleep) {
+    clock::time_point now = clock::now();
+
+    if (!_started) {
+        _nextDeadline = now + _framePeriod;
+        _started = true;
+    }
+    else if (now >= _nextDeadline) {
+        _missedDeadlines++;
+        _nextDeadline = now + _framePeriod;
+    }
+    else {
+        //sleeps until close to the deadline and only spins the last moments,
+        //as the host's sleep may round down or wake a little late
+        const clock::duration spin = std::chrono::microseconds(FRAME_PACER_SPIN_US);
+        while (now < _nextDeadline) {
+            if (_nextDeadline - now > spin) {
+                auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(_nextDeadline - now - spin);
+                sleep((uint32_t)remaining.count());
+            }
+            else {
+                std::this_thread::yield();
+            }
+            now = clock::now();
+        }
+        if (now > _nextDeadline) {
+            _overshootMsTotal += std::chrono::duration<double, std::milli>(now - _nextDeadline).count();
+        }
+        _sleepCount++;
+
+        _nextDeadline += _framePeriod;
+    }
+
+    recordFrame(now);
+}
+
+void FramePacer::markFrame() {
+    recordFrame(clock::now());
+}
+
+void FramePacer::recordFrame(clock::time_point now) {
+    if (_hasLastFrame) {
+        _frameMs[_framePos] = std::chrono::duration<double, std::milli>(now - _lastFrame).count();
+        _framePos = (_framePos + 1) % FRAME_PACER_WINDOW;
+        if (_frameCount < FRAME_PACER_WINDOW) {
+            _frameCount++;
+        }
+    }
+    _lastFrame = now;
+    _hasLastFrame = true;
+}
+
+double FramePacer::averageFrameMs() const {
+    if (_frameCount == 0) {
+        return 0;
+    }
+
+    double total = 0;
+    for (int i = 0; i < _frameCount; i++) {
+        total += _frameMs[i];
+    }
+    return total / _frameCount;
+}
+
+double FramePacer::measuredFps() const {
+    double average = averageFrameMs();
+    return average > 0 ? 1000.0 / average : 0;
+}
+
+double FramePacer::jitterMs() const {
+    if (_frameCount == 0) {
+        return 0;
+    }
+
+    double average = averageFrameMs();
+    double variance = 0;
+    for (int i = 0; i < _frameCount; i++) {
+        double diff = _frameMs[i] - average;
+        variance += diff * diff;
+    }
+    return sqrt(variance / _frameCount);
+}
+
+uint32_t FramePacer::missedDeadlines() const {
+    return _missedDeadlines;
+}
+
+double FramePacer::averageOvershootMs() const {
+    return _sleepCount > 0 ? _overshootMsTotal / _sleepCount : 0;
+}
+
+void FramePacer::resetStats() {
+    _frameCount = 0;
+    _framePos = 0;
+    _hasLastFrame = false;
+    _missedDeadlines = 0;
+    _overshootMsTotal = 0;
+    _sleepCount = 0;
+}
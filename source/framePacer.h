@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+
+//frames kept for the rolling frame time statistics
+#define FRAME_PACER_WINDOW 60
+
+//the last microseconds before a deadline are spun out instead of slept
+#define FRAME_PACER_SPIN_US 200
+
+//host sleep primitive. May return early, the pacer sleeps again until it is
+//within FRAME_PACER_SPIN_US; time slept past the deadline is measured as
+//overshoot
+typedef void (*FramePacerSleepFunction)(uint32_t microseconds);
+
+//paces frames against absolute deadlines: each deadline is the previous one
+//plus the frame period, so sleep rounding and scheduler overshoot don't add
+//up into drift. Also measures the real frame rate over a rolling window, for
+//stat(7) and for hosts that want to show pacing stats
+class FramePacer {
+    typedef std::chrono::steady_clock clock;
+
+    clock::duration _framePeriod;
+    clock::time_point _nextDeadline;
+    clock::time_point _lastFrame;
+    bool _hasLastFrame;
+    bool _started;
+
+    double _frameMs[FRAME_PACER_WINDOW];
+    int _frameCount;
+    int _framePos;
+
+    uint32_t _missedDeadlines;
+    double _overshootMsTotal;
+    uint32_t _sleepCount;
+
+    void recordFrame(clock::time_point now);
+
+    public:
+    FramePacer();
+
+    void setTargetFps(int targetFps);
+
+    //sleeps until the current frame's deadline and then records the frame.
+    //A frame that is already late counts as a missed deadline, and the
+    //schedule restarts from now instead of rushing to catch up
+    void waitForNextFrame(FramePacerSleepFunction sleep);
+
+    //records a frame without waiting, for code that is paced elsewhere
+    //(vsync, a libretro frontend) but still wants the statistics
+    void markFrame();
+
+    //frames per second over the window, 0 until two frames were seen
+    double measuredFps() const;
+    double averageFrameMs() const;
+    //standard deviation of the frame time over the window
+    double jitterMs() const;
+    uint32_t missedDeadlines() const;
+    //average time sleep returned after the deadline
+    double averageOvershootMs() const;
+
+    void resetStats();
+};
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <string>
 #include <algorithm>
 #include <vector>
@@ -25,6 +26,8 @@ using namespace z8;
 //call initialize to make sure defaults are correct
 Graphics::Graphics(std::string fontdata, PicoRam* memory) {
 	_memory = memory;
+	_spriteBlitLutValid = false;
+	_penSpanValid = false;
 	
 	copy_string_to_sprite_memory(fontSpriteData, fontdata);
 
@@ -35,26 +38,186 @@ Graphics::Graphics(std::string fontdata, PicoRam* memory) {
 }
 
 
-uint8_t* Graphics::GetP8FrameBuffer(){
-	return _memory->hwState.screenDataMemMapping == 0 
+Surface Graphics::screenSurface(){
+	Surface surface;
+	surface.data = _memory->hwState.screenDataMemMapping == 0 
 		? _memory->spriteSheetData 
 		: _memory->screenBuffer;
+	surface.pitch = 64;
+	surface.width = 128;
+	surface.height = 128;
+	return surface;
 }
 
-uint8_t* Graphics::GetP8SpriteSheetBuffer(){
-	return _memory->hwState.spriteSheetMemMapping == 0x60
+Surface Graphics::spriteSheetSurface(){
+	Surface surface;
+	surface.data = _memory->hwState.spriteSheetMemMapping == 0x60
 		? _memory->screenBuffer 
 		: _memory->spriteSheetData;
+	surface.pitch = 64;
+	surface.width = 128;
+	surface.height = 128;
+	return surface;
+}
+
+uint8_t* Graphics::GetP8FrameBuffer(){
+	return screenSurface().data;
+}
+
+uint8_t* Graphics::GetP8SpriteSheetBuffer(){
+	return spriteSheetSurface().data;
 }
 
 uint8_t* Graphics::GetScreenPaletteMap(){
 	return _memory->drawState.screenPaletteMap;
 }
 
+uint8_t* Graphics::GetAltScreenPaletteMap(){
+	return _memory->hwState.alternatePaletteFlag & 0x10
+		? _memory->hwState.alternatePaletteMap
+		: nullptr;
+}
+
+uint8_t* Graphics::GetAltScreenPaletteLines(){
+	return _memory->hwState.alternatePaletteFlag & 0x10
+		? _memory->hwState.alternatePaletteScreenLineBitfield
+		: nullptr;
+}
+
 //start helper methods
+
+//read/write 8 packed pixels at once. bytes are assembled explicitly so the
+//nibble order is the same on big endian platforms
+static inline uint32_t readPixelWord(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void writePixelWord(uint8_t* p, uint32_t word) {
+	p[0] = (uint8_t)word;
+	p[1] = (uint8_t)(word >> 8);
+	p[2] = (uint8_t)(word >> 16);
+	p[3] = (uint8_t)(word >> 24);
+}
+
+//copies count bytes of a row starting at first (which may be -1 or run
+//past the end of the row), zero filling anything outside the row
+static inline void copySpriteRowSpan(uint8_t* dest, const uint8_t* row, int rowBytes, int first, int count) {
+	for (int i = 0; i < count; i++) {
+		int idx = first + i;
+		dest[i] = idx >= 0 && idx < rowBytes ? row[idx] : 0;
+	}
+}
+
+//repacks a row of sprite pixels so that stage[i] holds the 2 pixels that land on screen byte i.
+//srcPixStart is the row pixel that lands on the first pixel of the first screen byte (when
+//flipped, pixels are taken walking backwards from it). Returns either the row itself (when
+//the alignment already matches) or stageBuffer
+static const uint8_t* stageSpriteRow(
+	const uint8_t* row,
+	int rowBytes,
+	int srcPixStart,
+	int byteCount,
+	bool flip_x,
+	bool aliased,
+	uint8_t* span,
+	uint8_t* stageBuffer)
+{
+	if (!flip_x) {
+		if ((srcPixStart & 1) == 0) {
+			//same alignment on sprite sheet and screen- bytes can be used as is
+			//(unless the sprite sheet and screen are mapped to the same memory)
+			const uint8_t* stage = row + (srcPixStart >> 1);
+			if (aliased) {
+				memcpy(stageBuffer, stage, byteCount);
+				return stageBuffer;
+			}
+			return stage;
+		}
+
+		//off by one pixel: shift everything down a nibble, 8 pixels at a time
+		copySpriteRowSpan(span, row, rowBytes, (srcPixStart - 1) >> 1, byteCount + 1);
+		int i = 0;
+		for (; i + 4 <= byteCount; i += 4) {
+			uint32_t word = readPixelWord(span + i);
+			writePixelWord(stageBuffer + i, (word >> 4) | ((uint32_t)span[i + 4] << 28));
+		}
+		for (; i < byteCount; i++) {
+			stageBuffer[i] = (span[i] >> 4) | (span[i + 1] << 4);
+		}
+		return stageBuffer;
+	}
+
+	//flipped: walk backwards through the row, swapping the pixels in each byte
+	if (srcPixStart & 1) {
+		copySpriteRowSpan(span, row, rowBytes, (srcPixStart >> 1) - byteCount + 1, byteCount);
+		for (int i = 0; i < byteCount; i++) {
+			uint8_t b = span[byteCount - 1 - i];
+			stageBuffer[i] = (b >> 4) | (b << 4);
+		}
+	}
+	else {
+		copySpriteRowSpan(span, row, rowBytes, (srcPixStart >> 1) - byteCount, byteCount + 1);
+		for (int i = 0; i < byteCount; i++) {
+			stageBuffer[i] = (span[byteCount - i] & 0x0f) | (span[byteCount - 1 - i] & 0xf0);
+		}
+	}
+	return stageBuffer;
+}
+
+//the blitter works on bytes of 2 pixels, so the draw palette is expanded to
+//every possible pixel pair. Only rebuilt when the draw palette changes
+void Graphics::updateSpriteBlitLut() {
+	const uint8_t* drawPaletteMap = _memory->drawState.drawPaletteMap;
+
+	if (_spriteBlitLutValid && memcmp(_spriteBlitLutPalette, drawPaletteMap, 16) == 0) {
+		return;
+	}
+
+	for (int b = 0; b < 256; b++) {
+		const uint8_t lo = drawPaletteMap[b & 0x0f];
+		const uint8_t hi = drawPaletteMap[b >> 4];
+
+		_spriteBlitColors[b] = (lo & 0x0f) | (hi << 4);
+		//upper bits indicate transparency
+		_spriteBlitOpaque[b] = ((lo >> 4) ? 0 : 0x0f) | ((hi >> 4) ? 0 : 0xf0);
+	}
+
+	memcpy(_spriteBlitLutPalette, drawPaletteMap, 16);
+	_spriteBlitLutValid = true;
+}
+
+//writes a staged row to the screen 2 pixels at a time. writeMask and colorMask are the
+//0x5f5e read/write masks expanded to both nibbles (0xff when not in use)
+void Graphics::writeSpriteRow(
+	uint8_t* dest,
+	const uint8_t* stage,
+	int byteCount,
+	uint8_t firstByteMask,
+	uint8_t lastByteMask,
+	uint8_t writeMask,
+	uint8_t colorMask)
+{
+	const int last = byteCount - 1;
+
+	for (int i = 0; i <= last; i++) {
+		const uint8_t src = stage[i];
+		uint8_t mask = _spriteBlitOpaque[src] & writeMask;
+		if (i == 0) {
+			mask &= firstByteMask;
+		}
+		if (i == last) {
+			mask &= lastByteMask;
+		}
+		dest[i] = (dest[i] & ~mask) | (_spriteBlitColors[src] & colorMask & mask);
+	}
+}
+
 //based on tac08 implementation of blitter()
+//each sprite row is repacked so its pixel pairs line up with the screen bytes they land on,
+//then written a byte (2 pixels) at a time with draw palette and transparency from a lookup table
 void Graphics::copySpriteToScreen(
-	uint8_t* spritebuffer,
+	const Surface &sprites,
+	const Surface &screen,
 	int scr_x,
 	int scr_y,
 	int spr_x,
@@ -71,10 +234,6 @@ void Graphics::copySpriteToScreen(
 
 	auto &drawState = _memory->drawState;
 	auto &hwState = _memory->hwState;
-	uint8_t *screenBuffer = GetP8FrameBuffer();
-	
-	const uint8_t writeMask = hwState.colorBitmask & 15;
-	const uint8_t readMask = hwState.colorBitmask >> 4;
 
 	scr_x -= drawState.camera_x;
 	scr_y -= drawState.camera_y;
@@ -114,95 +273,76 @@ void Graphics::copySpriteToScreen(
 		int nclip = (scr_y + scr_h) - drawState.clip_ye;
 		scr_h -= nclip;
 	}
-	uint8_t lastScreenBuffByte = 0;
-	int lastScreenBuffIdx = -1;
 
-	bool startWithHalf = false;
-	//starting with odd pixel
-	if (BITMASK(0) & spr_x) {
-		startWithHalf = true;
+	//only columns that are on the sprite sheet get drawn (sprites don't wrap)
+	//screen column i shows sprite column spr_x + i (or spr_x + spr_w - 1 - i flipped)
+	int firstCol = 0;
+	int endCol = scr_w;
+	if (!flip_x) {
+		firstCol = std::max(firstCol, -spr_x);
+		endCol = std::min(endCol, 128 - spr_x);
+	}
+	else {
+		firstCol = std::max(firstCol, spr_x + spr_w - 128);
+		endCol = std::min(endCol, spr_x + spr_w);
 	}
 
-	//since we get 2 pixels at a time, don't go through this whole loop every pixel
-	for (int y = 0; y < scr_h; y++) {
-		int x = 0;
-		while (x < scr_w) {
-			int abs_spr_x = spr_x + (flip_x ? spr_w - (x + 1) : x);
-			int abs_spr_y = spr_y + (flip_y ? spr_h - (y + 1) : y);
-			if (!IS_VALID_SPR_IDX(abs_spr_x, abs_spr_y)){
-				++x;
-				continue;
-			}
-			uint8_t bothPix = spritebuffer[COMBINED_IDX(abs_spr_x, abs_spr_y)];
-
-			//uint8_t c = (BITMASK(0) & abs_spr_x)== 0 
-			//			? bothPix & 0x0f //just first 4 bits
-			//			: bothPix >> 4;  //just last 4 bits
-			uint8_t lc = bothPix & 0x0f;
-			uint8_t rc = bothPix >> 4;
-			
-			const int finaly = scr_y + y;
-			int finalx = scr_x + (flip_x ? x + 1 : x);
-			
-			if (x > 0 || !startWithHalf){
-				if (!(drawState.drawPaletteMap[lc] >> 4)){
-					lc = drawState.drawPaletteMap[lc] & 0x0f;
-
-					int screenPixelIdx = COMBINED_IDX(finalx, finaly);
-					if (lastScreenBuffIdx != screenPixelIdx) {
-						lastScreenBuffByte = screenBuffer[screenPixelIdx];
-						lastScreenBuffIdx = screenPixelIdx;
-					}
-
-					uint8_t source = (BITMASK(0) & finalx) == 0 
-						? lastScreenBuffByte & 0x0f //just first 4 bits
-						: lastScreenBuffByte >> 4;
+	if (endCol <= firstCol || scr_h <= 0) {
+		return;
+	}
 
-					lc = (source & ~writeMask) | (lc & writeMask & readMask);
+	updateSpriteBlitLut();
 
-					setPixelNibble(finalx, finaly, lc, screenBuffer);
-				}
-				++x;
-				if (flip_x){
-					--finalx;
-				}
-				else {
-					++finalx;
-				}
-			}
+	//from pico 8 wiki:
+	//dst_color = (dst_color & ~write_mask) | (src_color & write_mask & read_mask)
+	//expanded to both nibbles so it can be folded into the per byte transparency mask
+	const uint8_t writeMask = (hwState.colorBitmask & 0x0f) * 0x11;
+	const uint8_t colorMask = writeMask & ((hwState.colorBitmask >> 4) * 0x11);
 
-			if (x < scr_w) {
-				if (!(drawState.drawPaletteMap[rc] >> 4)){
-					rc = drawState.drawPaletteMap[rc] & 0x0f;
+	const int destX = scr_x + firstCol;
+	const int width = endCol - firstCol;
+	const int lead = destX & 1;
+	//number of screen bytes touched by each row
+	const int byteCount = (lead + width + 1) >> 1;
 
-					int screenPixelIdx = COMBINED_IDX(finalx, finaly);
-					if (lastScreenBuffIdx != screenPixelIdx) {
-						lastScreenBuffByte = screenBuffer[screenPixelIdx];
-						lastScreenBuffIdx = screenPixelIdx;
-					}
+	const uint8_t firstByteMask = lead ? 0xf0 : 0xff;
+	const uint8_t lastByteMask = ((lead + width) & 1) ? 0x0f : 0xff;
 
-					uint8_t source = (BITMASK(0) & finalx) == 0 
-						? lastScreenBuffByte & 0x0f //just first 4 bits
-						: lastScreenBuffByte >> 4;
+	//sprite pixel that lands on the first pixel of the first screen byte (may be half off the edge)
+	const int srcPixStart = flip_x
+		? spr_x + spr_w - 1 - firstCol + lead
+		: spr_x + firstCol - lead;
 
-					rc = (source & ~writeMask) | (rc & writeMask & readMask);
+	const bool aliased = sprites.data == screen.data;
 
-					setPixelNibble(finalx, finaly, rc, screenBuffer);
-				}
+	uint8_t span[72];
+	uint8_t stageBuffer[72];
 
-				//we did two pixels so do an extra increment
-				++x;
-			}
-			
+	for (int y = 0; y < scr_h; y++) {
+		const int sprY = flip_y ? spr_y + spr_h - 1 - y : spr_y + y;
+		if (sprY < 0 || sprY > 127) {
+			continue;
 		}
 
+		const uint8_t* stage = stageSpriteRow(
+			sprites.row(sprY), sprites.pitch, srcPixStart, byteCount, flip_x, aliased, span, stageBuffer);
+
+		writeSpriteRow(
+			screen.row(scr_y + y) + (destX >> 1),
+			stage,
+			byteCount,
+			firstByteMask,
+			lastByteMask,
+			writeMask,
+			colorMask);
 	}
 }
 
 //based on tac08 implementation of stretch_blitter()
 //uses ints so we can shift bits and do integer division instead of floating point
 void Graphics::copyStretchSpriteToScreen(
-	uint8_t* spritebuffer,
+	const Surface &sprites,
+	const Surface &screen,
 	int spr_x,
 	int spr_y,
 	int spr_w,
@@ -220,16 +360,15 @@ void Graphics::copyStretchSpriteToScreen(
 	if (scr_w == 0 || scr_h == 0)
 		return;
 
-	if (spr_h == scr_h && spr_w == scr_w && !flip_x) {
+	if (spr_h == scr_h && spr_w == scr_w) {
 		// use faster non stretch blitter if sprite is not stretched 
-		//(or flipped horizontally - but skipping for that is just a hacky fix)
-		copySpriteToScreen(spritebuffer, scr_x, scr_y, spr_x, spr_y, scr_w, scr_h, flip_x, flip_y);
+		copySpriteToScreen(sprites, screen, scr_x, scr_y, spr_x, spr_y, scr_w, scr_h, flip_x, flip_y);
 		return;
 	}
 
 	auto &drawState = _memory->drawState;
 	auto &hwState = _memory->hwState;
-	uint8_t *screenBuffer = GetP8FrameBuffer();
+	uint8_t *screenBuffer = screen.data;
 
 	const uint8_t writeMask = hwState.colorBitmask & 15;
 	const uint8_t readMask = hwState.colorBitmask >> 4;
@@ -308,7 +447,7 @@ void Graphics::copyStretchSpriteToScreen(
 			if (sprY > 127) {
 				continue;
 			}
-			uint8_t* spr = spritebuffer + (sprY * 64);
+			const uint8_t* spr = sprites.row(sprY);
 
 			if (skipStretchPx && prevSprY == sprY){
 				continue;
@@ -368,7 +507,7 @@ void Graphics::copyStretchSpriteToScreen(
 			if (sprY > 127) {
 				continue;
 			}
-			uint8_t* spr = spritebuffer + (sprY) * 64;
+			const uint8_t* spr = sprites.row(sprY);
 
 			if (!flip_x) {
 				for (int x = 0; x < scr_w; x++) {
@@ -617,7 +756,8 @@ void Graphics::cls() {
 void Graphics::cls(uint8_t color) {
 	color = color & 15;
 	uint8_t val = color << 4 | color;
-	memset(GetP8FrameBuffer(), val, sizeof(_memory->screenBuffer));
+	const Surface screen = screenSurface();
+	memset(screen.data, val, screen.pitch * screen.height);
 
 	_memory->drawState.text_x = 0;
 	_memory->drawState.text_y = 0;
@@ -693,15 +833,136 @@ void Graphics::line (int x1, int y1, int x2, int y2){
 	this->line(x1, y1, x2, y2, _memory->drawState.color);
 }
 
-void Graphics::_private_h_line(int x1, int x2, int y){
+//expands the pen for the span filler. Only rebuilt when the pen colour, fill
+//pattern, bitmask or draw palette changed since the last filled primitive
+void Graphics::updatePenSpans() {
 	auto &drawState = _memory->drawState;
 	auto &hwState = _memory->hwState;
 
+	uint8_t key[sizeof(_penSpanKey)];
+	key[0] = drawState.color;
+	key[1] = drawState.fillPattern[0];
+	key[2] = drawState.fillPattern[1];
+	key[3] = drawState.fillPatternTransparencyBit & 1;
+	key[4] = hwState.colorBitmask;
+	memcpy(key + 5, drawState.drawPaletteMap, 16);
+
+	if (_penSpanValid && memcmp(_penSpanKey, key, sizeof(key)) == 0) {
+		return;
+	}
+
+	const uint16_t fillp = ((uint16_t)drawState.fillPattern[1] << 8) + drawState.fillPattern[0];
+	const bool altTransparent = key[3];
+	const uint8_t col0 = drawState.drawPaletteMap[drawState.color & 0x0f] & 0x0f;
+	const uint8_t col1 = drawState.drawPaletteMap[drawState.color >> 4] & 0x0f;
+
+	//from pico 8 wiki:
+	//dst_color = (dst_color & ~write_mask) | (src_color & write_mask & read_mask)
+	const uint8_t writeMask = hwState.colorBitmask & 15;
+	const uint8_t readMask = hwState.colorBitmask >> 4;
+
+	for (int row = 0; row < 4; row++) {
+		for (int b = 0; b < 2; b++) {
+			uint8_t value = 0;
+			uint8_t mask = 0;
+
+			//left pixel of the pair is the low nibble
+			for (int half = 0; half < 2; half++) {
+				const int bitPlace = 15 - (b * 2 + half + 4 * row);
+				const bool altColor = (fillp >> bitPlace) & 0x1;
+				if (altColor && altTransparent) {
+					continue;
+				}
+
+				const uint8_t col = altColor ? col1 : col0;
+				value |= (col & writeMask & readMask) << (half * 4);
+				mask |= writeMask << (half * 4);
+			}
+
+			_penSpanRows[row].colors[b] = value;
+			_penSpanRows[row].masks[b] = mask;
+		}
+	}
+
+	memcpy(_penSpanKey, key, sizeof(key));
+	_penSpanValid = true;
+}
+
+//fills pixels minx to maxx (already clipped) of row y with the pen spans, a byte
+//(2 pixels) at a time in the middle of the span and 8 pixels at a time where possible
+void Graphics::fillPenSpan(const Surface &screen, int minx, int maxx, int y) {
+	const PenSpanRow &row = _penSpanRows[y & 3];
+	uint8_t *p = screen.row(y);
+
+	int first = minx >> 1;
+	const int last = maxx >> 1;
+	const uint8_t firstByteMask = (minx & 1) ? 0xf0 : 0xff;
+	const uint8_t lastByteMask = (maxx & 1) ? 0xff : 0x0f;
+
+	if (first == last) {
+		const uint8_t mask = row.masks[first & 1] & firstByteMask & lastByteMask;
+		p[first] = (p[first] & ~mask) | (row.colors[first & 1] & mask);
+		return;
+	}
+
+	if (firstByteMask != 0xff) {
+		const uint8_t mask = row.masks[first & 1] & firstByteMask;
+		p[first] = (p[first] & ~mask) | (row.colors[first & 1] & mask);
+		first++;
+	}
+
+	int end = last + 1;
+	if (lastByteMask != 0xff) {
+		const uint8_t mask = row.masks[last & 1] & lastByteMask;
+		p[last] = (p[last] & ~mask) | (row.colors[last & 1] & mask);
+		end--;
+	}
+
+	const bool opaque = row.masks[0] == 0xff && row.masks[1] == 0xff;
+
+	if (opaque && row.colors[0] == row.colors[1]) {
+		//no pattern (or a pattern of 2 equal colours)
+		memset(p + first, row.colors[0], end - first);
+		return;
+	}
+
+	int i = first;
+	if (i & 1 && i < end) {
+		p[i] = (p[i] & ~row.masks[1]) | row.colors[1];
+		i++;
+	}
+
+	//i is even here, so byte parity lines up with the words
+	const uint32_t colorWord = row.colors[0] * 0x00010001u + row.colors[1] * 0x01000100u;
+	const uint32_t maskWord = row.masks[0] * 0x00010001u + row.masks[1] * 0x01000100u;
+
+	if (opaque) {
+		for (; i + 4 <= end; i += 4) {
+			writePixelWord(p + i, colorWord);
+		}
+	}
+	else {
+		for (; i + 4 <= end; i += 4) {
+			writePixelWord(p + i, (readPixelWord(p + i) & ~maskWord) | colorWord);
+		}
+	}
+
+	for (; i < end; i++) {
+		const int k = i & 1;
+		p[i] = (p[i] & ~row.masks[k]) | row.colors[k];
+	}
+}
+
+void Graphics::_private_h_line(const Surface &screen, int x1, int x2, int y){
+	auto &drawState = _memory->drawState;
+
 	if (!(y >= drawState.clip_yb && y < drawState.clip_ye)) {
 		return;
 	}
 
-	if ((x1 < drawState.clip_xb && x2 < drawState.clip_xb) ||
+	//an empty clip rect would clamp the span to just outside of it
+	if (drawState.clip_xb >= drawState.clip_xe ||
+		(x1 < drawState.clip_xb && x2 < drawState.clip_xb) ||
 		(x1 > drawState.clip_xe && x2 > drawState.clip_xe)) {
 			return;
 	}
@@ -716,49 +977,18 @@ void Graphics::_private_h_line(int x1, int x2, int y){
 		(int)drawState.clip_xb,
 		(int)drawState.clip_xe - 1);
 
-	bool canmemset = hwState.colorBitmask == 0xff && 
-		drawState.fillPattern[0] == 0 && 
-		drawState.fillPattern[1] == 0 &&
-		maxx - minx > 1;
-
-	if (canmemset) {
-		//zepto 8 adapted otimized line draw with memset
-		uint8_t *p = _memory->screenBuffer + (y*64);
-        uint8_t color = getDrawPalMappedColor(drawState.color);
-
-        if (minx & 1)
-        {
-			
-            p[minx / 2] = (p[minx / 2] & 0x0f) | (color << 4);
-            ++minx;
-        }
-
-        if ((maxx & 1) == 0)
-        {
-			
-            p[maxx / 2] = (p[maxx / 2] & 0xf0) | color;
-            --maxx;
-        }
-
-        memset(p + minx / 2, color * 0x11, (maxx - minx + 1) / 2);
-	}
-	else {
-		for (int x = minx; x <= maxx; x++){
-			_setPixelFromPen(x, y);
-		}
-	}
+	fillPenSpan(screen, minx, maxx, y);
 }
 
-void Graphics::_private_v_line (int y1, int y2, int x){
+void Graphics::_private_v_line (const Surface &screen, int y1, int y2, int x){
 	auto &drawState = _memory->drawState;
-	auto &hwState = _memory->hwState;
-	uint8_t * screenBuffer = GetP8FrameBuffer();
 
 	if (!(x >= drawState.clip_xb && x < drawState.clip_xe)) {
 		return;
 	}
 
-	if ((y1 < drawState.clip_yb && y2 < drawState.clip_yb) ||
+	if (drawState.clip_yb >= drawState.clip_ye ||
+		(y1 < drawState.clip_yb && y2 < drawState.clip_yb) ||
 		(y1 > drawState.clip_ye && y2 > drawState.clip_ye)) {
 			return;
 	}
@@ -773,25 +1003,39 @@ void Graphics::_private_v_line (int y1, int y2, int x){
 		(int)drawState.clip_yb,
 		(int)drawState.clip_ye - 1);
 
-	bool skipPen = hwState.colorBitmask == 0xff && 
-		drawState.fillPattern[0] == 0 && 
-		drawState.fillPattern[1] == 0;
+	const int k = (x >> 1) & 1;
+	const uint8_t nibbleMask = (x & 1) ? 0xf0 : 0x0f;
 
-	if (skipPen) {
-		uint8_t color = getDrawPalMappedColor(drawState.color);
-		uint8_t mask = (x & 1) ? 0x0f : 0xf0;
-		uint8_t nibble = (x & 1) ? color << 4 : color;
+	for (int y = miny; y <= maxy; y++) {
+		const PenSpanRow &row = _penSpanRows[y & 3];
+		const uint8_t mask = row.masks[k] & nibbleMask;
+		auto &data = screen.row(y)[x >> 1];
+		data = (data & ~mask) | (row.colors[k] & mask);
+	}
+}
 
-		for (int16_t y = miny; y <= maxy; ++y)
-        {
-			int pixIdx = COMBINED_IDX(x, y);
-            auto &data = screenBuffer[pixIdx];
-            data = (data & mask) | nibble;
-        }
+Graphics::RowSpans::RowSpans() {
+	for (int y = 0; y < 128; y++) {
+		minx[y] = INT_MAX;
+		maxx[y] = INT_MIN;
 	}
-	else {
-		for (int y = miny; y <= maxy; y++){
-			_setPixelFromPen(x, y);
+}
+
+void Graphics::RowSpans::add(int x1, int x2, int y) {
+	if (y < 0 || y > 127) {
+		return;
+	}
+
+	minx[y] = std::min(minx[y], std::min(x1, x2));
+	maxx[y] = std::max(maxx[y], std::max(x1, x2));
+}
+
+void Graphics::fillRowSpans(const Surface &screen, const RowSpans &spans) {
+	const int endy = std::min((int)_memory->drawState.clip_ye, 128);
+
+	for (int y = _memory->drawState.clip_yb; y < endy; y++) {
+		if (spans.minx[y] <= spans.maxx[y]) {
+			_private_h_line(screen, spans.minx[y], spans.maxx[y], y);
 		}
 	}
 }
@@ -805,13 +1049,15 @@ void Graphics::line(int x0, int y0, int x1, int y1, uint8_t col) {
 	applyCameraToPoint(&x1, &y1);
 
 	color(col);
+	updatePenSpans();
+	const Surface screen = screenSurface();
 
 	//vertical line
 	if (x0 == x1) {
-		_private_v_line(y0, y1, x0);
+		_private_v_line(screen, y0, y1, x0);
 	} 
 	else if (y0 == y1) {
-		_private_h_line(x0, x1, y0);
+		_private_h_line(screen, x0, x1, y0);
 	}
 	else {
 		//tac08 line impl for diagonals (this should work for horizontal and vertical as well,
@@ -861,6 +1107,8 @@ fix32 getTlineMask(uint8_t dim){
 
 //ported from zepto 8 impl
 void Graphics::tline(int x0, int y0, int x1, int y1, fix32 mx, fix32 my, fix32 mdx, fix32 mdy){
+	const Surface sprites = spriteSheetSurface();
+
 	applyCameraToPoint(&x0, &y0);
 	applyCameraToPoint(&x1, &y1);
 
@@ -909,7 +1157,7 @@ void Graphics::tline(int x0, int y0, int x1, int y1, fix32 mx, fix32 my, fix32 m
 			uint8_t col = getPixelNibble(
 				spr_x + (int(mx << 3) & 0x7),
 				spr_y + (int(my << 3) & 0x7),
-				_memory->spriteSheetData);
+				sprites.data);
 
             if (!isColorTransparent(col) && isWithinClip(x, y)) {
                 _setPixelFromSprite(x, y, col);
@@ -988,6 +1236,8 @@ void Graphics::circfill(int ox, int oy, int r){
 
 void Graphics::circfill(int ox, int oy, int r, uint8_t col){
 	color(col);
+	updatePenSpans();
+	const Surface screen = screenSurface();
 
 	applyCameraToPoint(&ox, &oy);
 
@@ -996,20 +1246,25 @@ void Graphics::circfill(int ox, int oy, int r, uint8_t col){
 	}
 	else if (r == 1) {
 		_safeSetPixelFromPen(ox, oy - 1);
-		_private_h_line(ox-1, ox+1, oy);
+		_private_h_line(screen, ox-1, ox+1, oy);
 		_safeSetPixelFromPen(ox, oy + 1);
 	}
 	else if (r > 0) {
+		//the outline steps through each row several times and mirrors onto
+		//the middle one, so collect the widest span of each row first
+		RowSpans spans;
 		int x = -r, y = 0, err = 2 - 2 * r;
 		do {
-			_private_h_line(ox - x, ox + x, oy + y);
-			_private_h_line(ox - x, ox + x, oy - y);
+			spans.add(ox - x, ox + x, oy + y);
+			spans.add(ox - x, ox + x, oy - y);
 			r = err;
 			if (r > x)
 				err += ++x * 2 + 1;
 			if (r <= y)
 				err += ++y * 2 + 1;
 		} while (x < 0);
+
+		fillRowSpans(screen, spans);
 	}
 }
 
@@ -1115,6 +1370,8 @@ void Graphics::ovalfill(int x0, int y0, int x1, int y1) {
 //https://stackoverflow.com/a/8448181
 void Graphics::ovalfill(int x0, int y0, int x1, int y1, uint8_t col){
 	color(col);
+	updatePenSpans();
+	const Surface screen = screenSurface();
 
 	applyCameraToPoint(&x0, &y0);
 	applyCameraToPoint(&x1, &y1);
@@ -1135,7 +1392,12 @@ void Graphics::ovalfill(int x0, int y0, int x1, int y1, uint8_t col){
     int bsq = yr * yr;
     int xa, ya;
 
-	_private_v_line(yc+yr, yc-yr, xc);
+	//spans are collected per row (both halves of the outline revisit rows)
+	//and filled once at the end. The centre column covers the tips
+	RowSpans spans;
+	for (int y = std::max(yc - yr, 0); y <= std::min(yc + yr, 127); y++) {
+		spans.add(xc, xc, y);
+	}
 
     wx = 0;
     wy = yr;
@@ -1159,11 +1421,11 @@ void Graphics::ovalfill(int x0, int y0, int x1, int y1, uint8_t col){
         	break;
 		}
 
-		_private_h_line(xc+wx, xc-wx, yc-wy);
-		_private_h_line(xc+wx, xc-wx, yc+wy);
+		spans.add(xc+wx, xc-wx, yc-wy);
+		spans.add(xc+wx, xc-wx, yc+wy);
     }
 
-	_private_h_line(xc+xr, xc-xr, yc);
+	spans.add(xc+xr, xc-xr, yc);
 
     wx = xr;
     wy = 0;
@@ -1191,9 +1453,11 @@ void Graphics::ovalfill(int x0, int y0, int x1, int y1, uint8_t col){
 			break;
 		}
 
-		_private_h_line(xc+wx, xc-wx, yc-wy);
-		_private_h_line(xc+wx, xc-wx, yc+wy);
+		spans.add(xc+wx, xc-wx, yc-wy);
+		spans.add(xc+wx, xc-wx, yc+wy);
     }
+
+	fillRowSpans(screen, spans);
 	/*
 	//this algo doesn't like up correctly
 	//center line
@@ -1221,6 +1485,8 @@ void Graphics::rect(int x1, int y1, int x2, int y2) {
 
 void Graphics::rect(int x1, int y1, int x2, int y2, uint8_t col) {
 	_memory->drawState.color = col;
+	updatePenSpans();
+	const Surface screen = screenSurface();
 
 	//applyCameraToPoint(&x1, &y1);
 	x1 -= _memory->drawState.camera_x;
@@ -1242,11 +1508,11 @@ void Graphics::rect(int x1, int y1, int x2, int y2, uint8_t col) {
 		y2 = temp;
 	}
 
-	_private_h_line(x1, x2, y1);
-	_private_h_line(x1, x2, y2);
+	_private_h_line(screen, x1, x2, y1);
+	_private_h_line(screen, x1, x2, y2);
 
-	_private_v_line(y1, y2, x1);
-	_private_v_line(y1, y2, x2);
+	_private_v_line(screen, y1, y2, x1);
+	_private_v_line(screen, y1, y2, x2);
 }
 
 void Graphics::rectfill(int x1, int y1, int x2, int y2) {
@@ -1257,6 +1523,8 @@ void Graphics::rectfill(int x1, int y1, int x2, int y2, uint8_t col) {
 	auto &drawState = _memory->drawState;
 
 	drawState.color = col;
+	updatePenSpans();
+	const Surface screen = screenSurface();
 
 	//applyCameraToPoint(&x1, &y1);
 	x1 -= drawState.camera_x;
@@ -1279,7 +1547,7 @@ void Graphics::rectfill(int x1, int y1, int x2, int y2, uint8_t col) {
 	}
 
 	for (int y = y1; y <= y2; y++) {
-		_private_h_line(x1, x2, y);
+		_private_h_line(screen, x1, x2, y);
 	}
 }
 
@@ -1440,7 +1708,7 @@ void Graphics::spr(
 	int spr_y = (n / 16) * 8;
 	int16_t spr_w = (int16_t)(w * (fix32)8);
 	int16_t spr_h = (int16_t)(h * (fix32)8);
-	copySpriteToScreen(GetP8SpriteSheetBuffer(), x, y, spr_x, spr_y, spr_w, spr_h, flip_x, flip_y);
+	copySpriteToScreen(spriteSheetSurface(), screenSurface(), x, y, spr_x, spr_y, spr_w, spr_h, flip_x, flip_y);
 }
 
 void Graphics::sspr(
@@ -1455,7 +1723,7 @@ void Graphics::sspr(
         bool flip_x = false,
         bool flip_y = false)
 {
-	copyStretchSpriteToScreen(GetP8SpriteSheetBuffer(), sx, sy, sw, sh, dx, dy, dw, dh, flip_x, flip_y, false);
+	copyStretchSpriteToScreen(spriteSheetSurface(), screenSurface(), sx, sy, sw, sh, dx, dy, dw, dh, flip_x, flip_y, false);
 }
 
 bool Graphics::fget(uint8_t n, uint8_t f){
@@ -1597,12 +1865,119 @@ void Graphics::map(int celx, int cely, int sx, int sy, int celw, int celh) {
 	map(celx, cely, sx, sy, celw, celh, 0);
 }
 
+//tile index containing pixel offset v (rounds towards negative infinity)
+static inline int tileFloor(int v) {
+	return v >= 0 ? v / 8 : -((7 - v) / 8);
+}
+
+//equivalent to calling spr() for every non empty cell, but the map memory mapping, camera and
+//clip are only resolved once. Tile rows and columns outside the clip rect are skipped, and
+//each run of adjacent visible tiles is drawn a scanline at a time by the sprite row blitter
 void Graphics::map(int celx, int cely, int sx, int sy, int celw, int celh, uint8_t layer) {
-	for (int y = 0; y < celh; y++) {
-		for (int x = 0; x < celw; x++) {
-			uint8_t cell = mget(celx + x, cely + y);
-			if (cell && ((layer == 0) || (fget(cell) & layer))) {
-				spr(cell, sx + x * 8, sy + y * 8);
+	auto &drawState = _memory->drawState;
+	auto &hwState = _memory->hwState;
+
+	//same map memory rules as mget
+	const bool bigMap = hwState.mapMemMapping >= 0x80;
+	const int mapSize = bigMap 
+		? 0x10000 - (hwState.mapMemMapping << 8)
+		: 8192;
+	const int mapW = hwState.widthOfTheMap == 0 ? 256 : hwState.widthOfTheMap;
+	const int mapH = mapSize / mapW;
+	const uint8_t* bigMapData = _memory->userData + (0x8000 - mapSize);
+
+	const int baseX = sx - drawState.camera_x;
+	const int baseY = sy - drawState.camera_y;
+
+	//cells that are on the map and have tiles overlapping the clip rect
+	const int firstX = std::max(std::max(0, -celx), tileFloor(drawState.clip_xb - baseX));
+	const int endX = std::min(std::min(celw, mapW - celx), tileFloor(drawState.clip_xe - 1 - baseX) + 1);
+	const int firstY = std::max(std::max(0, -cely), tileFloor(drawState.clip_yb - baseY));
+	const int endY = std::min(std::min(celh, mapH - cely), tileFloor(drawState.clip_ye - 1 - baseY) + 1);
+
+	if (endX <= firstX || endY <= firstY) {
+		return;
+	}
+
+	updateSpriteBlitLut();
+
+	const uint8_t writeMask = (hwState.colorBitmask & 0x0f) * 0x11;
+	const uint8_t colorMask = writeMask & ((hwState.colorBitmask >> 4) * 0x11);
+
+	const Surface sprites = spriteSheetSurface();
+	const Surface screen = screenSurface();
+
+	//at most 17 tiles can be visible across the screen
+	int tileOffsets[18];
+	uint8_t gather[72];
+	uint8_t span[72];
+	uint8_t stageBuffer[72];
+
+	for (int ty = firstY; ty < endY; ty++) {
+		const int mapRowIdx = (cely + ty) * mapW + celx;
+		const int tileY = baseY + ty * 8;
+
+		int tx = firstX;
+		while (tx < endX) {
+			//find the next run of tiles that need drawing
+			int runTiles = 0;
+			for (; tx < endX; tx++) {
+				const int idx = mapRowIdx + tx;
+				const uint8_t cell = bigMap
+					? bigMapData[idx]
+					: idx < 4096 ? _memory->mapData[idx] : _memory->spriteSheetData[idx];
+
+				if (!cell || (layer != 0 && !(_memory->spriteFlags[cell] & layer))) {
+					if (runTiles > 0) {
+						break;
+					}
+					continue;
+				}
+
+				//offset of the tile's top row on the sprite sheet
+				tileOffsets[runTiles++] = (cell / 16) * 8 * sprites.pitch + (cell % 16) * 4;
+			}
+
+			if (runTiles == 0) {
+				continue;
+			}
+
+			const int runX = baseX + (tx - runTiles) * 8;
+			const int visStart = std::max(runX, (int)drawState.clip_xb);
+			const int visEnd = std::min(runX + runTiles * 8, (int)drawState.clip_xe);
+			if (visEnd <= visStart) {
+				continue;
+			}
+
+			const int lead = visStart & 1;
+			const int width = visEnd - visStart;
+			const int byteCount = (lead + width + 1) >> 1;
+			const uint8_t firstByteMask = lead ? 0xf0 : 0xff;
+			const uint8_t lastByteMask = ((lead + width) & 1) ? 0x0f : 0xff;
+			const int srcPixStart = visStart - runX - lead;
+
+			for (int r = 0; r < 8; r++) {
+				const int screenY = tileY + r;
+				if (screenY < drawState.clip_yb || screenY >= drawState.clip_ye) {
+					continue;
+				}
+
+				//line up this scanline of every tile in the run
+				for (int t = 0; t < runTiles; t++) {
+					memcpy(gather + t * 4, sprites.data + tileOffsets[t] + r * sprites.pitch, 4);
+				}
+
+				const uint8_t* stage = stageSpriteRow(
+					gather, runTiles * 4, srcPixStart, byteCount, false, false, span, stageBuffer);
+
+				writeSpriteRow(
+					screen.row(screenY) + (visStart >> 1),
+					stage,
+					byteCount,
+					firstByteMask,
+					lastByteMask,
+					writeMask,
+					colorMask);
 			}
 		}
 	}
@@ -1623,6 +1998,8 @@ void Graphics::pal(uint8_t p) {
 			_memory->drawState.drawPaletteMap[c] = c;
 		} else if (p == 1) {
 			_memory->drawState.screenPaletteMap[c] = c;
+		} else if (p == 2) {
+			_memory->hwState.alternatePaletteMap[c] = c;
 		}
 	}
 }
@@ -1640,6 +2017,11 @@ uint8_t Graphics::pal(uint8_t c0, uint8_t c1, uint8_t p){
 		prev = _memory->drawState.screenPaletteMap[c0] & 0xf;
 		c1 &= 0x8f;
 		_memory->drawState.screenPaletteMap[c0] = c1;
+	} else if (p == 2) {
+		//secondary screen palette, used on scanlines flagged at 0x5f70
+		prev = _memory->hwState.alternatePaletteMap[c0] & 0xf;
+		c1 &= 0x8f;
+		_memory->hwState.alternatePaletteMap[c0] = c1;
 	}
 
 	return prev;
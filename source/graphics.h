@@ -7,6 +7,20 @@
 #include <fix32.h>
 using namespace z8;
 
+//a 4 bit per pixel buffer (the screen or the sprite sheet) where the draw functions
+//see it after the 0x5f54/0x5f55 memory remapping. Resolved once per api call and
+//passed down to the blitters and span writers
+struct Surface {
+	uint8_t* data;
+	//bytes per row
+	int pitch;
+	int width;
+	int height;
+
+	uint8_t* row(int y) const {
+		return data + y * pitch;
+	}
+};
 
 class Graphics {
 	//deprecated
@@ -14,8 +28,47 @@ class Graphics {
 
 	PicoRam* _memory;
 
+	//draw palette expanded to pixel pairs for the sprite blitter
+	uint8_t _spriteBlitColors[256];
+	uint8_t _spriteBlitOpaque[256];
+	uint8_t _spriteBlitLutPalette[16];
+	bool _spriteBlitLutValid;
+
+	//pen colour, fill pattern and 0x5f5e bitmask expanded to screen bytes for the
+	//span filler. A pattern row repeats every 2 bytes, so each of the 4 rows is a pair
+	//of bytes to write and masks of the bits they replace (indexed by byte & 1)
+	struct PenSpanRow {
+		uint8_t colors[2];
+		uint8_t masks[2];
+	};
+	PenSpanRow _penSpanRows[4];
+	//draw state the pen spans were built from
+	uint8_t _penSpanKey[21];
+	bool _penSpanValid;
+
+	//[minx, maxx] of each screen row covered by a filled shape, so outlines that
+	//visit a row several times (or mirror onto it) only fill it once
+	struct RowSpans {
+		int minx[128];
+		int maxx[128];
+
+		RowSpans();
+		void add(int x1, int x2, int y);
+	};
+
+	void updateSpriteBlitLut();
+	void writeSpriteRow(
+		uint8_t* dest,
+		const uint8_t* stage,
+		int byteCount,
+		uint8_t firstByteMask,
+		uint8_t lastByteMask,
+		uint8_t writeMask,
+		uint8_t colorMask);
+
 	void copySpriteToScreen(
-		uint8_t* spritebuffer,
+		const Surface &sprites,
+		const Surface &screen,
 		int scr_x,
 		int scr_y,
 		int spr_x,
@@ -26,7 +79,8 @@ class Graphics {
 		bool flip_y);
 
 	void copyStretchSpriteToScreen(
-		uint8_t* spritebuffer,
+		const Surface &sprites,
+		const Surface &screen,
 		int spr_x,
 		int spr_y,
 		int spr_w,
@@ -56,15 +110,26 @@ class Graphics {
 	void _setPixelFromSprite(int x, int y, uint8_t col);
 	void _setPixelFromPen(int x, int y);
 	void _safeSetPixelFromPen(int x, int y);
-	void _private_h_line (int x1, int x2, int y);
-	void _private_v_line (int y1, int y2, int x);
+	//the line helpers fill with the pen spans, updatePenSpans() must be called
+	//once the pen colour for the primitive is set
+	void updatePenSpans();
+	void fillPenSpan(const Surface &screen, int minx, int maxx, int y);
+	void fillRowSpans(const Surface &screen, const RowSpans &spans);
+	void _private_h_line (const Surface &screen, int x1, int x2, int y);
+	void _private_v_line (const Surface &screen, int y1, int y2, int x);
 
 	public:
 	Graphics(std::string fontdata, PicoRam* memory);
 
+	Surface screenSurface();
+	Surface spriteSheetSurface();
 	uint8_t* GetP8FrameBuffer();
 	uint8_t* GetP8SpriteSheetBuffer();
 	uint8_t* GetScreenPaletteMap();
+	//secondary screen palette (0x5f60) and its scanline bitfield (0x5f70),
+	//or nullptr when 0x5f5f does not enable it
+	uint8_t* GetAltScreenPaletteMap();
+	uint8_t* GetAltScreenPaletteLines();
 
 	bool isColorTransparent(uint8_t color);
 	uint8_t getDrawPalMappedColor(uint8_t color);
@@ -5,6 +5,7 @@
 #include <string>
 #include "hostVmShared.h"
 #include "Audio.h"
+#include "framePacer.h"
 
 
 enum StretchOption {
@@ -62,6 +63,9 @@ class Host {
     bool lDown = false;
     bool rDown = false;
     bool stretchKeyPressed = false;
+    //hosts with a rewind binding set rewindSupported, and rewindHeld while it is held
+    bool rewindSupported = false;
+    bool rewindHeld = false;
 	
 	
 	//settings
@@ -73,6 +77,8 @@ class Host {
     ResizekeyOption resizekey = NoResize;
     MenuStyleOption menustyle = Fancy;
     BgColorOption bgcolor = Gray;
+    //frames of audio rendered ahead of the audio callback (latency vs underruns)
+    int audioBufferFrames = 2048;
 	
     float scaleX = 1.0;
     float scaleY = 1.0;
@@ -91,6 +97,9 @@ class Host {
 
     Color _paletteColors[144];
 
+    //waitForTargetFps schedule and frame time stats
+    FramePacer _framePacer;
+
     public:
     Host();
 
@@ -106,12 +115,17 @@ class Host {
     InputState_t scanInput();
     bool shouldQuit();
 
+    //the vm only keeps rewind snapshots when the host can ask for them
+    bool canRewind() const { return rewindSupported; }
+    bool shouldRewind() const { return rewindHeld; }
+
     void changeStretch();
     void forceStretch(StretchOption newStretch);
     
     void waitForTargetFps();
+    const FramePacer& framePacer() const { return _framePacer; }
 
-    void drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode);
+    void drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t drawMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines);
 
     bool shouldFillAudioBuff();
     void* getAudioBufferPointer();
@@ -137,6 +151,8 @@ class Host {
     void writeBufferToFile(std::string cartDataKey, char* buffer, size_t length);
 
     std::string getCartDirectory();
+    //where compiled carts are cached, empty to not cache them
+    std::string getCartCacheDirectory();
 	
     //settings
     int getSetting(std::string sname);
@@ -164,6 +164,12 @@ void Host::loadSettingsIni(){
 	//bgcolor
 	long bgcolorSetting = settingsIni.GetLongValue("settings", "bgcolor", (long)Gray);
 	bgcolor = (BgColorOption) bgcolorSetting;
+	
+	//audio buffer depth in frames
+	long audioBufferSetting = settingsIni.GetLongValue("settings", "audiobuffer", (long)audioBufferFrames);
+	if (audioBufferSetting > 0) {
+		audioBufferFrames = (int) audioBufferSetting;
+	}
 }
 
 void Host::saveSettingsIni(){
@@ -180,6 +186,7 @@ void Host::saveSettingsIni(){
     settingsIni.SetLongValue("settings", "kbmode", kbmode);
     settingsIni.SetLongValue("settings", "menustyle", menustyle);
     settingsIni.SetLongValue("settings", "bgcolor", bgcolor);
+    settingsIni.SetLongValue("settings", "audiobuffer", audioBufferFrames);
 	
     std::string settingsIniStr = "";
     settingsIni.Save(settingsIniStr, false);
@@ -201,6 +208,10 @@ std::string Host::getCartDataFile(std::string cartDataKey) {
     return _logFilePrefix + "cdata/" + cartDataKey + ".p8d.txt";
 }
 
+std::string Host::getCartCacheDirectory() {
+    return _logFilePrefix + "cdata/";
+}
+
 std::string Host::getCartDataFileContents(std::string cartDataKey) {
     return get_file_contents(getCartDataFile(cartDataKey));
 }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "profiling.h"
+
+struct PicoRam;
+class Graphics;
+class Input;
+class Audio;
+class Vm;
+class PrintHelper;
+
+//everything the lua api functions act on. Each vm owns one and hands it to
+//its lua state as the allocator userdata, so api calls find their own vm
+//through the lua_State instead of process globals, and several vms can run
+//side by side (on separate threads too)
+struct PicoApiContext {
+    PicoRam* memory;
+    Graphics* graphics;
+    Input* input;
+    Vm* vm;
+    Audio* audio;
+    PrintHelper* printHelper;
+
+    ProfileCounters profile;
+};
@@ -1,4 +1,6 @@
 
+#include <stdlib.h>
+
 #include <string>
 #include <vector>
 #include <tuple>
@@ -10,6 +12,7 @@ using namespace std;
 #include "vm.h"
 #include "logger.h"
 #include "printHelper.h"
+#include "profiling.h"
 
 //extern "C" {
   #include <lua.h>
@@ -17,20 +20,37 @@ using namespace std;
   #include <lauxlib.h>
 //}
 
-Graphics* _graphicsForLuaApi;
-Input* _inputForLuaApi;
-Vm* _vmForLuaApi;
-Audio* _audioForLuaApi;
-PicoRam* _ramForLuaApi;
+//same allocator and panic handler as luaL_newstate, but with the api context
+//as the allocator userdata. lua_getallocf hands it back from any lua_State of
+//the vm, coroutines included, without a registry lookup per api call
+static void* picoApiAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    if (nsize == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    return realloc(ptr, nsize);
+}
+
+static int picoApiPanic(lua_State *L) {
+    Logger_Write("PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+    return 0;
+}
+
+lua_State* newPicoApiState(PicoApiContext* context) {
+    lua_State* L = lua_newstate(picoApiAlloc, context);
+    if (L) {
+        lua_atpanic(L, picoApiPanic);
+    }
+
+    return L;
+}
 
-void initPicoApi(PicoRam* memory, Graphics* graphics, Input* input, Vm* vm, Audio* audio){
-    _graphicsForLuaApi = graphics;
-    _inputForLuaApi = input;
-    _vmForLuaApi = vm;
-    _audioForLuaApi = audio;
-    _ramForLuaApi = memory;
+static inline PicoApiContext* apiContext(lua_State *L) {
+    void* context;
+    lua_getallocf(L, &context);
 
-    initPrintHelper(_ramForLuaApi, _graphicsForLuaApi, _vmForLuaApi, _audioForLuaApi);
+    return (PicoApiContext*)context;
 }
 
 int noop(const char * name) {
@@ -48,12 +68,13 @@ int noopreturns(lua_State *L, const char * name) {
 /*functions to expose to lua*/
 //Graphics
 int cls(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     if (lua_gettop(L) == 0) {
-        _graphicsForLuaApi->cls();
+        apiContext(L)->graphics->cls();
     }
     else {
         int c = lua_tonumber(L,1);
-        _graphicsForLuaApi->cls(c);
+        apiContext(L)->graphics->cls(c);
     }
 
     return 0;
@@ -64,13 +85,13 @@ int pset(lua_State *L){
     int y = lua_tonumber(L,2);
 
     if (lua_gettop(L) <= 2) {
-        _graphicsForLuaApi->pset(x, y);
+        apiContext(L)->graphics->pset(x, y);
         return 0;
     }
 
     int c = lua_tonumber(L,3);
 
-    _graphicsForLuaApi->pset(x, y, (uint8_t)c);
+    apiContext(L)->graphics->pset(x, y, (uint8_t)c);
 
     return 0;
 }
@@ -79,7 +100,7 @@ int pget(lua_State *L){
     fix32 x = lua_tonumber(L,1);
     fix32 y = lua_tonumber(L,2);
 
-    uint8_t color = _graphicsForLuaApi->pget((int)x, (int)y);
+    uint8_t color = apiContext(L)->graphics->pget((int)x, (int)y);
 
     lua_pushinteger(L, color);
 
@@ -91,10 +112,10 @@ int color(lua_State *L){
     uint8_t c = 0;
     if (lua_gettop(L) > 0) {
         c = lua_tonumber(L,1);
-        prev = _graphicsForLuaApi->color((uint8_t)c);
+        prev = apiContext(L)->graphics->color((uint8_t)c);
     }
     else {
-        prev = _graphicsForLuaApi->color();
+        prev = apiContext(L)->graphics->color();
     }
 
     lua_pushinteger(L, prev);
@@ -103,26 +124,27 @@ int color(lua_State *L){
 }
 
 int line (lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     if (lua_gettop(L) == 0) {
-        _graphicsForLuaApi->line();
+        apiContext(L)->graphics->line();
     }
     else if (lua_gettop(L) == 1) {
         fix32 c = lua_tonumber(L,1);
 
-        _graphicsForLuaApi->line(c);
+        apiContext(L)->graphics->line(c);
     }
     else if (lua_gettop(L) == 2) {
         int x1 = lua_tonumber(L,1);
         int y1 = lua_tonumber(L,2);
 
-        _graphicsForLuaApi->line(x1, y1);
+        apiContext(L)->graphics->line(x1, y1);
     }
     else if (lua_gettop(L) == 3) {
         int x1 = lua_tonumber(L,1);
         int y1 = lua_tonumber(L,2);
         uint8_t c = lua_tonumber(L,3);
 
-        _graphicsForLuaApi->line(x1, y1, c);
+        apiContext(L)->graphics->line(x1, y1, c);
     }
     else if (lua_gettop(L) == 4) {
         int x1 = lua_tonumber(L,1);
@@ -130,7 +152,7 @@ int line (lua_State *L){
         int x2 = lua_tonumber(L,3);
         int y2 = lua_tonumber(L,4);
 
-        _graphicsForLuaApi->line(x1, y1, x2, y2);
+        apiContext(L)->graphics->line(x1, y1, x2, y2);
     }
     else {
         int x1 = lua_tonumber(L,1);
@@ -139,13 +161,14 @@ int line (lua_State *L){
         int y2 = lua_tonumber(L,4);
         uint8_t c = lua_tonumber(L,5);
 
-        _graphicsForLuaApi->line(x1, y1, x2, y2, c);
+        apiContext(L)->graphics->line(x1, y1, x2, y2, c);
     }
 
     return 0;
 }
 
 int tline (lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
     fix32 mx = 0, my = 0, mdx = fix32::frombits(0x2000), mdy = 0;
 
@@ -162,54 +185,57 @@ int tline (lua_State *L){
         mdy = lua_tonumber(L,8);
     }
 
-    _graphicsForLuaApi->tline(x0, y0, x1, y1, mx, my, mdx, mdy);
+    apiContext(L)->graphics->tline(x0, y0, x1, y1, mx, my, mdx, mdy);
 
     return 0;
 }
 
 int circ(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     int ox = lua_tonumber(L,1);
     int oy = lua_tonumber(L,2);
 
     if (lua_gettop(L) == 2) {
-        _graphicsForLuaApi->circ(ox, oy);
+        apiContext(L)->graphics->circ(ox, oy);
     } 
     else if (lua_gettop(L) == 3){
         int r = lua_tonumber(L,3);
-        _graphicsForLuaApi->circ(ox, oy, r);
+        apiContext(L)->graphics->circ(ox, oy, r);
     }
     else if (lua_gettop(L) > 3){
         int r = lua_tonumber(L,3);
         uint8_t c = lua_tonumber(L,4);
 
-        _graphicsForLuaApi->circ(ox, oy, r, c);
+        apiContext(L)->graphics->circ(ox, oy, r, c);
     }
 
     return 0;
 }
 
 int circfill(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     int ox = lua_tonumber(L,1);
     int oy = lua_tonumber(L,2);
 
     if (lua_gettop(L) == 2) {
-        _graphicsForLuaApi->circfill(ox, oy);
+        apiContext(L)->graphics->circfill(ox, oy);
     } 
     else if (lua_gettop(L) == 3){
         int r = lua_tonumber(L,3);
-        _graphicsForLuaApi->circfill(ox, oy, r);
+        apiContext(L)->graphics->circfill(ox, oy, r);
     }
     else if (lua_gettop(L) > 3){
         int r = lua_tonumber(L,3);
         uint8_t c = lua_tonumber(L,4);
 
-        _graphicsForLuaApi->circfill(ox, oy, r, c);
+        apiContext(L)->graphics->circfill(ox, oy, r, c);
     }
 
     return 0;
 }
 
 int oval(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
 
     if (lua_gettop(L) >= 4) {
         int x1 = lua_tonumber(L,1);
@@ -218,13 +244,13 @@ int oval(lua_State *L){
         int y2 = lua_tonumber(L,4);
 
         if (lua_gettop(L) == 4){
-            _graphicsForLuaApi->oval(x1, y1, x2, y2);
+            apiContext(L)->graphics->oval(x1, y1, x2, y2);
 
         }
         else {
             uint8_t c = lua_tonumber(L,5);
 
-            _graphicsForLuaApi->oval(x1, y1, x2, y2, c);
+            apiContext(L)->graphics->oval(x1, y1, x2, y2, c);
         }
     }
 
@@ -232,6 +258,7 @@ int oval(lua_State *L){
 }
 
 int ovalfill(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     if (lua_gettop(L) >= 4) {
         int x1 = lua_tonumber(L,1);
         int y1 = lua_tonumber(L,2);
@@ -239,13 +266,13 @@ int ovalfill(lua_State *L){
         int y2 = lua_tonumber(L,4);
 
         if (lua_gettop(L) == 4){
-            _graphicsForLuaApi->ovalfill(x1, y1, x2, y2);
+            apiContext(L)->graphics->ovalfill(x1, y1, x2, y2);
 
         }
         else {
             fix32 c = lua_tonumber(L,5);
 
-            _graphicsForLuaApi->ovalfill(x1, y1, x2, y2, c);
+            apiContext(L)->graphics->ovalfill(x1, y1, x2, y2, c);
         }
     }
 
@@ -253,6 +280,7 @@ int ovalfill(lua_State *L){
 }
 
 int rect(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
 
     if (lua_gettop(L) >= 4) {
         int x1 = lua_tonumber(L,1);
@@ -261,13 +289,13 @@ int rect(lua_State *L){
         int y2 = lua_tonumber(L,4);
 
         if (lua_gettop(L) == 4){
-            _graphicsForLuaApi->rect(x1, y1, x2, y2);
+            apiContext(L)->graphics->rect(x1, y1, x2, y2);
 
         }
         else {
             uint8_t c = lua_tonumber(L,5);
 
-            _graphicsForLuaApi->rect(x1, y1, x2, y2, c);
+            apiContext(L)->graphics->rect(x1, y1, x2, y2, c);
         }
     }
 
@@ -275,6 +303,7 @@ int rect(lua_State *L){
 }
 
 int rectfill(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     if (lua_gettop(L) >= 4) {
         int x1 = lua_tonumber(L,1);
         int y1 = lua_tonumber(L,2);
@@ -282,13 +311,13 @@ int rectfill(lua_State *L){
         int y2 = lua_tonumber(L,4);
 
         if (lua_gettop(L) == 4){
-            _graphicsForLuaApi->rectfill(x1, y1, x2, y2);
+            apiContext(L)->graphics->rectfill(x1, y1, x2, y2);
 
         }
         else {
             fix32 c = lua_tonumber(L,5);
 
-            _graphicsForLuaApi->rectfill(x1, y1, x2, y2, c);
+            apiContext(L)->graphics->rectfill(x1, y1, x2, y2, c);
         }
     }
 
@@ -296,6 +325,7 @@ int rectfill(lua_State *L){
 }
 
 int print(lua_State *L){
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     int numArgs = lua_gettop(L);
     if (numArgs == 0){
         return 0;
@@ -330,19 +360,19 @@ int print(lua_State *L){
     std::string str = std::string(charArray, len);
 
     if (numArgs < 2) {
-        newx = print(str);
+        newx = apiContext(L)->printHelper->print(str);
     }
     else if (numArgs == 2) {
         uint8_t c = lua_tonumber(L,2);
 
-        _graphicsForLuaApi->color(c);
-        newx = print(str);
+        apiContext(L)->graphics->color(c);
+        newx = apiContext(L)->printHelper->print(str);
     }
     else if (numArgs == 3) {
         int x = lua_tonumber(L,2);
         int y = lua_tonumber(L,3);
 
-        newx = print(str, x, y);
+        newx = apiContext(L)->printHelper->print(str, x, y);
     }
     else {
         int x = lua_tonumber(L,2);
@@ -350,7 +380,7 @@ int print(lua_State *L){
 
         uint8_t c = lua_tonumber(L,4);
 
-        newx = print(str, x, y, c);
+        newx = apiContext(L)->printHelper->print(str, x, y, c);
     }
 
     lua_pushinteger(L, newx);
@@ -358,6 +388,7 @@ int print(lua_State *L){
 }
 
 int spr(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     if (lua_gettop(L) < 3) {
         return 0;
     }
@@ -384,12 +415,13 @@ int spr(lua_State *L) {
         flip_y = lua_toboolean(L,7);
     }
 
-    _graphicsForLuaApi->spr(n, x, y, w, h, flip_x, flip_y);
+    apiContext(L)->graphics->spr(n, x, y, w, h, flip_x, flip_y);
 
     return 0;
 }
 
 int sspr(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
     if (lua_gettop(L) < 6) {
         return 0;
     }
@@ -419,7 +451,7 @@ int sspr(lua_State *L) {
         flip_y = lua_toboolean(L,10);
     }
 
-    _graphicsForLuaApi->sspr(
+    apiContext(L)->graphics->sspr(
         sx,
         sy,
         sw,
@@ -438,12 +470,12 @@ int fget(lua_State *L) {
     fix32 n = lua_tonumber(L,1);
 
     if (lua_gettop(L) == 1) {
-        uint8_t result = _graphicsForLuaApi->fget((uint8_t)n);
+        uint8_t result = apiContext(L)->graphics->fget((uint8_t)n);
         lua_pushinteger(L, result);
     }
     else {
         fix32 f = lua_tonumber(L,2);
-        bool result = _graphicsForLuaApi->fget((uint8_t)n, (uint8_t)f);
+        bool result = apiContext(L)->graphics->fget((uint8_t)n, (uint8_t)f);
         lua_pushboolean(L, result);
     }
 
@@ -456,11 +488,11 @@ int fset(lua_State *L) {
     if (lua_gettop(L) > 2) {
         fix32 f = lua_tonumber(L,2);
         bool v = lua_toboolean(L,3);
-        _graphicsForLuaApi->fset((uint8_t)n, (uint8_t)f, v);
+        apiContext(L)->graphics->fset((uint8_t)n, (uint8_t)f, v);
     }
     else {
         fix32 v = lua_tonumber(L,2);
-        _graphicsForLuaApi->fset((uint8_t)n, (uint8_t)v);
+        apiContext(L)->graphics->fset((uint8_t)n, (uint8_t)v);
     }
 
     return 0;
@@ -469,7 +501,7 @@ int fset(lua_State *L) {
 int sget(lua_State *L) {
     int x = lua_tonumber(L,1);
     int y = lua_tonumber(L,2);
-    uint8_t result = _graphicsForLuaApi->sget((uint8_t)x, (uint8_t)y);
+    uint8_t result = apiContext(L)->graphics->sget((uint8_t)x, (uint8_t)y);
     lua_pushinteger(L, result);
 
     return 1;
@@ -479,7 +511,7 @@ int sset(lua_State *L) {
     int x = lua_tonumber(L,1);
     int y = lua_tonumber(L,2);
     uint8_t c = lua_tonumber(L,3);
-    _graphicsForLuaApi->sset(x, y, c);
+    apiContext(L)->graphics->sset(x, y, c);
 
     return 0;
 }
@@ -494,7 +526,7 @@ int camera(lua_State *L) {
         y = lua_tointeger(L,2);
     }
     
-    auto prev = _graphicsForLuaApi->camera(x, y);
+    auto prev = apiContext(L)->graphics->camera(x, y);
 
     lua_pushnumber(L, get<0>(prev));
     lua_pushnumber(L, get<1>(prev));
@@ -512,10 +544,10 @@ int clip(lua_State *L) {
         int w = lua_tonumber(L,3);
         int h = lua_tonumber(L,4);
 
-        prev = _graphicsForLuaApi->clip(x, y, w, h);
+        prev = apiContext(L)->graphics->clip(x, y, w, h);
     }
     else {
-        prev = _graphicsForLuaApi->clip();
+        prev = apiContext(L)->graphics->clip();
     }
 
     lua_pushnumber(L, get<0>(prev));
@@ -530,7 +562,7 @@ int mget(lua_State *L) {
     int celx = lua_tonumber(L,1);
     int cely = lua_tonumber(L,2);
 
-    uint8_t result = _graphicsForLuaApi->mget(celx, cely);
+    uint8_t result = apiContext(L)->graphics->mget(celx, cely);
     lua_pushnumber(L, result);
 
     return 1;
@@ -541,19 +573,20 @@ int mset(lua_State *L) {
     int cely = lua_tonumber(L,2);
     uint8_t snum = lua_tonumber(L, 3);
 
-    _graphicsForLuaApi->mset(celx, cely, snum);
+    apiContext(L)->graphics->mset(celx, cely, snum);
 
     return 0;
 }
 
 int gfx_map(lua_State *L) {
-    const bool bigMap = _ramForLuaApi->hwState.mapMemMapping >= 0x80;
-	const int bigMapLocation = _ramForLuaApi->hwState.mapMemMapping << 8;
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Graphics);
+    const bool bigMap = apiContext(L)->memory->hwState.mapMemMapping >= 0x80;
+	const int bigMapLocation = apiContext(L)->memory->hwState.mapMemMapping << 8;
 	const int mapSize = bigMap 
 		? 0x10000 - bigMapLocation
 		: 8192;
 
-	const int mapW = _ramForLuaApi->hwState.widthOfTheMap == 0 ? 256 : _ramForLuaApi->hwState.widthOfTheMap;
+	const int mapW = apiContext(L)->memory->hwState.widthOfTheMap == 0 ? 256 : apiContext(L)->memory->hwState.widthOfTheMap;
 	const int mapH = mapSize / mapW;
 
     int celx = 0, cely = 0, sx = 0, sy = 0, celw = mapW, celh = mapH, argc;
@@ -582,7 +615,7 @@ int gfx_map(lua_State *L) {
         layer = lua_tonumber(L,7);
     }
 
-    _graphicsForLuaApi->map(celx, cely, sx, sy, celw, celh, layer);
+    apiContext(L)->graphics->map(celx, cely, sx, sy, celw, celh, layer);
 
     return 0;
 }
@@ -590,7 +623,7 @@ int gfx_map(lua_State *L) {
 int pal(lua_State *L) {
     int numArgs = lua_gettop(L);
     if (numArgs == 0) {
-        _graphicsForLuaApi->pal();
+        apiContext(L)->graphics->pal();
 
         return 0;
     }
@@ -611,7 +644,7 @@ int pal(lua_State *L) {
                 c0 = lua_tonumber(L, -2);
                 c1 = lua_tonumber(L, -1);
 
-                _graphicsForLuaApi->pal(c0, c1, p);
+                apiContext(L)->graphics->pal(c0, c1, p);
             }
             lua_pop(L, 1);
         }
@@ -620,7 +653,7 @@ int pal(lua_State *L) {
     } else if (numArgs == 1) {
         p = lua_tonumber(L, 1);
         
-        _graphicsForLuaApi->pal(p);
+        apiContext(L)->graphics->pal(p);
 
         return 0;
     }
@@ -636,7 +669,7 @@ int pal(lua_State *L) {
         p = lua_tonumber(L,3);
     }
 
-    uint8_t prev =_graphicsForLuaApi->pal(c0, c1, p);
+    uint8_t prev =apiContext(L)->graphics->pal(c0, c1, p);
 
     lua_pushnumber(L, prev);
 
@@ -656,7 +689,7 @@ int palt(lua_State *L) {
         for (int i = 0; i < 16; i++){
             //get single bit
             bool bit = (c >> (15 - i)) & 1U;
-            auto singlePrev = _graphicsForLuaApi->palt(i, bit);
+            auto singlePrev = apiContext(L)->graphics->palt(i, bit);
             //update prev single bit
             if (singlePrev) {
                 prev |= 1UL << (15 - i);
@@ -666,7 +699,7 @@ int palt(lua_State *L) {
     else {
         c = lua_tonumber(L,1);
         bool t = lua_toboolean(L,2);
-        prev = _graphicsForLuaApi->palt(c, t);
+        prev = apiContext(L)->graphics->palt(c, t);
     }
 
     lua_pushnumber(L, prev);
@@ -681,12 +714,12 @@ int cursor(lua_State *L) {
     std::tuple<uint8_t, uint8_t> prev;
 
     if (lua_gettop(L) < 3) {
-        prev = _graphicsForLuaApi->cursor(x, y);
+        prev = apiContext(L)->graphics->cursor(x, y);
     }
     else{
         uint8_t c = lua_tonumber(L,3);
 
-        prev =_graphicsForLuaApi->cursor(x, y, c);
+        prev =apiContext(L)->graphics->cursor(x, y, c);
     }
 
     lua_pushnumber(L, get<0>(prev));
@@ -701,7 +734,7 @@ int fillp(lua_State *L) {
         pat = lua_tonumber(L, 1);
     }
 
-    fix32 prev = _graphicsForLuaApi->fillp(pat);
+    fix32 prev = apiContext(L)->graphics->fillp(pat);
 
     lua_pushnumber(L, prev);
 
@@ -709,7 +742,7 @@ int fillp(lua_State *L) {
 }
 
 int flip(lua_State *L) {
-    _vmForLuaApi->vm_flip();
+    apiContext(L)->vm->vm_flip();
 
     return 0;
 }
@@ -720,7 +753,7 @@ int flip(lua_State *L) {
 int btn(lua_State *L){
     int numArgs = lua_gettop(L);
     if (numArgs == 0) {
-        uint8_t btnstate = _inputForLuaApi->btn();
+        uint8_t btnstate = apiContext(L)->input->btn();
 
         lua_pushnumber(L, btnstate);
     }
@@ -731,7 +764,7 @@ int btn(lua_State *L){
             p = lua_tonumber(L,2);
         };
 
-        bool pressed = _inputForLuaApi->btn((int)i, p);
+        bool pressed = apiContext(L)->input->btn((int)i, p);
 
         lua_pushboolean(L, pressed);
     }
@@ -741,7 +774,7 @@ int btn(lua_State *L){
 int btnp(lua_State *L){
     int numArgs = lua_gettop(L);
     if (numArgs == 0) {
-        uint8_t btnpstate = _inputForLuaApi->btnp();
+        uint8_t btnpstate = apiContext(L)->input->btnp();
 
         lua_pushnumber(L, btnpstate);
     }
@@ -752,7 +785,7 @@ int btnp(lua_State *L){
             p = lua_tonumber(L,2);
         };
 
-        bool pressed = _inputForLuaApi->btnp((int)i, p);
+        bool pressed = apiContext(L)->input->btnp((int)i, p);
 
         lua_pushboolean(L, pressed);
     }
@@ -762,8 +795,8 @@ int btnp(lua_State *L){
 
 //System
 int time(lua_State *L) {
-    int frameCount = _vmForLuaApi->GetFrameCount();
-    int targetFps = _vmForLuaApi->GetTargetFps();
+    int frameCount = apiContext(L)->vm->GetFrameCount();
+    int targetFps = apiContext(L)->vm->GetTargetFps();
 
     fix32 seconds = (fix32)frameCount / (fix32)targetFps;
 
@@ -776,22 +809,22 @@ int stat(lua_State *L) {
     int n = (int)lua_tonumber(L, 1);
 
     switch(n){
-        //0 memory usage
+        //0 memory usage in KB, as counted by the lua allocator
         case 0:
-            //TODO: get from z8lua
-            lua_pushnumber(L, 1);
+        {
+            double kb = lua_gc(L, LUA_GCCOUNT, 0) + lua_gc(L, LUA_GCCOUNTB, 0) / 1024.0;
+            lua_pushnumber(L, kb);
             return 1;
+        }
         break;
-        //cpu usage
+        //cpu usage, as a fraction of the frame
         case 1:
-            // stubbed to return 50%
-            lua_pushnumber(L, 0.5);
+            lua_pushnumber(L, apiContext(L)->vm->getCpuUsage());
             return 1;
         break;
-        //cpu usage (without system calls)
+        //system cpu usage (time spent in api calls)
         case 2:
-            // stubbed to return 50%
-            lua_pushnumber(L, 0.5);
+            lua_pushnumber(L, apiContext(L)->vm->getSystemCpuUsage());
             return 1;
         break;
         //clipboard contents
@@ -809,77 +842,77 @@ int stat(lua_State *L) {
         //argument
         case 6:
             // no args or loading other cards currently supported
-            lua_pushstring(L, _vmForLuaApi->getCartParam().c_str());
+            lua_pushstring(L, apiContext(L)->vm->getCartParam().c_str());
             return 1;
         break;
         //frame rate
         case 7:
-            lua_pushnumber(L, _vmForLuaApi->getFps());
+            lua_pushnumber(L, apiContext(L)->vm->getFps());
             return 1;
         break;
         //target framerate
         case 8:
-            lua_pushnumber(L, _vmForLuaApi->getTargetFps());
+            lua_pushnumber(L, apiContext(L)->vm->getTargetFps());
             return 1;
         break;
         //16-19 audio sfx currently playing
         case 16:
         case 46:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentSfxId(0));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentSfxId(0));
             return 1;
         break;
         case 17:
         case 47:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentSfxId(1));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentSfxId(1));
             return 1;
         break;
         case 18:
         case 48:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentSfxId(2));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentSfxId(2));
             return 1;
         break;
         case 19:
         case 49:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentSfxId(3));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentSfxId(3));
             return 1;
         break;
         //20-23 note idx of sfx currently playing
         case 20:
         case 50:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentNoteNumber(0));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentNoteNumber(0));
             return 1;
         break;
         case 21:
         case 51:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentNoteNumber(1));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentNoteNumber(1));
             return 1;
         break;
         case 22:
         case 52:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentNoteNumber(2));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentNoteNumber(2));
             return 1;
         break;
         case 23:
         case 53:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentNoteNumber(3));
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentNoteNumber(3));
             return 1;
         break;
         //current music pattern
         case 24:
         case 54:
-            lua_pushnumber(L, _audioForLuaApi->getCurrentMusic());
+            lua_pushnumber(L, apiContext(L)->audio->getCurrentMusic());
             return 1;
         break;
         //current music count
         case 25:
         case 55:
-            lua_pushnumber(L, _audioForLuaApi->getMusicPatternCount());
+            lua_pushnumber(L, apiContext(L)->audio->getMusicPatternCount());
             return 1;
         break;
         //current music tick count
         case 56:
         case 26:
-            lua_pushnumber(L, _audioForLuaApi->getMusicTickCount());
+            lua_pushnumber(L, apiContext(L)->audio->getMusicTickCount());
             return 1;
         break;
         //if SDL scancode is pressed. always false for now
@@ -894,61 +927,61 @@ int stat(lua_State *L) {
         break;
         //was a key pressed 
         case 30:
-            lua_pushboolean(L, _inputForLuaApi->getKeyDown());			
+            lua_pushboolean(L, apiContext(L)->input->getKeyDown());			
             return 1;
         break;
         //string of key pressed
         case 31:
-            lua_pushstring(L, _inputForLuaApi->getKey());
+            lua_pushstring(L, apiContext(L)->input->getKey());
             return 1;
         break;
         //mouse x
         case 32:
-            lua_pushnumber(L, _inputForLuaApi->getMouseX());
+            lua_pushnumber(L, apiContext(L)->input->getMouseX());
             return 1;
         break;
         //mouse y
         case 33:
-            lua_pushnumber(L, _inputForLuaApi->getMouseY());
+            lua_pushnumber(L, apiContext(L)->input->getMouseY());
             return 1;
         break;
         //mouse btn state
         case 34:
-            lua_pushnumber(L, _inputForLuaApi->getMouseBtnState());
+            lua_pushnumber(L, apiContext(L)->input->getMouseBtnState());
             return 1;
         break;
         //Current Year
         case 90:
-            lua_pushnumber(L, _vmForLuaApi->getYear());
+            lua_pushnumber(L, apiContext(L)->vm->getYear());
             return 1;
         break;
         //Current month
         case 91:
-            lua_pushnumber(L, _vmForLuaApi->getMonth());
+            lua_pushnumber(L, apiContext(L)->vm->getMonth());
             return 1;
         break;
         //Current day
         case 92:
-            lua_pushnumber(L, _vmForLuaApi->getDay());
+            lua_pushnumber(L, apiContext(L)->vm->getDay());
             return 1;
         break;
         //Current Hour
         case 93:
-            lua_pushnumber(L, _vmForLuaApi->getHour());
+            lua_pushnumber(L, apiContext(L)->vm->getHour());
             return 1;
         break;
         //Current Minute
         case 94:
-            lua_pushnumber(L, _vmForLuaApi->getMinute());
+            lua_pushnumber(L, apiContext(L)->vm->getMinute());
             return 1;
         break;
         //Current second
         case 95:
-            lua_pushnumber(L, _vmForLuaApi->getSecond());
+            lua_pushnumber(L, apiContext(L)->vm->getSecond());
             return 1;
         break;
         case 100:
-            lua_pushstring(L, _vmForLuaApi->getCartBreadcrumb().c_str());
+            lua_pushstring(L, apiContext(L)->vm->getCartBreadcrumb().c_str());
             return 1;
         //unknown? used by serial carts
         case 108:
@@ -976,6 +1009,7 @@ int stat(lua_State *L) {
 
 //Audio
 int music(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Audio);
     int n = lua_tonumber(L,1);
     int fadems = 0;
     if (lua_gettop(L) > 1) {
@@ -986,11 +1020,12 @@ int music(lua_State *L) {
         channelmask = (int)lua_tonumber(L, 3);
     }
 
-    _audioForLuaApi->api_music(n, fadems, channelmask);
+    apiContext(L)->audio->api_music(n, fadems, channelmask);
     return 0;
 }
 
 int sfx(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Audio);
     fix32 n = lua_tonumber(L,1);
     int channel = -1;
     if (lua_gettop(L) > 1) {
@@ -1001,7 +1036,7 @@ int sfx(lua_State *L) {
         offset = (int)lua_tonumber(L, 3);
     }
 
-    _audioForLuaApi->api_sfx((int)n, channel, offset);
+    apiContext(L)->audio->api_sfx((int)n, channel, offset);
     return 0;
 }
 
@@ -1013,21 +1048,23 @@ int cstore(lua_State *L) {
 }
 
 int api_memcpy(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Memory);
     uint16_t dest = (uint16_t)lua_tointeger(L,1);
     uint16_t src = (uint16_t)lua_tointeger(L,2);
     uint16_t len = (uint16_t)lua_tointeger(L,3);
 
-    _vmForLuaApi->vm_memcpy(dest, src, len);
+    apiContext(L)->vm->vm_memcpy(dest, src, len);
 
     return 0;
 }
 
 int api_memset(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Memory);
     uint16_t dest = (uint16_t)lua_tointeger(L,1);
     uint16_t val = (uint16_t)lua_tointeger(L,2);
     uint16_t len = (uint16_t)lua_tointeger(L,3);
 
-    _vmForLuaApi->vm_memset(dest, val, len);
+    apiContext(L)->vm->vm_memset(dest, val, len);
 
     return 0;
 }
@@ -1043,7 +1080,7 @@ int peek(lua_State *L) {
     }
 
     for(int i = 0; i < numToReturn; i++) {
-        uint8_t val = _vmForLuaApi->vm_peek(addr + i);
+        uint8_t val = apiContext(L)->vm->vm_peek(addr + i);
 
         lua_pushinteger(L, val);
     }
@@ -1060,12 +1097,12 @@ int poke(lua_State *L) {
         val = lua_tonumber(L,2);
     }
 
-    _vmForLuaApi->vm_poke(dest, val);
+    apiContext(L)->vm->vm_poke(dest, val);
 
     if (numArgs > 2) {
         for(int i = 1; i <= (numArgs - 2); i++) {
             val = lua_tonumber(L, 2 + i);
-            _vmForLuaApi->vm_poke(dest + i, val);
+            apiContext(L)->vm->vm_poke(dest + i, val);
         }
     }
 
@@ -1075,7 +1112,7 @@ int poke(lua_State *L) {
 int peek2(lua_State *L) {
     uint16_t addr = (uint16_t)lua_tointeger(L,1);
 
-    int16_t val = _vmForLuaApi->vm_peek2(addr);
+    int16_t val = apiContext(L)->vm->vm_peek2(addr);
 
     lua_pushinteger(L, val);
 
@@ -1092,12 +1129,12 @@ int poke2(lua_State *L) {
         val = lua_tonumber(L,2);
     }
 
-    _vmForLuaApi->vm_poke2(dest, (int16_t)val);
+    apiContext(L)->vm->vm_poke2(dest, (int16_t)val);
 
     if (numArgs > 2) {
         for(int i = 1; i <= (numArgs - 2); i++) {
             val = lua_tonumber(L, 2 + i);
-            _vmForLuaApi->vm_poke2(dest + i, (int16_t)val);
+            apiContext(L)->vm->vm_poke2(dest + i, (int16_t)val);
         }
     }
 
@@ -1107,7 +1144,7 @@ int poke2(lua_State *L) {
 int peek4(lua_State *L) {
     uint16_t addr = (uint16_t)lua_tointeger(L,1);
 
-    fix32 val = _vmForLuaApi->vm_peek4(addr);
+    fix32 val = apiContext(L)->vm->vm_peek4(addr);
 
     lua_pushnumber(L, val);
 
@@ -1124,12 +1161,12 @@ int poke4(lua_State *L) {
         val = lua_tonumber(L,2);
     }
 
-    _vmForLuaApi->vm_poke4(dest, val);
+    apiContext(L)->vm->vm_poke4(dest, val);
 
     if (numArgs > 2) {
         for(int i = 1; i <= (numArgs - 2); i++) {
             val = lua_tonumber(L, 2 + i);
-            _vmForLuaApi->vm_poke4(dest + i, val);
+            apiContext(L)->vm->vm_poke4(dest + i, val);
         }
     }
 
@@ -1137,6 +1174,7 @@ int poke4(lua_State *L) {
 }
 
 int reload(lua_State *L) {
+    PROFILE_SCOPE(apiContext(L)->profile, Profile_Memory);
     uint16_t dest = 0;
     uint16_t src = 0;
     uint16_t len = 0x4300;
@@ -1157,7 +1195,7 @@ int reload(lua_State *L) {
         }
     }
 
-    _vmForLuaApi->vm_reload(dest, src, len, str);
+    apiContext(L)->vm->vm_reload(dest, src, len, str);
 
     return 0;
 }
@@ -1168,7 +1206,7 @@ int cartdata(lua_State *L) {
 
     if (lua_gettop(L) > 0) {
         std::string key = lua_tolstring(L, 1, nullptr);
-        result = _vmForLuaApi->vm_cartdata(key);
+        result = apiContext(L)->vm->vm_cartdata(key);
     }
 
     lua_pushboolean(L, result);
@@ -1179,7 +1217,7 @@ int cartdata(lua_State *L) {
 int dget(lua_State *L) {
     int addr = lua_tonumber(L,1);
 
-    fix32 val = _vmForLuaApi->vm_dget(addr);
+    fix32 val = apiContext(L)->vm->vm_dget(addr);
 
     lua_pushnumber(L, val);
 
@@ -1190,7 +1228,7 @@ int dset(lua_State *L) {
     int dest = lua_tonumber(L,1);
     fix32 val = lua_tonumber(L,2);
 
-    _vmForLuaApi->vm_dset(dest, val);
+    apiContext(L)->vm->vm_dset(dest, val);
 
     return 0;
 }
@@ -1206,7 +1244,7 @@ int printh(lua_State *L) {
 
 int rnd(lua_State *L) {
     if (lua_gettop(L) == 0) {
-        fix32 val = _vmForLuaApi->api_rnd();
+        fix32 val = apiContext(L)->vm->api_rnd();
 
         lua_pushnumber(L, val);
     }
@@ -1214,13 +1252,13 @@ int rnd(lua_State *L) {
         if (lua_istable(L, 1)){
             size_t len = lua_rawlen(L,1);
             fix32 range = (fix32)len;
-            int idx = (int)(_vmForLuaApi->api_rnd(range)) + 1;
+            int idx = (int)(apiContext(L)->vm->api_rnd(range)) + 1;
             
             lua_rawgeti(L, 1, idx);
         }
         else {
             fix32 range = lua_tonumber(L,1);
-            fix32 val = _vmForLuaApi->api_rnd(range);
+            fix32 val = apiContext(L)->vm->api_rnd(range);
 
             lua_pushnumber(L, val);
         }
@@ -1231,19 +1269,19 @@ int rnd(lua_State *L) {
 
 int srand(lua_State *L) {
     fix32 seed = lua_tonumber(L,1);
-    _vmForLuaApi->api_srand(seed);
+    apiContext(L)->vm->api_srand(seed);
 
     return 0;
 }
 
 int _update_buttons(lua_State *L) {
-    _vmForLuaApi->update_buttons();
+    apiContext(L)->vm->update_buttons();
     
     return 0;
 }
 
 int run(lua_State *L) {
-    _vmForLuaApi->vm_run();
+    apiContext(L)->vm->vm_run();
     
     return 0;
 }
@@ -1255,7 +1293,7 @@ int extcmd(lua_State *L){
         str = lua_tolstring(L, 1, nullptr);
     }
 
-    _vmForLuaApi->vm_extcmd(str);
+    apiContext(L)->vm->vm_extcmd(str);
 
     return 0;
 }
@@ -1274,27 +1312,27 @@ int load(lua_State *L) {
             param = lua_tolstring(L, 3, nullptr);
         }
 
-        _vmForLuaApi->vm_load(filename, breadcrumb, param);
+        apiContext(L)->vm->vm_load(filename, breadcrumb, param);
     }
 
     return 0;
 }
 
 int reset(lua_State *L) {
-    _vmForLuaApi->vm_reset();
+    apiContext(L)->vm->vm_reset();
 
     return 0;
 }
 
 int setFps(lua_State *L){
-    _vmForLuaApi->setTargetFps(lua_tointeger(L, 1));
+    apiContext(L)->vm->setTargetFps(lua_tointeger(L, 1));
 
     return 0;
 }
 
 int listcarts(lua_State *L) {
     //get cart list from VM (who should get it from host)
-    vector<string> carts = _vmForLuaApi->GetCartList();
+    vector<string> carts = apiContext(L)->vm->GetCartList();
 
     lua_createtable(L, carts.size(), 0);
     int newTable = lua_gettop(L);
@@ -1313,7 +1351,7 @@ int listcarts(lua_State *L) {
 
 
 int getbioserror(lua_State *L) {
-    string error = _vmForLuaApi->GetBiosError();
+    string error = apiContext(L)->vm->GetBiosError();
 
     lua_pushstring(L, error.c_str());
 
@@ -1321,25 +1359,25 @@ int getbioserror(lua_State *L) {
 }
 
 int loadbioscart(lua_State *L) {
-    _vmForLuaApi->QueueCartChange("__FAKE08-BIOS.p8");
+    apiContext(L)->vm->QueueCartChange("__FAKE08-BIOS.p8");
 
     return 0;
 }
 
 int loadsettingscart(lua_State *L) {
-    _vmForLuaApi->QueueCartChange("__FAKE08-SETTINGS.p8");
+    apiContext(L)->vm->QueueCartChange("__FAKE08-SETTINGS.p8");
 
     return 0;
 }
 
 int togglepausemenu(lua_State *L) {
-    _vmForLuaApi->togglePauseMenu();
+    apiContext(L)->vm->togglePauseMenu();
 
     return 0;
 }
 
 int resetcart(lua_State *L) {
-    _vmForLuaApi->QueueCartChange(_vmForLuaApi->CurrentCartFilename());
+    apiContext(L)->vm->QueueCartChange(apiContext(L)->vm->CurrentCartFilename());
 
     return 0;
 }
@@ -1357,7 +1395,7 @@ int getsetting(lua_State *L) {
 	Logger_Write("\n");
 	//std::string sname = str;
 	
-	int val = _vmForLuaApi->getSetting(str);
+	int val = apiContext(L)->vm->getSetting(str);
 	
 	lua_pushnumber(L, val);
 
@@ -1376,7 +1414,7 @@ int setsetting(lua_State *L) {
 	
 	int sval = lua_tonumber(L,2);
 	
-	_vmForLuaApi->setSetting(str,sval);
+	apiContext(L)->vm->setSetting(str,sval);
 	
     return 1;
 }
@@ -1385,7 +1423,7 @@ int setsetting(lua_State *L) {
 
 int installpackins(lua_State *L) {
     #if LOAD_PACK_INS
-	_vmForLuaApi->installPackins();
+	apiContext(L)->vm->installPackins();
 	#endif
     return 1;
 }
@@ -1402,7 +1440,7 @@ int loadlabel(lua_State *L) {
 	bool mini = lua_toboolean(L,2);
 	int minioffset = lua_tonumber(L,3);
 	
-	_vmForLuaApi->loadLabel(filename, mini, minioffset);
+	apiContext(L)->vm->loadLabel(filename, mini, minioffset);
 	return 1;
 }
 
@@ -1416,7 +1454,7 @@ int getlualine(lua_State *L) {
 	
 	int linenumber = lua_tonumber(L,2);
 	
-	std::string resultstring = _vmForLuaApi->getLuaLine(filename, linenumber);
+	std::string resultstring = apiContext(L)->vm->getLuaLine(filename, linenumber);
 	
 	lua_pushstring(L, resultstring.c_str());
 	
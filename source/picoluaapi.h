@@ -12,9 +12,11 @@
 #include "Input.h"
 #include "vm.h"
 #include "PicoRam.h"
+#include "picoApiContext.h"
 
-//this can probably go away when I'm loading actual carts and just have to expose api to lua
-void initPicoApi(PicoRam* memory, Graphics* graphics, Input* input, Vm* vm, Audio* audio);
+//creates a lua state whose api calls act on the given context. The context
+//must outlive the state
+lua_State* newPicoApiState(PicoApiContext* context);
 
 //graphics api
 int cls(lua_State *L);
@@ -1,4 +1,5 @@
 #include <string>
+#include <algorithm>
 
 #include "printHelper.h"
 #include "nibblehelpers.h"
@@ -8,11 +9,6 @@
 #include "vm.h"
 #include "Audio.h"
 
-PicoRam* _ph_mem;
-Graphics* _ph_graphics;
-Vm* _ph_vm;
-Audio* _ph_audio;
-
 void hexStrToBytes(std::string hex, uint8_t byteBuff[]) {
   char buff[3];
   buff[2] = 0;
@@ -24,7 +20,7 @@ void hexStrToBytes(std::string hex, uint8_t byteBuff[]) {
   }
 }
 
-void initPrintHelper(PicoRam* memory, Graphics* graphics, Vm* vm, Audio* audio) {
+PrintHelper::PrintHelper(PicoRam* memory, Graphics* graphics, Vm* vm, Audio* audio) {
     _ph_mem = memory;
     _ph_graphics = graphics;
     _ph_vm = vm;
@@ -76,7 +72,23 @@ int pow2(int power){
     return 0;
 }
 
-int print(std::string str) {
+//moves the screen up so that row startY lands at the top, clearing every
+//row below the copied ones to black. Never reads or writes past the
+//surface, even when the text cursor ended up far below the screen
+static void scrollScreenUp(const Surface &screen, int startY, int linesToCopy) {
+    const int copyRows = std::max(0, std::min(linesToCopy, screen.height - startY));
+    memmove(
+        screen.data,
+        screen.row(startY),
+        copyRows * screen.pitch);
+
+    memset(
+        screen.row(copyRows),
+        0,
+        (screen.height - copyRows) * screen.pitch);
+}
+
+int PrintHelper::print(std::string str) {
     //todo: default is not 0,0?
     int x = _ph_mem->drawState.text_x;
     int y = _ph_mem->drawState.text_y;
@@ -86,16 +98,7 @@ int print(std::string str) {
         int linesToCopy = 127 - lineHeight; 
         int startY = y - linesToCopy; 
 
-        memmove(
-            &_ph_mem->screenBuffer, 
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, startY)],
-            linesToCopy * 64);
-        
-        //set the rest of the screen buffer to 0 (black)
-        memset(
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, linesToCopy)],
-            0,
-            startY * 64);
+        scrollScreenUp(_ph_graphics->screenSurface(), startY, linesToCopy);
 
         y = _ph_mem->drawState.text_y = 127 - lineHeight;
         //Memcpy buffy back to screen
@@ -107,16 +110,8 @@ int print(std::string str) {
         int lineHeight = 5; // possibly need to check if bigger font?
         int linesToCopy = 127 - lineHeight; 
         int startY = _ph_mem->drawState.text_y - linesToCopy; 
-        memmove(
-            &_ph_mem->screenBuffer, 
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, startY)],
-            linesToCopy * 64);
-        
-        //set the rest of the screen buffer to 0 (black)
-        memset(
-            &_ph_mem->screenBuffer[COMBINED_IDX(0, linesToCopy)],
-            0,
-            startY * 64);
+
+        scrollScreenUp(_ph_graphics->screenSurface(), startY, linesToCopy);
 
         y = _ph_mem->drawState.text_y = 127 - lineHeight;
     }
@@ -124,11 +119,11 @@ int print(std::string str) {
 	return result;
 }
 
-int print(std::string str, int x, int y) {
+int PrintHelper::print(std::string str, int x, int y) {
 	return print(str, x, y, _ph_mem->drawState.color);
 }
 
-int print(std::string str, int x, int y, uint8_t c) {
+int PrintHelper::print(std::string str, int x, int y, uint8_t c) {
 	_ph_graphics->color(c);
 
 	_ph_mem->drawState.text_x = x;
@@ -7,10 +7,19 @@
 #include "PicoRam.h"
 
 
-void initPrintHelper(PicoRam* memory, Graphics* graphics, Vm* vm, Audio* audio);
+//draws print() text (with p8scii control codes) for one vm
+class PrintHelper {
+    PicoRam* _ph_mem;
+    Graphics* _ph_graphics;
+    Vm* _ph_vm;
+    Audio* _ph_audio;
 
-int print(std::string str);
+    public:
+    PrintHelper(PicoRam* memory, Graphics* graphics, Vm* vm, Audio* audio);
 
-int print(std::string str, int x, int y);
+    int print(std::string str);
 
-int print(std::string str, int x, int y, uint8_t c);
\ No newline at end of file
+    int print(std::string str, int x, int y);
+
+    int print(std::string str, int x, int y, uint8_t c);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+
+//time spent inside the lua api, split into buckets. Each vm keeps its own
+//counters (in its lua api context), resets them at the start of every frame
+//and reports the total through stat(2), and the benchmark runner reads the
+//buckets. Only api functions that do real work (clears, fills, blits, print,
+//memcpy) are timed. Constant time calls like pset(), pget() or color() are
+//made thousands of times a frame and would cost as much in clock reads as
+//they do themselves, so they count as lua time
+
+enum ProfileBucket {
+    Profile_Graphics,
+    Profile_Memory,
+    Profile_Audio,
+    Profile_BucketCount
+};
+
+struct ProfileCounters {
+    //nanoseconds spent per bucket since the last reset
+    uint64_t nanos[Profile_BucketCount];
+
+    void reset() {
+        for (int i = 0; i < Profile_BucketCount; i++) {
+            nanos[i] = 0;
+        }
+    }
+
+    uint64_t total() const {
+        uint64_t total = 0;
+        for (int i = 0; i < Profile_BucketCount; i++) {
+            total += nanos[i];
+        }
+        return total;
+    }
+};
+
+class ProfileScope {
+    ProfileCounters& _counters;
+    ProfileBucket _bucket;
+    std::chrono::steady_clock::time_point _start;
+
+    public:
+    ProfileScope(ProfileCounters& counters, ProfileBucket bucket) :
+        _counters(counters), _bucket(bucket), _start(std::chrono::steady_clock::now()) { }
+    ~ProfileScope() {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        _counters.nanos[_bucket] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+};
+
+#define PROFILE_SCOPE(counters, bucket) ProfileScope profileScope(counters, bucket)
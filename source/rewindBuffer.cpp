@@ -0,0 +1,251 @@
+#include <string.h>
+
+#include "rewindBuffer.h"
+#include "saveState.h"
+
+//entries never leave the process, so their header is kept native
+struct RewindEntryHeader {
+    uint32_t ramLength;
+    uint32_t luaLength;
+    //the older lua state is encoded in two parts: bytes before luaSplit
+    //against the same offsets of the newer state, and the rest against the
+    //end of the newer state, so one insertion or removal (a longer string,
+    //a table that grew) doesn't turn everything after it into changes
+    uint32_t luaSplit;
+    uint32_t luaFrontLength;
+    //false when the lengths are too far apart to line up, and the older
+    //lua state is encoded on its own
+    uint32_t luaAligned;
+    //whether there is a lua state at all: the newer snapshot is a keyframe,
+    //and the entry holds the lua state of the keyframe before it
+    uint32_t hasLua;
+    uint32_t olderIsKeyframe;
+};
+
+RewindBuffer::RewindBuffer(size_t budget, int interval, int keyframeInterval) :
+    _budget(budget),
+    _interval(interval < 1 ? 1 : interval),
+    _keyframeInterval(keyframeInterval < 1 ? 1 : keyframeInterval),
+    _head(0)
+{
+    clear();
+}
+
+void RewindBuffer::clear() {
+    _entries.clear();
+    _head = 0;
+    _hasCurrent = false;
+    _currentIsKeyframe = false;
+    _currentLua.clear();
+    _framesUntilCapture = 1;
+    _capturesUntilKeyframe = 0;
+}
+
+bool RewindBuffer::tick() {
+    if (--_framesUntilCapture > 0) {
+        return false;
+    }
+
+    _framesUntilCapture = _interval;
+    return true;
+}
+
+bool RewindBuffer::keyframeDue() const {
+    return !_hasCurrent || _capturesUntilKeyframe == 0;
+}
+
+size_t RewindBuffer::bytesUsed() const {
+    size_t used = 0;
+    for (const Entry& entry : _entries) {
+        used += entry.length;
+    }
+    return used;
+}
+
+void RewindBuffer::encodeLua(const std::string& older, const std::string& newer) {
+    RewindEntryHeader header;
+    memcpy(&header, &_entry[0], sizeof(header));
+
+    const uint8_t* o = (const uint8_t*)older.data();
+    const uint8_t* n = (const uint8_t*)newer.data();
+    const size_t olderLength = older.length();
+    const size_t newerLength = newer.length();
+
+    //older byte i lines up with newer byte i before the split and with
+    //newer byte i + shift after it
+    const long shift = (long)newerLength - (long)olderLength;
+    const size_t lo = shift < 0 ? (size_t)-shift : 0;
+    const size_t hi = olderLength < newerLength ? olderLength : newerLength;
+
+    header.luaLength = (uint32_t)olderLength;
+    header.luaAligned = lo <= hi;
+
+    if (!header.luaAligned) {
+        header.luaSplit = 0;
+        const size_t start = _entry.length();
+        encodeSaveStateRam(_entry, o, nullptr, olderLength);
+        header.luaFrontLength = (uint32_t)(_entry.length() - start);
+    }
+    else {
+        //the split that leaves the most unchanged bytes. Moving it past
+        //byte i trades that byte's match at the end for its match at the start
+        size_t split = lo;
+        if (shift != 0) {
+            long gain = 0;
+            long bestGain = 0;
+            for (size_t i = lo; i < hi; i++) {
+                gain += (o[i] == n[i]) - (o[i] == n[i + shift]);
+                if (gain > bestGain) {
+                    bestGain = gain;
+                    split = i + 1;
+                }
+            }
+        }
+
+        header.luaSplit = (uint32_t)split;
+        const size_t start = _entry.length();
+        encodeSaveStateRam(_entry, o, n, split);
+        header.luaFrontLength = (uint32_t)(_entry.length() - start);
+        encodeSaveStateRam(_entry, o + split, n + split + shift, olderLength - split);
+    }
+
+    memcpy(&_entry[0], &header, sizeof(header));
+}
+
+void RewindBuffer::pushEntry() {
+    const size_t length = _entry.length();
+    if (length > _budget) {
+        //the older entries can only be decoded through this one
+        _entries.clear();
+        _head = 0;
+        return;
+    }
+
+    if (_ring.empty()) {
+        _ring.resize(_budget);
+    }
+
+    size_t pos = _head;
+    if (_budget - pos < length) {
+        //wrapping to the start: the entries between the newest one and the
+        //end of the ring are the oldest
+        while (!_entries.empty() && _entries.front().offset >= _head) {
+            _entries.pop_front();
+        }
+        pos = 0;
+    }
+    while (!_entries.empty() && _entries.front().offset >= pos && _entries.front().offset < pos + length) {
+        _entries.pop_front();
+    }
+
+    RewindEntryHeader header;
+    memcpy(&header, _entry.data(), sizeof(header));
+    memcpy(&_ring[pos], _entry.data(), length);
+    _entries.push_back(Entry { pos, length, header.olderIsKeyframe != 0 });
+    _head = pos + length;
+
+    //snapshots older than the oldest keyframe could never be resumed from
+    while (!_entries.empty() && !_entries.front().olderIsKeyframe) {
+        _entries.pop_front();
+    }
+}
+
+void RewindBuffer::capture(const PicoRam& memory, const audioState_t& audio, const std::string& luaState) {
+    captureSnapshot(memory, audio, &luaState);
+}
+
+void RewindBuffer::capture(const PicoRam& memory, const audioState_t& audio) {
+    if (_hasCurrent) {
+        captureSnapshot(memory, audio, nullptr);
+    }
+}
+
+void RewindBuffer::captureSnapshot(const PicoRam& memory, const audioState_t& audio, const std::string* luaState) {
+    if (_hasCurrent) {
+        //the current snapshot becomes an entry holding what turns the new
+        //one back into it
+        RewindEntryHeader header = {};
+        header.olderIsKeyframe = _currentIsKeyframe;
+        _entry.assign((const char*)&header, sizeof(header));
+        _entry.append(_currentAudio);
+
+        const size_t ramStart = _entry.length();
+        encodeSaveStateRam(_entry, _currentRam.data(), memory.data, sizeof(memory.data));
+        header.ramLength = (uint32_t)(_entry.length() - ramStart);
+        header.hasLua = luaState != nullptr;
+        memcpy(&_entry[0], &header, sizeof(header));
+
+        if (luaState) {
+            encodeLua(_currentLua, *luaState);
+        }
+        pushEntry();
+    }
+
+    _currentRam.assign(memory.data, memory.data + sizeof(memory.data));
+    _currentAudio.clear();
+    writeSaveStateAudio(_currentAudio, audio);
+    _currentIsKeyframe = luaState != nullptr;
+    if (luaState) {
+        _currentLua = *luaState;
+        _capturesUntilKeyframe = _keyframeInterval - 1;
+    }
+    else if (_capturesUntilKeyframe > 0) {
+        _capturesUntilKeyframe--;
+    }
+    _hasCurrent = true;
+}
+
+bool RewindBuffer::stepBack(PicoRam& memory, audioState_t& audio) {
+    if (!_hasCurrent || _entries.empty()) {
+        return false;
+    }
+
+    const Entry entry = _entries.back();
+    const uint8_t* data = &_ring[entry.offset];
+
+    RewindEntryHeader header;
+    memcpy(&header, data, sizeof(header));
+    const uint8_t* audioData = data + sizeof(header);
+    const uint8_t* ramData = audioData + SAVESTATE_AUDIO_BYTES;
+    const uint8_t* luaFront = ramData + header.ramLength;
+    const uint8_t* luaBack = luaFront + header.luaFrontLength;
+    const size_t luaBackLength = entry.length - (luaBack - data);
+
+    _decodedRam.resize(sizeof(memory.data));
+    bool ok = decodeSaveStateRam(ramData, header.ramLength, _decodedRam.data(), _currentRam.data(), sizeof(memory.data));
+
+    if (header.hasLua) {
+        _decodedLua.resize(header.luaLength);
+        uint8_t* lua = (uint8_t*)&_decodedLua[0];
+        const uint8_t* newer = (const uint8_t*)_currentLua.data();
+        const long shift = (long)_currentLua.length() - (long)header.luaLength;
+
+        if (header.luaAligned) {
+            ok = ok && decodeSaveStateRam(luaFront, header.luaFrontLength, lua, newer, header.luaSplit)
+                && decodeSaveStateRam(luaBack, luaBackLength, lua + header.luaSplit, newer + header.luaSplit + shift, header.luaLength - header.luaSplit);
+        }
+        else {
+            ok = ok && decodeSaveStateRam(luaFront, header.luaFrontLength, lua, nullptr, header.luaLength);
+        }
+    }
+    if (!ok) {
+        clear();
+        return false;
+    }
+
+    _entries.pop_back();
+    _head = _entries.empty() ? 0 : entry.offset;
+    _currentRam.swap(_decodedRam);
+    if (header.hasLua) {
+        _currentLua.swap(_decodedLua);
+    }
+    _currentAudio.assign((const char*)audioData, SAVESTATE_AUDIO_BYTES);
+    _currentIsKeyframe = header.olderIsKeyframe != 0;
+    _capturesUntilKeyframe = _currentIsKeyframe ? _keyframeInterval - 1 : 0;
+    _framesUntilCapture = _interval;
+
+    memcpy(memory.data, _currentRam.data(), sizeof(memory.data));
+    readSaveStateAudio(audioData, SAVESTATE_AUDIO_BYTES, audio);
+
+    return true;
+}
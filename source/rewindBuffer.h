@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "PicoRam.h"
+
+//bytes of snapshots kept for rewinding, older ones are dropped to stay in it
+#ifndef REWIND_BUFFER_BYTES
+#define REWIND_BUFFER_BYTES (4 * 1024 * 1024)
+#endif
+
+//frames between snapshots, which is also how many frames one step back undoes
+#ifndef REWIND_INTERVAL
+#define REWIND_INTERVAL 6
+#endif
+
+//snapshots between keyframes, the ones that also hold the lua state
+#ifndef REWIND_KEYFRAME_INTERVAL
+#define REWIND_KEYFRAME_INTERVAL 5
+#endif
+
+//snapshots of a running cart (pico 8 memory and audio channels) in a fixed
+//size ring of bytes. Persisting the lua state with eris costs far more than
+//the rest, so only keyframes hold it, and a cart can only be resumed from
+//a keyframe. The snapshots between them are there to show while rewinding.
+//The newest snapshot is kept whole. Each older one is stored as the
+//changes that turn the snapshot after it back into it, so stepping back
+//decodes one entry. The oldest snapshot kept is always a keyframe
+class RewindBuffer {
+    struct Entry {
+        size_t offset;
+        size_t length;
+        bool olderIsKeyframe;
+    };
+
+    size_t _budget;
+    int _interval;
+    int _framesUntilCapture;
+    int _keyframeInterval;
+    //captures before the next keyframe, 0 when the next one is
+    int _capturesUntilKeyframe;
+
+    std::vector<uint8_t> _ring;
+    //end of the newest entry in _ring, where the next one goes if it fits
+    size_t _head;
+    std::deque<Entry> _entries;
+
+    bool _hasCurrent;
+    bool _currentIsKeyframe;
+    std::vector<uint8_t> _currentRam;
+    std::string _currentAudio;
+    //lua state of the newest keyframe at or before the current snapshot
+    std::string _currentLua;
+
+    //reused between captures and steps so neither allocates once warmed up
+    std::string _entry;
+    std::vector<uint8_t> _decodedRam;
+    std::string _decodedLua;
+
+    void pushEntry();
+    void encodeLua(const std::string& older, const std::string& newer);
+    void captureSnapshot(const PicoRam& memory, const audioState_t& audio, const std::string* luaState);
+
+    public:
+    RewindBuffer(size_t budget = REWIND_BUFFER_BYTES, int interval = REWIND_INTERVAL, int keyframeInterval = REWIND_KEYFRAME_INTERVAL);
+
+    //forgets every snapshot, for when another cart is loaded
+    void clear();
+
+    //counts a frame, true on the frames a snapshot should be captured
+    bool tick();
+
+    //true when the next capture should be a keyframe
+    bool keyframeDue() const;
+
+    //captures a keyframe
+    void capture(const PicoRam& memory, const audioState_t& audio, const std::string& luaState);
+    //captures a snapshot without the lua state. Ignored until there is a keyframe
+    void capture(const PicoRam& memory, const audioState_t& audio);
+
+    //moves back to the snapshot before the newest one and writes out its
+    //memory and audio. False (and nothing written) when there isn't an older one
+    bool stepBack(PicoRam& memory, audioState_t& audio);
+
+    //whether the current snapshot is a keyframe, and its lua state if it is
+    bool atKeyframe() const { return _hasCurrent && _currentIsKeyframe; }
+    const std::string& keyframeLua() const { return _currentLua; }
+
+    //snapshots that can be stepped back to
+    size_t stepsAvailable() const { return _entries.size(); }
+    //bytes of the ring used by them
+    size_t bytesUsed() const;
+};
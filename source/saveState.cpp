@@ -0,0 +1,319 @@
+#include <string.h>
+
+#include "saveState.h"
+
+static const char SaveStateMagic[4] = { 'F', '8', 'S', 'S' };
+
+//little endian writers and a reader that fails once anything runs past the
+//end, so states move between platforms
+static inline void appendLE16(std::string& out, uint16_t value) {
+    out.push_back((char)(value & 0xff));
+    out.push_back((char)(value >> 8));
+}
+
+static inline void appendLE32(std::string& out, uint32_t value) {
+    appendLE16(out, (uint16_t)(value & 0xffff));
+    appendLE16(out, (uint16_t)(value >> 16));
+}
+
+static inline void appendFloat(std::string& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendLE32(out, bits);
+}
+
+static inline void appendVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+class SaveStateReader {
+    const uint8_t* _data;
+    size_t _pos;
+    size_t _length;
+    bool _ok;
+
+    public:
+    SaveStateReader(const uint8_t* data, size_t length) : _data(data), _pos(0), _length(length), _ok(true) { }
+
+    bool ok() const { return _ok; }
+    bool atEnd() const { return _pos == _length; }
+
+    const uint8_t* take(size_t length) {
+        if (!_ok || _length - _pos < length) {
+            _ok = false;
+            return nullptr;
+        }
+        const uint8_t* p = _data + _pos;
+        _pos += length;
+        return p;
+    }
+
+    uint8_t readU8() {
+        const uint8_t* p = take(1);
+        return p ? p[0] : 0;
+    }
+
+    uint16_t readLE16() {
+        const uint8_t* p = take(2);
+        return p ? (uint16_t)(p[0] | (p[1] << 8)) : 0;
+    }
+
+    uint32_t readLE32() {
+        uint32_t lo = readLE16();
+        uint32_t hi = readLE16();
+        return lo | (hi << 16);
+    }
+
+    float readFloat() {
+        uint32_t bits = readLE32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint32_t readVarint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 32; shift += 7) {
+            uint8_t b = readU8();
+            value |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        _ok = false;
+        return 0;
+    }
+};
+
+//end of the run of bytes from pos that are zero (or match the reference),
+//checked 8 bytes at a time
+static size_t zeroRunEnd(const uint8_t* ram, const uint8_t* reference, size_t pos, size_t length) {
+    if (reference == nullptr) {
+        for (; pos + 8 <= length; pos += 8) {
+            uint64_t word;
+            memcpy(&word, ram + pos, 8);
+            if (word != 0) {
+                break;
+            }
+        }
+        while (pos < length && ram[pos] == 0) {
+            pos++;
+        }
+    }
+    else {
+        for (; pos + 8 <= length; pos += 8) {
+            uint64_t word, refWord;
+            memcpy(&word, ram + pos, 8);
+            memcpy(&refWord, reference + pos, 8);
+            if (word != refWord) {
+                break;
+            }
+        }
+        while (pos < length && ram[pos] == reference[pos]) {
+            pos++;
+        }
+    }
+    return pos;
+}
+
+void encodeSaveStateRam(std::string& out, const uint8_t* ram, const uint8_t* reference, size_t length) {
+    size_t pos = 0;
+
+    while (pos < length) {
+        const size_t zeroStart = pos;
+        pos = zeroRunEnd(ram, reference, pos, length);
+        const size_t zeros = pos - zeroStart;
+
+        //literal runs until SAVESTATE_ZERO_RUN_MIN zeros in a row
+        const size_t literalStart = pos;
+        size_t literalEnd = pos;
+        while (pos < length && pos - literalEnd < SAVESTATE_ZERO_RUN_MIN) {
+            const uint8_t diff = reference ? ram[pos] ^ reference[pos] : ram[pos];
+            pos++;
+            if (diff != 0) {
+                literalEnd = pos;
+            }
+        }
+        pos = literalEnd;
+
+        appendVarint(out, (uint32_t)zeros);
+        appendVarint(out, (uint32_t)(literalEnd - literalStart));
+        if (reference == nullptr) {
+            out.append((const char*)ram + literalStart, literalEnd - literalStart);
+        }
+        else {
+            for (size_t i = literalStart; i < literalEnd; i++) {
+                out.push_back((char)(ram[i] ^ reference[i]));
+            }
+        }
+    }
+}
+
+bool decodeSaveStateRam(const uint8_t* src, size_t srcLength, uint8_t* ram, const uint8_t* reference, size_t length) {
+    SaveStateReader reader(src, srcLength);
+    size_t pos = 0;
+
+    while (pos < length) {
+        const uint32_t zeros = reader.readVarint();
+        const uint32_t literals = reader.readVarint();
+        if (!reader.ok() || length - pos < zeros || length - pos - zeros < literals || zeros + literals == 0) {
+            return false;
+        }
+
+        if (reference == nullptr) {
+            memset(ram + pos, 0, zeros);
+        }
+        else {
+            memcpy(ram + pos, reference + pos, zeros);
+        }
+        pos += zeros;
+
+        const uint8_t* literal = reader.take(literals);
+        if (literal == nullptr) {
+            return false;
+        }
+        if (reference == nullptr) {
+            memcpy(ram + pos, literal, literals);
+        }
+        else {
+            for (uint32_t i = 0; i < literals; i++) {
+                ram[pos + i] = literal[i] ^ reference[pos + i];
+            }
+        }
+        pos += literals;
+    }
+
+    return reader.atEnd();
+}
+
+static void writeNoteChannel(std::string& out, const noteChannel& channel) {
+    appendFloat(out, channel.phi);
+    out.push_back((char)channel.n.data[0]);
+    out.push_back((char)channel.n.data[1]);
+}
+
+static void readNoteChannel(SaveStateReader& reader, noteChannel& channel) {
+    channel.phi = reader.readFloat();
+    channel.n.data[0] = reader.readU8();
+    channel.n.data[1] = reader.readU8();
+}
+
+static void writeRawSfxChannel(std::string& out, const rawSfxChannel& channel) {
+    appendLE16(out, (uint16_t)channel.sfxId);
+    appendFloat(out, channel.offset);
+    out.push_back(channel.can_loop ? 1 : 0);
+    out.push_back(channel.is_music ? 1 : 0);
+    writeNoteChannel(out, channel.current_note);
+    writeNoteChannel(out, channel.prev_note);
+}
+
+static void readRawSfxChannel(SaveStateReader& reader, rawSfxChannel& channel) {
+    channel.sfxId = (int16_t)reader.readLE16();
+    channel.offset = reader.readFloat();
+    channel.can_loop = reader.readU8() != 0;
+    channel.is_music = reader.readU8() != 0;
+    readNoteChannel(reader, channel.current_note);
+    readNoteChannel(reader, channel.prev_note);
+}
+
+void writeSaveStateAudio(std::string& out, const audioState_t& state) {
+    const musicChannel& music = state._musicChannel;
+    appendLE16(out, (uint16_t)music.count);
+    appendLE16(out, (uint16_t)music.pattern);
+    out.push_back((char)music.master);
+    out.push_back((char)music.mask);
+    out.push_back((char)music.speed);
+    appendFloat(out, music.volume);
+    appendFloat(out, music.volume_step);
+    appendFloat(out, music.offset);
+    out.push_back((char)music.length);
+
+    for (int i = 0; i < 4; i++) {
+        const sfxChannel& channel = state._sfxChannels[i];
+        writeRawSfxChannel(out, channel);
+        writeRawSfxChannel(out, channel.customInstrumentChannel);
+        writeRawSfxChannel(out, channel.prevInstrumentChannel);
+    }
+}
+
+bool readSaveStateAudio(const uint8_t* src, size_t length, audioState_t& state) {
+    SaveStateReader reader(src, length);
+
+    musicChannel& music = state._musicChannel;
+    music.count = (int16_t)reader.readLE16();
+    music.pattern = (int16_t)reader.readLE16();
+    music.master = (int8_t)reader.readU8();
+    music.mask = reader.readU8();
+    music.speed = reader.readU8();
+    music.volume = reader.readFloat();
+    music.volume_step = reader.readFloat();
+    music.offset = reader.readFloat();
+    music.length = reader.readU8();
+
+    for (int i = 0; i < 4; i++) {
+        sfxChannel& channel = state._sfxChannels[i];
+        readRawSfxChannel(reader, channel);
+        readRawSfxChannel(reader, channel.customInstrumentChannel);
+        readRawSfxChannel(reader, channel.prevInstrumentChannel);
+    }
+
+    return reader.ok() && reader.atEnd();
+}
+
+void writeSaveState(std::string& out, const PicoRam& memory, const audioState_t& audio, const std::string& luaState) {
+    out.clear();
+    out.append(SaveStateMagic, sizeof(SaveStateMagic));
+    appendLE32(out, SAVESTATE_FORMAT);
+
+    appendLE32(out, SAVESTATE_AUDIO_BYTES);
+    writeSaveStateAudio(out, audio);
+
+    //length is patched in once the ram is encoded
+    const size_t ramLengthPos = out.length();
+    appendLE32(out, 0);
+    encodeSaveStateRam(out, memory.data, nullptr, sizeof(memory.data));
+    const uint32_t ramLength = (uint32_t)(out.length() - ramLengthPos - 4);
+    for (int i = 0; i < 4; i++) {
+        out[ramLengthPos + i] = (char)(ramLength >> (i * 8));
+    }
+
+    appendLE32(out, (uint32_t)luaState.length());
+    out.append(luaState);
+}
+
+bool readSaveState(const void* data, size_t length, PicoRam& memory, audioState_t& audio, std::string& luaState) {
+    SaveStateReader reader((const uint8_t*)data, length);
+
+    const uint8_t* magic = reader.take(sizeof(SaveStateMagic));
+    if (magic == nullptr || memcmp(magic, SaveStateMagic, sizeof(SaveStateMagic)) != 0) {
+        return false;
+    }
+    if (reader.readLE32() != SAVESTATE_FORMAT) {
+        return false;
+    }
+
+    const uint32_t audioLength = reader.readLE32();
+    const uint8_t* audioData = reader.take(audioLength);
+    if (audioData == nullptr || !readSaveStateAudio(audioData, audioLength, audio)) {
+        return false;
+    }
+
+    const uint32_t ramLength = reader.readLE32();
+    const uint8_t* ramData = reader.take(ramLength);
+    if (ramData == nullptr || !decodeSaveStateRam(ramData, ramLength, memory.data, nullptr, sizeof(memory.data))) {
+        return false;
+    }
+
+    const uint32_t luaLength = reader.readLE32();
+    const uint8_t* luaData = reader.take(luaLength);
+    if (luaData == nullptr) {
+        return false;
+    }
+    luaState.assign((const char*)luaData, luaLength);
+
+    return true;
+}
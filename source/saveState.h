@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+#include "PicoRam.h"
+
+//bump when the layout of a section or how it is encoded changes. States
+//with another version are rejected instead of being loaded wrong
+#define SAVESTATE_FORMAT 1
+
+//zero bytes it takes to end a literal run in encoded ram. Shorter runs of
+//zeros are cheaper to keep inside the literal than to start a new pair for
+#define SAVESTATE_ZERO_RUN_MIN 8
+
+//most bytes encodeSaveStateRam can write for length bytes of ram: every pair
+//after the first saves at least as much as its 2 length varints cost
+#define SAVESTATE_RAM_BOUND(length) ((length) + 16)
+
+//bytes writeSaveStateAudio writes
+#define SAVESTATE_AUDIO_BYTES (20 + 4 * 3 * 20)
+
+//most bytes a state with a lua section of luaLength bytes can take
+#define SAVESTATE_BOUND(luaLength) \
+    (8 + 4 + SAVESTATE_AUDIO_BYTES + 4 + SAVESTATE_RAM_BOUND(sizeof(PicoRam)) + 4 + (luaLength))
+
+//encodes ram as pairs of (zero run, literal run) lengths, each literal run
+//followed by its bytes. When reference isn't null, the bytes encoded are
+//ram ^ reference, so a state that differs little from the reference (the
+//previous frame) encodes to a few pairs
+void encodeSaveStateRam(std::string& out, const uint8_t* ram, const uint8_t* reference, size_t length);
+
+//decodes exactly length bytes of ram, against the same reference it was
+//encoded with. False if src is malformed or doesn't cover length bytes
+bool decodeSaveStateRam(const uint8_t* src, size_t srcLength, uint8_t* ram, const uint8_t* reference, size_t length);
+
+//audio channel state field by field in little endian, so states don't carry
+//struct padding or the channels' vtable pointers
+void writeSaveStateAudio(std::string& out, const audioState_t& state);
+bool readSaveStateAudio(const uint8_t* src, size_t length, audioState_t& state);
+
+//a whole state: header, audio, encoded pico 8 memory and the lua state as
+//persisted by eris, each section length prefixed
+void writeSaveState(std::string& out, const PicoRam& memory, const audioState_t& audio, const std::string& luaState);
+
+//checks and decodes a state into the given objects without touching the
+//running vm, so a bad state can be rejected before anything is changed.
+//Bytes after the last section (frontend padding) are ignored
+bool readSaveState(const void* data, size_t length, PicoRam& memory, audioState_t& audio, std::string& luaState);
@@ -4,6 +4,26 @@
 
 #include "logger.h"
 
+//value of each hex digit, 0 for anything that isn't one
+const uint8_t hex_nibble_lut[256] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  0,  0,  0,  0,  0,  0,
+	 0, 10, 11, 12, 13, 14, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0, 10, 11, 12, 13, 14, 15,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
 void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data) {
 	uint16_t i = 0;
 
@@ -83,4 +103,24 @@ void copy_string_to_memory(uint8_t* sprite_flag_data, std::string data) {
 			sprite_flag_data[i++] = val;
 		}
 	}
-}
\ No newline at end of file
+}
+
+size_t copy_hex_line_to_memory(uint8_t* dest, size_t destSize, const char* line, size_t len, bool leftNibbleFirst) {
+	size_t i = 0;
+
+	for (size_t n = 0; n < len && i < destSize; n++) {
+		if (line[n] > ' ') {
+			uint8_t first = hex_nibble(line[n]);
+			//an odd digit at the end of the line is the whole value
+			if (n + 1 >= len) {
+				dest[i++] = first;
+				break;
+			}
+			uint8_t second = hex_nibble(line[++n]);
+
+			dest[i++] = leftNibbleFirst ? first | (second << 4) : (first << 4) | second;
+		}
+	}
+
+	return i;
+}
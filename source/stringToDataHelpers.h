@@ -1,9 +1,23 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+
 #include <string>
 
+extern const uint8_t hex_nibble_lut[256];
+
+static inline uint8_t hex_nibble(char c) {
+    return hex_nibble_lut[(uint8_t)c];
+}
+
 void copy_string_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data);
 
 void copy_mini_label_to_sprite_memory(uint8_t sprite_data[128 * 64], std::string data, int labeloffset);
 
-void copy_string_to_memory(uint8_t* sprite_flag_data, std::string data);
\ No newline at end of file
+void copy_string_to_memory(uint8_t* sprite_flag_data, std::string data);
+
+//decodes one line of hex digit pairs into dest, skipping whitespace, and returns the
+//bytes written. leftNibbleFirst is for pixel data, where the first digit of a pair is
+//the left pixel in the low nibble
+size_t copy_hex_line_to_memory(uint8_t* dest, size_t destSize, const char* line, size_t len, bool leftNibbleFirst);
@@ -22,6 +22,57 @@
 namespace z8
 {
 
+// Each waveform is a function of the phase so the single sample and the
+// block versions below share exactly the same arithmetic
+static inline float triangle(float t)
+{
+    using std::fabs;
+    return 0.5f * (fabs(4.f * t - 2.0f) - 1.0f);
+}
+
+static inline float tilted_saw(float t)
+{
+    static float const a = 0.9f;
+    float ret = t < a ? 2.f * t / a - 1.f
+                      : 2.f * (1.f - t) / (1.f - a) - 1.f;
+    return ret * 0.5f;
+}
+
+static inline float saw(float t)
+{
+    return 0.653f * (t < 0.5f ? t : t - 1.f);
+}
+
+static inline float square(float t)
+{
+    return t < 0.5f ? 0.25f : -0.25f;
+}
+
+static inline float pulse(float t)
+{
+    return t < 1.f / 3 ? 0.25f : -0.25f;
+}
+
+static inline float organ(float t)
+{
+    using std::fabs;
+    float ret = t < 0.5f ? 3.f - fabs(24.f * t - 6.f)
+                         : 1.f - fabs(16.f * t - 12.f);
+    return ret / 9.f;
+}
+
+static inline float phaser(float advance, float t)
+{   // This one has a subfrequency of freq/128 that appears
+    // to modulate two signals using a triangle wave
+    // FIXME: amplitude seems to be affected, too
+    using std::fabs;
+    using std::fmod;
+    float k = fabs(2.f * fmod(advance / 128.f, 1.f) - 1.f);
+    float u = fmod(t + 0.5f * k, 1.0f);
+    float ret = fabs(4.f * u - 2.f) - fabs(8.f * t - 4.f);
+    return ret / 6.f;
+}
+
 float synth::waveform(int instrument, float advance)
 {
     using std::fabs;
@@ -35,7 +86,6 @@ float synth::waveform(int instrument, float advance)
     const float tscale = 0.11288053831187f;
 
     float t = fmod(advance, 1.f);
-    float ret = 0.f;
 
     // Multipliers were measured from PICO-8 WAV exports. Waveforms are
     // inferred from those exports by guessing what the original formulas
@@ -43,24 +93,17 @@ float synth::waveform(int instrument, float advance)
     switch (instrument)
     {
         case INST_TRIANGLE:
-            return 0.5f * (fabs(4.f * t - 2.0f) - 1.0f);
+            return triangle(t);
         case INST_TILTED_SAW:
-        {
-            static float const a = 0.9f;
-            ret = t < a ? 2.f * t / a - 1.f
-                        : 2.f * (1.f - t) / (1.f - a) - 1.f;
-            return ret * 0.5f;
-        }
+            return tilted_saw(t);
         case INST_SAW:
-            return 0.653f * (t < 0.5f ? t : t - 1.f);
+            return saw(t);
         case INST_SQUARE:
-            return t < 0.5f ? 0.25f : -0.25f;
+            return square(t);
         case INST_PULSE:
-            return t < 1.f / 3 ? 0.25f : -0.25f;
+            return pulse(t);
         case INST_ORGAN:
-            ret = t < 0.5f ? 3.f - fabs(24.f * t - 6.f)
-                           : 1.f - fabs(16.f * t - 12.f);
-            return ret / 9.f;
+            return organ(t);
         case INST_NOISE:
         {
             // Spectral analysis indicates this is some kind of brown noise,
@@ -112,18 +155,53 @@ float synth::waveform(int instrument, float advance)
             return endval;
         }
         case INST_PHASER:
-        {   // This one has a subfrequency of freq/128 that appears
-            // to modulate two signals using a triangle wave
-            // FIXME: amplitude seems to be affected, too
-            float k = fabs(2.f * fmod(advance / 128.f, 1.f) - 1.f);
-            float u = fmod(t + 0.5f * k, 1.0f);
-            ret = fabs(4.f * u - 2.f) - fabs(8.f * t - 4.f);
-            return ret / 6.f;
-        }
+            return phaser(advance, t);
     }
 
     return 0.0f;
 }
 
+void synth::waveforms(int instrument, float const *advance, float *out, int count)
+{
+    using std::fmod;
+
+    switch (instrument)
+    {
+        case INST_TRIANGLE:
+            for (int i = 0; i < count; ++i)
+                out[i] = triangle(fmod(advance[i], 1.f));
+            return;
+        case INST_TILTED_SAW:
+            for (int i = 0; i < count; ++i)
+                out[i] = tilted_saw(fmod(advance[i], 1.f));
+            return;
+        case INST_SAW:
+            for (int i = 0; i < count; ++i)
+                out[i] = saw(fmod(advance[i], 1.f));
+            return;
+        case INST_SQUARE:
+            for (int i = 0; i < count; ++i)
+                out[i] = square(fmod(advance[i], 1.f));
+            return;
+        case INST_PULSE:
+            for (int i = 0; i < count; ++i)
+                out[i] = pulse(fmod(advance[i], 1.f));
+            return;
+        case INST_ORGAN:
+            for (int i = 0; i < count; ++i)
+                out[i] = organ(fmod(advance[i], 1.f));
+            return;
+        case INST_PHASER:
+            for (int i = 0; i < count; ++i)
+                out[i] = phaser(advance[i], fmod(advance[i], 1.f));
+            return;
+        default:
+            // noise keeps state between samples, so it stays sequential
+            for (int i = 0; i < count; ++i)
+                out[i] = waveform(instrument, advance[i]);
+            return;
+    }
+}
+
 } // namespace z8
 
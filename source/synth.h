@@ -36,14 +36,18 @@ public:
 
     static float waveform(int instrument, float advance);
 
+    // Fills out[i] = waveform(instrument, advance[i]) for a whole block,
+    // with the instrument switch hoisted out of the loop
+    static void waveforms(int instrument, float const *advance, float *out, int count);
+
     //These are inline so they don't have to be declared in the class
     //c++17 allows this, but if need for c++11 "inline" can be removed and they
     //can be declared in synth.cpp
-    //also not threadsafe, but this is all single threaded anyway
+    //thread_local so vms running on separate threads keep their own noise state
     private:
-        inline static float lastadvance;
-        inline static float sample;
-        inline static float lsample;
+        inline static thread_local float lastadvance;
+        inline static thread_local float sample;
+        inline static thread_local float lsample;
         
 };
 
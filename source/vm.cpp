@@ -15,8 +15,11 @@
 #include "graphics.h"
 #include "fontdata.h"
 #include "cart.h"
+#include "cartCache.h"
+#include "filehelpers.h"
 #include "stringToDataHelpers.h"
 #include "picoluaapi.h"
+#include "printHelper.h"
 #include "logger.h"
 #include "Input.h"
 #include "p8GlobalLuaFunctions.h"
@@ -24,6 +27,7 @@
 #include "emojiconversion.h"
 
 #include "NoLabel.h"
+#include "profiling.h"
 
 //extern "C" {
   #include <lua.h>
@@ -37,6 +41,42 @@ using namespace z8;
 static const char BiosCartName[] = "__FAKE08-BIOS.p8";
 static const char SettingsCartName[] = "__FAKE08-SETTINGS.p8";
 
+//lua_dump writer collecting the chunk for the cart cache
+static int appendChunkToString(lua_State* L, const void* p, size_t sz, void* ud) {
+    ((std::string*)ud)->append((const char*)p, sz);
+    return 0;
+}
+
+//p8GlobalLuaFunctions converted to the pico 8 charset and compiled. It is the
+//same for every cart, so it is built once per process instead of on every
+//cart load, run() and bios/cart switch
+struct GlobalLuaChunk {
+    std::string source;
+    std::string bytecode;
+};
+
+static GlobalLuaChunk buildGlobalLuaChunk() {
+    GlobalLuaChunk chunk;
+    chunk.source = charset::utf8_to_pico8(p8GlobalLuaFunctions);
+
+    //compiling doesn't touch the api, so a bare state will do
+    lua_State* L = luaL_newstate();
+    if (L != nullptr) {
+        if (luaL_loadstring(L, chunk.source.c_str()) == LUA_OK) {
+            lua_dump(L, appendChunkToString, &chunk.bytecode);
+        }
+        lua_close(L);
+    }
+
+    return chunk;
+}
+
+//thread safe, vms on other threads share it
+static const GlobalLuaChunk& globalLuaChunk() {
+    static const GlobalLuaChunk chunk = buildGlobalLuaChunk();
+    return chunk;
+}
+
 Vm::Vm(
     Host* host,
     PicoRam* memory,
@@ -45,13 +85,19 @@ Vm::Vm(
     Audio* audio) :
         _loadedCart(nullptr),
         _luaState(nullptr),
+        _abortLua(false),
         _cleanupDeps(false),
         _targetFps(30),
         _picoFrameCount(0),
+        _hasFixedRngSeed(false),
+        _fixedRngSeed(0),
         _cartChangeQueued(false),
         _nextCartKey(""),
         _cartLoadError(""),
-        _cartdataKey("")
+        _cartdataKey(""),
+        _cartCacheKey(0),
+        _cacheLoadingCart(false),
+        _rewound(false)
 {
     _host = host;
 
@@ -63,6 +109,8 @@ Vm::Vm(
 
     _pauseMenu = false;
     memset(_drawStateCopy, 0, sizeof(drawState_t));
+
+    startFrameTiming();
     
     if (graphics == nullptr) {
         graphics = new Graphics(get_font_data(), _memory);
@@ -82,16 +130,22 @@ Vm::Vm(
     }
     _audio = audio;
 
-    //this can probably go away when I'm loading actual carts and just have to expose api to lua
-    Logger_Write("Initializing global api\n");
-    initPicoApi(_memory, _graphics, _input, this, _audio);
-    //initGlobalApi(_graphics);
+    _printHelper = new PrintHelper(_memory, _graphics, this, _audio);
+
+    _apiContext.memory = _memory;
+    _apiContext.graphics = _graphics;
+    _apiContext.input = _input;
+    _apiContext.vm = this;
+    _apiContext.audio = _audio;
+    _apiContext.printHelper = _printHelper;
 
 }
 
 Vm::~Vm(){
     CloseCart();
 
+    delete _printHelper;
+
     if (_cleanupDeps){
         if (_input != nullptr) {
             delete _input;
@@ -112,11 +166,11 @@ PicoRam* Vm::getPicoRam(){
     return _memory;
 }
 
-jmp_buf place;
-bool abortLua;
-
 bool Vm::loadCart(Cart* cart) {
     _picoFrameCount = 0;
+    _rewind.clear();
+    _rewound = false;
+    _framePacer.resetStats();
 
     _cartdataKey = "";
 
@@ -124,8 +178,13 @@ bool Vm::loadCart(Cart* cart) {
     _memory->Reset();
 
     //seed rng
-    auto now = std::chrono::high_resolution_clock::now();
-    api_srand(fix32::frombits((int32_t)now.time_since_epoch().count()));
+    if (_hasFixedRngSeed) {
+        api_srand(fix32::frombits(_fixedRngSeed));
+    }
+    else {
+        auto now = std::chrono::high_resolution_clock::now();
+        api_srand(fix32::frombits((int32_t)now.time_since_epoch().count()));
+    }
 
     //set graphics state
     _graphics->color();
@@ -149,10 +208,10 @@ bool Vm::loadCart(Cart* cart) {
 
     _loadedCart = cart;
     _cartChangeQueued = false;
-    abortLua = false;
+    _abortLua = false;
 
     // initialize Lua interpreter
-    _luaState = luaL_newstate();
+    _luaState = newPicoApiState(&_apiContext);
 
     lua_setpico8memory(_luaState, (uint8_t *)&_memory->data);
     // load Lua base libraries (print / math / etc)
@@ -261,9 +320,13 @@ bool Vm::loadCart(Cart* cart) {
 
     //load in global lua fuctions for pico 8- part of this is setting a local variable
     //with the same name as all the globals we just registered
-    //auto convertedGlobalLuaFunctions = convert_emojis(p8GlobalLuaFunctions);
-    auto convertedGlobalLuaFunctions = charset::utf8_to_pico8(p8GlobalLuaFunctions);
-    int loadedGlobals = luaL_dostring(_luaState, convertedGlobalLuaFunctions.c_str());
+    const GlobalLuaChunk& globals = globalLuaChunk();
+    int loadedGlobals = globals.bytecode.length() > 0
+        ? luaL_loadbuffer(_luaState, globals.bytecode.data(), globals.bytecode.length(), "=globals")
+        : luaL_loadstring(_luaState, globals.source.c_str());
+    if (loadedGlobals == LUA_OK) {
+        loadedGlobals = lua_pcall(_luaState, 0, 0, 0);
+    }
 
     if (loadedGlobals != LUA_OK) {
         _cartLoadError = "ERROR loading pico 8 lua globals";
@@ -289,7 +352,29 @@ bool Vm::loadCart(Cart* cart) {
     //pop the eris.init_persist_all fuction off the stack now that we're done with it
     lua_pop(_luaState, 1);
 
-    int loadedCart = luaL_loadstring(_luaState, cart->LuaString.c_str());
+    int loadedCart = LUA_ERRSYNTAX;
+    if (_cachedBytecode.length() > 0) {
+        loadedCart = luaL_loadbuffer(_luaState, _cachedBytecode.data(), _cachedBytecode.length(), "=cart");
+        if (loadedCart != LUA_OK) {
+            //compiled by an incompatible lua, fall back to the source
+            Logger_Write("Cached cart chunk didn't load: %s\n", lua_tostring(_luaState, -1));
+            lua_pop(_luaState, 1);
+        }
+    }
+    if (loadedCart != LUA_OK) {
+        loadedCart = luaL_loadstring(_luaState, cart->LuaString.c_str());
+
+        if (loadedCart == LUA_OK && _cacheLoadingCart) {
+            CartCacheEntry entry;
+            entry.rom = cart->CartRom;
+            entry.luaString = cart->LuaString;
+            lua_dump(_luaState, appendChunkToString, &entry.bytecode);
+            _cartCache.save(cart->FullCartPath, _cartCacheKey, entry);
+        }
+    }
+    _cachedBytecode = "";
+    _cacheLoadingCart = false;
+
     if (loadedCart != LUA_OK) {
         _cartLoadError = "Error loading cart lua:\n";
         _cartLoadError.append(lua_tostring(_luaState, -1));
@@ -299,7 +384,7 @@ bool Vm::loadCart(Cart* cart) {
         return false;
     }
 
-    if (setjmp(place) == 0) {
+    if (setjmp(_abortLuaJump) == 0) {
         if (lua_pcall(_luaState, 0, 0, 0)){
             _cartLoadError = "Runtime error";
             Logger_Write("ERROR running cart\n");
@@ -309,7 +394,7 @@ bool Vm::loadCart(Cart* cart) {
         }
     }
 
-    if (abortLua) {
+    if (_abortLua) {
         //trigger closing of cart and reload of bios
         return false;
     }
@@ -419,13 +504,13 @@ void Vm::LoadCart(std::string filename, bool loadBiosOnFail){
     Logger_Write("Loading cart %s\n", filename.c_str());
     CloseCart();
 
-    Logger_Write("Calling Cart Constructor\n");
-    auto cartDir = _host->getCartDirectory();
-    Cart *cart = new Cart(filename, cartDir);
+    Cart *cart = loadCartFile(filename);
 
     _cartLoadError = cart->LoadError;
 
     bool success = loadCart(cart);
+    _cacheLoadingCart = false;
+    _cachedBytecode = "";
 
     if (loadBiosOnFail && !success) {
         CloseCart();
@@ -434,6 +519,45 @@ void Vm::LoadCart(std::string filename, bool loadBiosOnFail){
     }
 }
 
+//builds the cart from the cache when its file hasn't changed since it was
+//cached, otherwise parses it and marks it to be cached once it compiles
+Cart* Vm::loadCartFile(string filename){
+    auto cartDir = _host->getCartDirectory();
+    _cartCache.setDirectory(_host->getCartCacheDirectory());
+    _cacheLoadingCart = false;
+    _cachedBytecode = "";
+
+    //read once, for the hash and for parsing on a miss
+    string contents;
+    if (_cartCache.isEnabled()) {
+        string fullCartPath = Cart::ResolveCartPath(filename, cartDir);
+        contents = get_file_contents(fullCartPath);
+
+        if (contents.length() > 0) {
+            _cartCacheKey = CartCache::hashCartFile(contents);
+
+            CartCacheEntry entry;
+            if (_cartCache.load(fullCartPath, _cartCacheKey, entry)) {
+                Logger_Write("Loading cart from cache\n");
+                _cachedBytecode = entry.bytecode;
+                return new Cart(fullCartPath, entry.rom, entry.luaString);
+            }
+        }
+    }
+
+    Logger_Write("Calling Cart Constructor\n");
+    Cart *cart = new Cart(filename, cartDir, contents);
+
+    _cacheLoadingCart = _cartCache.isEnabled() && cart->LoadError.length() == 0 && !cart->UsesIncludes;
+
+    return cart;
+}
+
+void Vm::SetFixedRngSeed(int32_t seed){
+    _hasFixedRngSeed = true;
+    _fixedRngSeed = seed;
+}
+
 void Vm::togglePauseMenu(){
     _input->SetState(0, 0);
     if (_memory->drawState.suppressPause) {    
@@ -521,6 +645,9 @@ void Vm::deserializeCartDataToMemory(std::string cartDataStr) {
 }
 
 void Vm::UpdateAndDraw() {
+    _framePacer.markFrame();
+    startFrameTiming();
+
     update_buttons();
 
     _picoFrameCount++;
@@ -593,6 +720,14 @@ uint8_t* Vm::GetScreenPaletteMap(){
     return _graphics->GetScreenPaletteMap();
 }
 
+uint8_t* Vm::GetAltScreenPaletteMap(){
+    return _graphics->GetAltScreenPaletteMap();
+}
+
+uint8_t* Vm::GetAltScreenPaletteLines(){
+    return _graphics->GetAltScreenPaletteLines();
+}
+
 void Vm::FillAudioBuffer(void *audioBuffer, size_t offset, size_t size){
    _audio->FillAudioBuffer(audioBuffer, offset, size);
 }
@@ -615,9 +750,13 @@ void Vm::CloseCart() {
         _host->saveCartData(_cartdataKey, getSerializedCartData());
     }
 
+    _cartIndex.save();
+
     Logger_Write("resetting state\n");
     _targetFps = 30;
     _picoFrameCount = 0;
+    _rewind.clear();
+    _rewound = false;
 }
 
 void Vm::QueueCartChange(std::string filename){
@@ -645,6 +784,9 @@ int Vm::GetFrameCount() {
 void Vm::SetCartList(vector<string> cartList){
     std::sort(cartList.begin(), cartList.end());
     _cartList = cartList;
+
+    _cartIndex.setDirectories(_host->getCartDirectory(), _host->getCartCacheDirectory());
+    _cartIndex.removeMissing(_cartList);
 }
 
 vector<string> Vm::GetCartList(){
@@ -671,18 +813,88 @@ void Vm::GameLoop() {
         //update buttons needs to be callable from the cart, and also flip
         //it should update call the pico part of scanInput and set the values in memory
         //then we don't need to pass them in here
-        UpdateAndDraw();
+        if (_host->shouldRewind() && !_pauseMenu) {
+            //still scanned so letting go of rewind is seen
+            update_buttons();
+            RewindFrame();
+        }
+        else {
+            if (_rewound) {
+                resumeFromRewind();
+            }
+
+            UpdateAndDraw();
+
+            if (_host->canRewind()) {
+                CaptureRewindFrame();
+            }
+        }
 
         uint8_t* picoFb = GetPicoInteralFb();
         uint8_t* screenPaletteMap = GetScreenPaletteMap();
+        uint8_t* altScreenPaletteMap = GetAltScreenPaletteMap();
+        uint8_t* altScreenPaletteLines = GetAltScreenPaletteLines();
+
+        _host->drawFrame(picoFb, screenPaletteMap, _memory->drawState.drawMode, altScreenPaletteMap, altScreenPaletteLines);
+
+        fillHostAudio();
+    }
+}
 
-        _host->drawFrame(picoFb, screenPaletteMap, _memory->drawState.drawMode);
+void Vm::fillHostAudio() {
+    if (_host->shouldFillAudioBuff()) {
+        FillAudioBuffer(_host->getAudioBufferPointer(), 0, _host->getAudioBufferSize());
 
-        if (_host->shouldFillAudioBuff()) {
-            FillAudioBuffer(_host->getAudioBufferPointer(), 0, _host->getAudioBufferSize());
+        _host->playFilledAudioBuffer();
+    }
+}
 
-            _host->playFilledAudioBuffer();
-        }
+void Vm::CaptureRewindFrame() {
+    //the bios and settings carts aren't rewound
+    const string cartName = CurrentCartFilename();
+    if (cartName == BiosCartName || cartName == SettingsCartName) {
+        return;
+    }
+
+    if (_pauseMenu || _cartChangeQueued || !_rewind.tick()) {
+        return;
+    }
+
+    if (!_rewind.keyframeDue()) {
+        _rewind.capture(*_memory, *_audio->getAudioState());
+        return;
+    }
+
+    //persisting the lua state is most of the cost, so only keyframes do
+    _rewindLuaState = serializeLuaState();
+    if (_rewindLuaState.length() == 0) {
+        //nothing the cart could be put back with
+        return;
+    }
+
+    _rewind.capture(*_memory, *_audio->getAudioState(), _rewindLuaState);
+}
+
+bool Vm::RewindFrame() {
+    audioState_t audioState;
+    if (!_rewind.stepBack(*_memory, audioState)) {
+        return false;
+    }
+
+    *_audio->getAudioState() = audioState;
+    _rewound = true;
+
+    return true;
+}
+
+void Vm::resumeFromRewind() {
+    while (!_rewind.atKeyframe() && RewindFrame()) {
+    }
+    _rewound = false;
+
+    if (_rewind.atKeyframe()) {
+        const string& luaState = _rewind.keyframeLua();
+        deserializeLuaState(luaState.data(), luaState.length());
     }
 }
 
@@ -945,10 +1157,8 @@ void Vm::update_buttons() {
 
 void Vm::vm_flip() {
     if (!_host->shouldRunMainLoop()){
-        abortLua = true;
-        if (abortLua){
-            longjmp(place, 1);
-        }
+        _abortLua = true;
+        longjmp(_abortLuaJump, 1);
     }
 
     if (!_host->shouldQuit() && !_cartChangeQueued) {
@@ -971,6 +1181,8 @@ void Vm::vm_flip() {
 
         uint8_t* picoFb = GetPicoInteralFb();
         uint8_t* screenPaletteMap = GetScreenPaletteMap();
+        uint8_t* altScreenPaletteMap = GetAltScreenPaletteMap();
+        uint8_t* altScreenPaletteLines = GetAltScreenPaletteLines();
 
         if (_pauseMenu){
             //pause menu probably needs refactor out of lua. For now this is better than just quitting
@@ -983,10 +1195,17 @@ void Vm::vm_flip() {
             lua_pop(_luaState, 0);
         }
 
-        _host->drawFrame(picoFb, screenPaletteMap, _memory->drawState.drawMode);
+        _host->drawFrame(picoFb, screenPaletteMap, _memory->drawState.drawMode, altScreenPaletteMap, altScreenPaletteLines);
+
+        //carts running their own loop never get back to GameLoop to do this
+        fillHostAudio();
 
         //is this better at the end of the loop?
         _host->waitForTargetFps();
+
+        //carts running their own loop start their next frame here
+        _framePacer.markFrame();
+        startFrameTiming();
     }
 }
 
@@ -1037,14 +1256,42 @@ void Vm::setTargetFps(int targetFps){
 }
 
 int Vm::getFps(){
-    //TODO: return actual fps (as fix32?)
-    return _targetFps;
+    double fps = _framePacer.measuredFps();
+    if (fps <= 0) {
+        return _targetFps;
+    }
+
+    return (int)(fps + 0.5);
 }
 
 int Vm::getTargetFps(){
     return _targetFps;
 }
 
+void Vm::startFrameTiming(){
+    _frameStartTime = std::chrono::steady_clock::now();
+    _apiContext.profile.reset();
+}
+
+float Vm::getCpuUsage(){
+    auto elapsed = std::chrono::steady_clock::now() - _frameStartTime;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    return (float)(seconds * _targetFps);
+}
+
+float Vm::getSystemCpuUsage(){
+    return (float)(_apiContext.profile.total() / 1000000000.0 * _targetFps);
+}
+
+const ProfileCounters& Vm::getProfileCounters(){
+    return _apiContext.profile;
+}
+
+PicoApiContext* Vm::getPicoApiContext(){
+    return &_apiContext;
+}
+
 int Vm::getYear(){
     std::time_t t = std::time(0);
     std::tm* now = std::localtime(&t);
@@ -1122,23 +1369,41 @@ void Vm::installPackins() {
 
 void Vm::loadLabel(std::string filename, bool mini, int minioffset) {
     
-    auto cartDir = _host->getCartDirectory();
-    Cart *labelcart = new Cart(filename, cartDir);
-    std::string labelstr = labelcart->LabelString;
-    if(labelstr.length() == 0){
-        labelstr = NoLabelString;
+    _cartIndex.setDirectories(_host->getCartDirectory(), _host->getCartCacheDirectory());
+    const CartIndexEntry* entry = _cartIndex.lookup(filename);
+
+    if (entry == nullptr || !entry->hasLabel) {
+        std::string labelstr = NoLabelString;
+        if (mini) {
+            copy_mini_label_to_sprite_memory(_memory->spriteSheetData, labelstr, minioffset);
+        } else {
+            copy_string_to_sprite_memory(_memory->spriteSheetData, labelstr);
+        }
     }
-    if (mini) {
-        copy_mini_label_to_sprite_memory(_memory->spriteSheetData, labelstr, minioffset);
-    } else {
-        copy_string_to_sprite_memory(_memory->spriteSheetData, labelstr);
+    else if (mini) {
+        for (int row = 0; row < CART_INDEX_MINI_LABEL_ROWS; row++) {
+            memcpy(_memory->spriteSheetData + minioffset + row * 64,
+                entry->miniLabel.data() + row * CART_INDEX_MINI_LABEL_ROW_BYTES,
+                CART_INDEX_MINI_LABEL_ROW_BYTES);
+        }
+    }
+    else {
+        memcpy(_memory->spriteSheetData, entry->label.data(), CART_INDEX_LABEL_BYTES);
     }
-    delete labelcart;
     
 }
 
 std::string Vm::getLuaLine(string filename, int linenumber) {
     
+    _cartIndex.setDirectories(_host->getCartDirectory(), _host->getCartCacheDirectory());
+    const CartIndexEntry* entry = _cartIndex.lookup(filename);
+    if (entry == nullptr) {
+        return "";
+    }
+    if (linenumber >= 0 && linenumber < (int)entry->titleLines.size()) {
+        return entry->titleLines[linenumber];
+    }
+
     auto cartDir = _host->getCartDirectory();
     Cart *luacart = new Cart(filename, cartDir);
     std::string luastr = luacart->LuaString;
@@ -1157,22 +1422,22 @@ std::string Vm::getLuaLine(string filename, int linenumber) {
 }
 
 
-size_t Vm::serializeLuaState(char* dest) {
+string Vm::serializeLuaState() {
     lua_getglobal(_luaState, "eris");
 	lua_getfield(_luaState, -1, "persist_all");
 
 	if (lua_pcall(_luaState, 0, 1, 0) != 0) {
 		std::string e = lua_tostring(_luaState, -1);
 		lua_pop(_luaState, 1);
-		return 0;
+		return "";
 	}
 
 	size_t len;
 	const char* result = lua_tolstring(_luaState, -1, &len);
-    memcpy(dest, result, len);
+    string persisted(result, len);
 	lua_pop(_luaState, 2);
 
-    return len;
+    return persisted;
 }
 
 void Vm::deserializeLuaState(const char* src, size_t len) {
@@ -2,12 +2,19 @@
 
 #include <vector>
 #include <string>
+#include <chrono>
+#include <setjmp.h>
 using namespace std;
 
 #include "cart.h"
+#include "cartCache.h"
+#include "cartIndex.h"
+#include "rewindBuffer.h"
 #include "Input.h"
 #include "Audio.h"
 #include "host.h"
+#include "framePacer.h"
+#include "picoApiContext.h"
 
 //extern "C" {
   #include <lua.h>
@@ -30,11 +37,28 @@ class Vm {
     Cart* _loadedCart;
     lua_State* _luaState;
 
+    //what this vm's lua api calls act on, found through _luaState
+    PicoApiContext _apiContext;
+    PrintHelper* _printHelper;
+
+    //vm_flip jumps back out of a running cart when the host stops the main loop
+    jmp_buf _abortLuaJump;
+    bool _abortLua;
+
     bool _cleanupDeps;
 
     int _targetFps;
 
     int _picoFrameCount;
+
+    //seed used instead of the clock when a cart loads, for reproducible runs
+    bool _hasFixedRngSeed;
+    int32_t _fixedRngSeed;
+
+    //start of the current frame's cart code, for stat(1) and stat(2)
+    std::chrono::steady_clock::time_point _frameStartTime;
+    //measures the rate frames actually run at, for stat(7)
+    FramePacer _framePacer;
     //bool _hasUpdate;
     //bool _hasDraw;
 
@@ -52,9 +76,34 @@ class Vm {
 
     vector<string> _cartList;
 
+    //labels and title lines for the bios browser, saved when a cart closes
+    CartIndex _cartIndex;
+
+    //compiled carts on disk. LoadCart fills in the key for the cart it is
+    //loading and the chunk when the cache had one; loadCart uses and clears them
+    CartCache _cartCache;
+    uint64_t _cartCacheKey;
+    bool _cacheLoadingCart;
+    string _cachedBytecode;
+
+    //snapshots of the running cart, kept when the host can rewind
+    RewindBuffer _rewind;
+    string _rewindLuaState;
+    //memory was stepped back, the lua state still has to be
+    bool _rewound;
+
+    Cart* loadCartFile(string filename);
     bool loadCart(Cart* cart);
     void vm_reload(int destaddr, int sourceaddr, int len, Cart* cart);
 
+    //renders a frame's audio into the host's buffer when it wants more,
+    //from GameLoop and from flip() for carts that run their own loop
+    void fillHostAudio();
+
+    //steps back to the keyframe at or before the snapshot rewound to, as
+    //only keyframes hold a lua state, and restores it
+    void resumeFromRewind();
+
 
     public:
     Vm(
@@ -71,10 +120,16 @@ class Vm {
 
     void LoadCart(string filename, bool loadBiosOnFail = true);
 
+    //seeds rnd() with a fixed value on every cart load instead of the clock,
+    //so headless runs of a cart draw the same frames every time
+    void SetFixedRngSeed(int32_t seed);
+
     void UpdateAndDraw();
 
     uint8_t* GetPicoInteralFb();
     uint8_t* GetScreenPaletteMap();
+    uint8_t* GetAltScreenPaletteMap();
+    uint8_t* GetAltScreenPaletteLines();
 
     void FillAudioBuffer(void *audioBuffer, size_t offset, size_t size);
 
@@ -88,6 +143,12 @@ class Vm {
 
     void GameLoop();
 
+    //counts the frame just run and captures a rewind snapshot when one is due
+    void CaptureRewindFrame();
+    //puts the cart's memory and audio back to its previous rewind snapshot,
+    //false if there isn't one. The lua state follows when the cart resumes
+    bool RewindFrame();
+
     void SetCartList(vector<string> cartList);
     vector<string> GetCartList();
     string GetBiosError();
@@ -140,6 +201,15 @@ class Vm {
     int getFps();
     int getTargetFps();
 
+    void startFrameTiming();
+    //fraction of the frame budget used so far this frame, in total and in api calls
+    float getCpuUsage();
+    float getSystemCpuUsage();
+    //api time of the current frame, per bucket
+    const ProfileCounters& getProfileCounters();
+
+    PicoApiContext* getPicoApiContext();
+
     int getYear();
     int getMonth();
     int getDay();
@@ -161,7 +231,8 @@ class Vm {
     string getCartBreadcrumb();
     string getCartParam();
 
-    size_t serializeLuaState(char* dest);
+    //the whole lua state persisted by eris (empty if that failed)
+    string serializeLuaState();
     void deserializeLuaState(const char* src, size_t len);
 };
 
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "doctest.h"
+#include "../source/cartCache.h"
+
+TEST_CASE("cart cache") {
+    CartCache cache(".");
+    std::string cartPath = "carts/cartcachetest.p8";
+    uint64_t key = CartCache::hashCartFile("pico-8 cartridge\n__lua__\nprint(1)\n");
+
+    CartCacheEntry entry;
+    for (size_t i = 0; i < sizeof(entry.rom.data); i++) {
+        entry.rom.data[i] = (uint8_t)(i * 7);
+    }
+    entry.luaString = "print(1)\n";
+    entry.bytecode = std::string("\x1bLua\0chunk", 10);
+
+    SUBCASE("disabled without a directory") {
+        CartCache disabled;
+        CHECK_FALSE(disabled.isEnabled());
+        CHECK_FALSE(disabled.save(cartPath, key, entry));
+        CHECK_FALSE(disabled.load(cartPath, key, entry));
+    }
+    SUBCASE("saved entries load back") {
+        REQUIRE(cache.save(cartPath, key, entry));
+
+        CartCacheEntry loaded;
+        REQUIRE(cache.load(cartPath, key, loaded));
+        CHECK_EQ(memcmp(loaded.rom.data, entry.rom.data, sizeof(entry.rom.data)), 0);
+        CHECK_EQ(loaded.luaString, entry.luaString);
+        CHECK_EQ(loaded.bytecode, entry.bytecode);
+    }
+    SUBCASE("changed cart contents miss") {
+        REQUIRE(cache.save(cartPath, key, entry));
+
+        uint64_t changedKey = CartCache::hashCartFile("pico-8 cartridge\n__lua__\nprint(2)\n");
+        CHECK_NE(changedKey, key);
+
+        CartCacheEntry loaded;
+        CHECK_FALSE(cache.load(cartPath, changedKey, loaded));
+        CHECK_FALSE(cache.load("carts/othercart.p8", key, loaded));
+    }
+    SUBCASE("corrupt or truncated entries miss") {
+        REQUIRE(cache.save(cartPath, key, entry));
+        std::string path = cache.entryPath(cartPath);
+
+        FILE* file = fopen(path.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        fseek(file, 100, SEEK_SET);
+        fputc(0x55, file);
+        fclose(file);
+
+        CartCacheEntry loaded;
+        CHECK_FALSE(cache.load(cartPath, key, loaded));
+
+        REQUIRE(cache.save(cartPath, key, entry));
+        file = fopen(path.c_str(), "wb");
+        REQUIRE(file != nullptr);
+        fwrite("F8CC", 1, 4, file);
+        fclose(file);
+
+        CHECK_FALSE(cache.load(cartPath, key, loaded));
+    }
+    SUBCASE("least recently used entries are deleted past the limits") {
+        CartCache small(".", 2);
+        REQUIRE(small.save("carts/a.p8", key, entry));
+        REQUIRE(small.save("carts/b.p8", key, entry));
+        //resaving a cart replaces its entry instead of adding one
+        REQUIRE(small.save("carts/b.p8", key, entry));
+
+        CartCacheEntry loaded;
+        REQUIRE(small.load("carts/a.p8", key, loaded));
+        REQUIRE(small.save("carts/c.p8", key, entry));
+
+        CHECK(small.load("carts/a.p8", key, loaded));
+        CHECK(small.load("carts/c.p8", key, loaded));
+        CHECK_FALSE(small.load("carts/b.p8", key, loaded));
+        FILE* file = fopen(small.entryPath("carts/b.p8").c_str(), "rb");
+        CHECK(file == nullptr);
+
+        //the order is kept on disk for the next run
+        CartCache reopened(".", 2);
+        REQUIRE(reopened.save("carts/d.p8", key, entry));
+        CHECK(reopened.load("carts/c.p8", key, loaded));
+        CHECK_FALSE(reopened.load("carts/a.p8", key, loaded));
+
+        CartCache tiny(".", 10, 100);
+        REQUIRE(tiny.save("carts/e.p8", key, entry));
+        //an entry bigger than the byte limit is still kept while it is the newest
+        CHECK(tiny.load("carts/e.p8", key, loaded));
+        REQUIRE(tiny.save("carts/f.p8", key, entry));
+        CHECK_FALSE(tiny.load("carts/e.p8", key, loaded));
+
+        for (std::string path : { "carts/a.p8", "carts/b.p8", "carts/c.p8", "carts/d.p8", "carts/e.p8", "carts/f.p8" }) {
+            remove(small.entryPath(path).c_str());
+        }
+    }
+
+    remove(cache.entryPath(cartPath).c_str());
+    remove("./cartcache-lru.bin");
+}
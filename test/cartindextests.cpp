@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <utime.h>
+
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+#include "../source/cartIndex.h"
+#include "../source/cart.h"
+#include "../source/stringToDataHelpers.h"
+
+static void writeTestCart(const char* path, const char* title, time_t mtime) {
+    FILE* file = fopen(path, "wb");
+    fprintf(file, "pico-8 cartridge // http://www.pico-8.com\nversion 32\n__lua__\n-- %s\nprint(1)\n", title);
+    fclose(file);
+
+    struct utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    utime(path, &times);
+}
+
+TEST_CASE("cart index") {
+    CartIndex index;
+    index.setDirectories("carts", ".");
+
+    SUBCASE("p8 carts index their first lua lines") {
+        const CartIndexEntry* entry = index.lookup("cartparsetest.p8");
+        REQUIRE(entry != nullptr);
+        CHECK_EQ(entry->type, CartIndexType_P8);
+        CHECK_EQ(entry->titleLines.size(), 1);
+        CHECK_EQ(entry->titleLines[0], "a=1");
+        CHECK_FALSE(entry->hasLabel);
+    }
+    SUBCASE("png carts index their decompressed lua") {
+        const CartIndexEntry* entry = index.lookup("pxacompressed.p8.png");
+        REQUIRE(entry != nullptr);
+        CHECK_EQ(entry->type, CartIndexType_Png);
+        REQUIRE_EQ(entry->titleLines.size(), CART_INDEX_TITLE_LINES);
+        CHECK_EQ(entry->titleLines[0], "-- buzzsaw cat");
+        CHECK_EQ(entry->titleLines[1], "-- by dps2004");
+    }
+    SUBCASE("labels are decoded like the label text") {
+        const CartIndexEntry* entry = index.lookup("songtest.p8");
+        REQUIRE(entry != nullptr);
+        REQUIRE(entry->hasLabel);
+
+        Cart* cart = new Cart("songtest.p8", "carts");
+        std::vector<uint8_t> expected(0x10000, 0);
+        copy_string_to_sprite_memory(expected.data(), cart->LabelString);
+        CHECK_EQ(memcmp(entry->label.data(), expected.data(), CART_INDEX_LABEL_BYTES), 0);
+
+        std::fill(expected.begin(), expected.end(), 0);
+        copy_mini_label_to_sprite_memory(expected.data(), cart->LabelString, 0);
+        for (int row = 0; row < CART_INDEX_MINI_LABEL_ROWS; row++) {
+            CHECK_EQ(memcmp(entry->miniLabel.data() + row * CART_INDEX_MINI_LABEL_ROW_BYTES,
+                expected.data() + row * 64, CART_INDEX_MINI_LABEL_ROW_BYTES), 0);
+        }
+        delete cart;
+    }
+    SUBCASE("missing carts have no entry") {
+        CHECK(index.lookup("nocart.p8") == nullptr);
+    }
+    SUBCASE("saved entries are used until the cart changes") {
+        writeTestCart("carts/cartindextest.p8", "first", 1000000);
+        REQUIRE(index.lookup("cartindextest.p8") != nullptr);
+        REQUIRE(index.lookup("songtest.p8") != nullptr);
+        REQUIRE(index.save());
+        CHECK_FALSE(index.save());
+
+        //same size and mtime, so a loaded index still has the old title
+        writeTestCart("carts/cartindextest.p8", "other", 1000000);
+        CartIndex loaded;
+        loaded.setDirectories("carts", ".");
+        const CartIndexEntry* entry = loaded.lookup("cartindextest.p8");
+        REQUIRE(entry != nullptr);
+        CHECK_EQ(entry->titleLines[0], "-- first");
+        CHECK(loaded.lookup("songtest.p8")->hasLabel);
+
+        writeTestCart("carts/cartindextest.p8", "other", 2000000);
+        entry = loaded.lookup("cartindextest.p8");
+        REQUIRE(entry != nullptr);
+        CHECK_EQ(entry->titleLines[0], "-- other");
+
+        remove("carts/cartindextest.p8");
+    }
+    SUBCASE("carts no longer listed are dropped") {
+        REQUIRE(index.lookup("cartparsetest.p8") != nullptr);
+        index.save();
+
+        index.removeMissing({ "cartparsetest.p8" });
+        CHECK_FALSE(index.save());
+        index.removeMissing({});
+        CHECK(index.save());
+    }
+
+    remove(index.indexPath().c_str());
+}
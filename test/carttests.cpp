@@ -1,5 +1,8 @@
+#include <string.h>
+
 #include "doctest.h"
 #include "../source/cart.h"
+#include "../source/filehelpers.h"
 
 TEST_CASE("Loads bios cart") {
     Cart* cart = new Cart("__FAKE08-BIOS.p8", "");
@@ -217,12 +220,73 @@ TEST_CASE("Load legacy png cart") {
     delete cart;
 }
 
+TEST_CASE("Load compressed png carts") {
+    //the lua of carts/ld45.p8, stored pxa and legacy compressed
+    Cart* pxaCart = new Cart("pxacompressed.p8.png", "carts");
+    Cart* legacyCart = new Cart("legacycompressed.p8.png", "carts");
+
+    SUBCASE("errors are empty") {
+        CHECK(pxaCart->LoadError == "");
+        CHECK(legacyCart->LoadError == "");
+    }
+    SUBCASE("pxa lua is decompressed") {
+        CHECK(pxaCart->LuaString.length() == 13188);
+        CHECK(pxaCart->LuaString.substr(0, 29) == "-- buzzsaw cat\n-- by dps2004\n");
+    }
+    SUBCASE("legacy lua is decompressed") {
+        CHECK(legacyCart->LuaString == pxaCart->LuaString);
+    }
+
+    delete pxaCart;
+    delete legacyCart;
+}
+
+TEST_CASE("Load png that isn't a cart") {
+    Cart* cart = new Cart("screenshots/includetest_f01.png", "carts");
+
+    SUBCASE("dimensions are rejected") {
+        CHECK(cart->LoadError == "Invalid png dimensions");
+    }
+
+    delete cart;
+}
+
 TEST_CASE("cart loading options") {
     Cart* cart = new Cart("#cartparsetest", "carts");
 
     SUBCASE("FullCartPath is correct") {
         CHECK(cart->FullCartPath == "carts/cartparsetest.p8");
     }
+    SUBCASE("contents already read parse the same as the file") {
+        for (std::string name : { "cartparsetest.p8", "cartparsetest.p8.png" }) {
+            Cart* fromFile = new Cart(name, "carts");
+            Cart* fromContents = new Cart(name, "carts", get_file_contents("carts/" + name));
+
+            CHECK_EQ(fromContents->LoadError, "");
+            CHECK_EQ(fromContents->LuaString, fromFile->LuaString);
+            CHECK_EQ(memcmp(fromContents->CartRom.data, fromFile->CartRom.data, sizeof(fromFile->CartRom.data)), 0);
+
+            delete fromFile;
+            delete fromContents;
+        }
+    }
 
     delete cart;
-}
\ No newline at end of file
+}
+
+TEST_CASE("Load p8 cart with include") {
+    Cart* cart = new Cart("carts/includetest.p8", "");
+
+    SUBCASE("include is flagged") {
+        CHECK(cart->UsesIncludes);
+    }
+    SUBCASE("Lua section has the included file") {
+        CHECK(cart->LuaString == "function _draw()\n cls()\n print(\"included successfully!\")\nend\n");
+    }
+    SUBCASE("Gfx data after the include is populated") {
+        CHECK(cart->CartRom.SpriteSheetData[129] == 0x07);
+        CHECK(cart->CartRom.SpriteSheetData[130] == 0x70);
+    }
+
+    delete cart;
+}
@@ -0,0 +1,38 @@
+#include "doctest.h"
+#include "../source/emojiconversion.h"
+
+TEST_CASE("PICO-8 charset conversion") {
+    SUBCASE("ascii passes through") {
+        CHECK(charset::utf8_to_pico8("print(\"hi\")\n") == "print(\"hi\")\n");
+    }
+    SUBCASE("glyphs convert to their pico 8 codes") {
+        CHECK(charset::utf8_to_pico8("█") == "\x80");
+        CHECK(charset::utf8_to_pico8("a♥b") == "a\x87" "b");
+        CHECK(charset::utf8_to_pico8("◜◝") == "\xfe\xff");
+    }
+    SUBCASE("emoji with a variation selector convert to one code") {
+        CHECK(charset::utf8_to_pico8("⬇️⬅️🅾️➡️⬆️") == "\x83\x8b\x8e\x91\x94");
+    }
+    SUBCASE("emoji missing the variation selector are left alone") {
+        CHECK(charset::utf8_to_pico8("\xe2\xac\x87x") == "\xe2\xac\x87x");
+    }
+    SUBCASE("truncated and stray utf8 bytes are left alone") {
+        CHECK(charset::utf8_to_pico8("\xe3\x81") == "\xe3\x81");
+        CHECK(charset::utf8_to_pico8("\x81z") == "\x81z");
+    }
+    SUBCASE("every character round trips") {
+        std::string all;
+        for (int i = 1; i < 256; i++) {
+            all += (char)i;
+        }
+        CHECK(charset::utf8_to_pico8(charset::pico8_to_utf8(all)) == all);
+    }
+    SUBCASE("utf32 table splits emoji codepoints") {
+        CHECK(charset::to_utf32[0x80] == U"█");
+        CHECK(charset::to_utf32[0x83].size() == 2);
+        CHECK(charset::to_utf32[0x83][1] == 0xfe0f);
+    }
+    SUBCASE("uppercase letters type glyphs") {
+        CHECK(charset::upper_to_emoji("aAZ♥") == "a\x80\x99\x87");
+    }
+}
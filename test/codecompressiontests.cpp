@@ -0,0 +1,40 @@
+#include "doctest.h"
+#include "../source/codeCompression.h"
+
+#include <string.h>
+
+//both streams hold 'print("hello hello hello")\nx=1;;;;;;;;;;', and use
+//back references that overlap the bytes they write
+static const uint8_t legacyCode[] =
+    "\x3a\x63\x3a\x00\x00\x28\x00\x00\x1c\x1e\x15\x1a\x20\x2a\x00\x22\x14\x11\x18\x18"
+    "\x1b\x02\x3c\x96\x00\x22\x2b\x01\x24\x33\x04\x37\x3c\x71";
+
+static const uint8_t pxaCode[] =
+    "\x00\x70\x78\x61\x00\x28\x00\x24\x0f\xf0\x04\xb7\x3f\xc0\x23\xac\x0f\x5f\x7f\xfb"
+    "\x03\x04\x4f\xb0\xed\xf2\x54\x27\xec\x3c\xc4\x5d\xc7\x9c\x65\x60";
+
+static const std::string expectedCode = "print(\"hello hello hello\")\nx=1;;;;;;;;;;";
+
+TEST_CASE("lua code decompression") {
+    SUBCASE("legacy format") {
+        CHECK(decompressLegacyCode(legacyCode, sizeof(legacyCode) - 1) == expectedCode);
+    }
+    SUBCASE("pxa format") {
+        CHECK(decompressPxaCode(pxaCode, sizeof(pxaCode) - 1) == expectedCode);
+    }
+    SUBCASE("output stops at the header length") {
+        uint8_t shorter[sizeof(pxaCode)];
+        memcpy(shorter, pxaCode, sizeof(pxaCode));
+        shorter[5] = 10;
+        CHECK(decompressPxaCode(shorter, sizeof(shorter) - 1) == expectedCode.substr(0, 10));
+
+        memcpy(shorter, legacyCode, sizeof(legacyCode));
+        shorter[5] = 10;
+        CHECK(decompressLegacyCode(shorter, sizeof(legacyCode) - 1) == expectedCode.substr(0, 10));
+    }
+    SUBCASE("truncated input stops early") {
+        CHECK(decompressPxaCode(pxaCode, 20).length() < expectedCode.length());
+        CHECK(decompressLegacyCode(legacyCode, 20).length() < expectedCode.length());
+        CHECK(decompressPxaCode(pxaCode, 4) == "");
+    }
+}
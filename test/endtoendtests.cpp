@@ -2,6 +2,7 @@
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <thread>
 
 #include "doctest.h"
 #include "../libs/lodepng/lodepng.h"
@@ -10,6 +11,7 @@
 #include "../source/host.h"
 #include "../source/hostVmShared.h"
 #include "../source/nibblehelpers.h"
+#include "stubhost.h"
 
 bool verifyScreenshot(Vm* vm, Host* host, std::string screenshotFilename) {
     std::vector<unsigned char> png;
@@ -724,4 +726,87 @@ TEST_CASE("Loading and running carts") {
     
     delete vm;
     delete host;
-}
\ No newline at end of file
+}
+
+//loads a cart into a fresh vm, runs it and returns its ram
+static std::vector<uint8_t> runCartForFrames(std::string cart, int frames) {
+    Host* host = new Host();
+    Vm* vm = new Vm(host);
+
+    vm->LoadCart(cart, false);
+    for (int i = 0; i < frames; i++) {
+        vm->UpdateAndDraw();
+    }
+
+    PicoRam* ram = vm->getPicoRam();
+    std::vector<uint8_t> result(ram->data, ram->data + sizeof(ram->data));
+
+    delete vm;
+    delete host;
+
+    return result;
+}
+
+TEST_CASE("Vms running in parallel stay isolated") {
+    std::vector<std::string> carts = {
+        "pset00-test.p8",
+        "psetall.p8",
+        "cliptest.p8",
+        "print_scroll_test.p8"
+    };
+    const int frames = 10;
+    const int runsPerCart = 2;
+
+    std::vector<std::vector<uint8_t>> expected;
+    for (std::string cart : carts) {
+        expected.push_back(runCartForFrames(cart, frames));
+    }
+
+    std::vector<std::vector<uint8_t>> results(carts.size() * runsPerCart);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); i++) {
+        threads.push_back(std::thread([&carts, &results, i, frames]() {
+            results[i] = runCartForFrames(carts[i % carts.size()], frames);
+        }));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        std::string cart = carts[i % carts.size()];
+        const std::vector<uint8_t>& ram = results[i];
+        const std::vector<uint8_t>& expectedRam = expected[i % carts.size()];
+
+        REQUIRE_EQ(ram.size(), expectedRam.size());
+        //the screen, and the draw state the api calls leave behind
+        CHECK_MESSAGE(std::equal(ram.begin() + 0x6000, ram.end(), expectedRam.begin() + 0x6000), cart);
+        CHECK_MESSAGE(std::equal(ram.begin() + 0x5f00, ram.begin() + 0x5f40, expectedRam.begin() + 0x5f00), cart);
+    }
+}
+
+TEST_CASE("Carts running their own flip loop play audio") {
+    StubHost* host = new StubHost();
+    Vm* vm = new Vm(host);
+    vm->LoadCart("songtest.p8", false);
+    REQUIRE(vm->GetBiosError() == "");
+
+    host->stubAudio(true);
+    //never returns to GameLoop, so flip() has to keep the host fed
+    CHECK(vm->ExecuteLua("sfx(1) for i=1,4 do flip() end", ""));
+
+    AudioRingBuffer& ring = host->audioRing();
+    CHECK_GT(ring.fillLevel(), 0);
+
+    std::vector<uint32_t> frames(ring.fillLevel());
+    ring.read(&frames[0], frames.size());
+    bool audible = false;
+    for (uint32_t frame : frames) {
+        audible |= frame != 0;
+    }
+    CHECK(audible);
+
+    host->stubAudio(false);
+    delete vm;
+    delete host;
+}
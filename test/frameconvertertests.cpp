@@ -0,0 +1,151 @@
+#include "doctest.h"
+#include "../source/frameConverter.h"
+#include "../source/nibblehelpers.h"
+
+TEST_CASE("frame converter") {
+    uint8_t picoFb[128 * 64];
+    uint8_t screenPaletteMap[16];
+    uint32_t hostColors[144];
+    uint32_t out[128 * 128];
+
+    for (int i = 0; i < 144; i++) {
+        hostColors[i] = 0x1000 + i;
+    }
+    for (int i = 0; i < 16; i++) {
+        screenPaletteMap[i] = i;
+    }
+    for (int y = 0; y < 128; y++) {
+        for (int x = 0; x < 128; x++) {
+            setPixelNibble(x, y, (x + y * 3) & 15, picoFb);
+        }
+    }
+
+    FrameConverter<uint32_t> converter;
+    converter.setHostColors(hostColors);
+
+    SUBCASE("converts every pixel through the screen palette") {
+        screenPaletteMap[3] = 130;
+        screenPaletteMap[4] = 0x8f | 0x10;
+        converter.convertFrame(picoFb, screenPaletteMap, out, 128 * sizeof(uint32_t));
+
+        bool allMatch = true;
+        for (int y = 0; y < 128; y++) {
+            for (int x = 0; x < 128; x++) {
+                uint8_t c = getPixelNibble(x, y, picoFb);
+                allMatch &= out[y * 128 + x] == hostColors[screenPaletteMap[c] & 0x8f];
+            }
+        }
+        CHECK(allMatch);
+    }
+    SUBCASE("rebuilds the table when the screen palette changes") {
+        converter.convertFrame(picoFb, screenPaletteMap, out, 128 * sizeof(uint32_t));
+        CHECK_EQ(out[1], hostColors[1]);
+
+        screenPaletteMap[1] = 8;
+        converter.convertFrame(picoFb, screenPaletteMap, out, 128 * sizeof(uint32_t));
+        CHECK_EQ(out[1], hostColors[8]);
+    }
+    SUBCASE("honors destination pitch") {
+        uint32_t padded[128 * 130];
+        memset(padded, 0, sizeof(padded));
+        converter.convertFrame(picoFb, screenPaletteMap, padded, 130 * sizeof(uint32_t));
+
+        CHECK_EQ(padded[130 + 0], hostColors[3]);
+        CHECK_EQ(padded[129], 0);
+        CHECK_EQ(padded[127 * 130 + 127], hostColors[(127 + 127 * 3) & 15]);
+    }
+    SUBCASE("transforms match per pixel placement") {
+        const FrameTransform transforms[] = {
+            FrameTransform_FlipH, FrameTransform_FlipV, FrameTransform_FlipHV,
+            FrameTransform_Rotate90, FrameTransform_Rotate180, FrameTransform_Rotate270
+        };
+        for (FrameTransform transform : transforms) {
+            converter.convertFrame(picoFb, screenPaletteMap, out, 128 * sizeof(uint32_t), transform);
+
+            bool allMatch = true;
+            for (int y = 0; y < 128; y++) {
+                for (int x = 0; x < 128; x++) {
+                    int destX = x;
+                    int destY = y;
+                    switch (transform) {
+                        case FrameTransform_FlipH: destX = 127 - x; break;
+                        case FrameTransform_FlipV: destY = 127 - y; break;
+                        case FrameTransform_FlipHV:
+                        case FrameTransform_Rotate180: destX = 127 - x; destY = 127 - y; break;
+                        case FrameTransform_Rotate90: destX = 127 - y; destY = x; break;
+                        case FrameTransform_Rotate270: destX = y; destY = 127 - x; break;
+                        default: break;
+                    }
+                    allMatch &= out[destY * 128 + destX] == hostColors[getPixelNibble(x, y, picoFb)];
+                }
+            }
+            CHECK_MESSAGE(allMatch, "transform ", (int)transform);
+        }
+    }
+    SUBCASE("rgb565 and bgr24 color helpers") {
+        Color col = { 255, 128, 8, 255 };
+        CHECK_EQ(colorToRgb565(col), 0xfc01);
+        CHECK_EQ(colorToArgb8888(col), 0xffff8008);
+        CHECK_EQ(colorToRgba8888(col), 0xff8008ff);
+
+        Bgr24Col bgr = colorToBgr24(col);
+        CHECK_EQ(bgr.Blue, 8);
+        CHECK_EQ(bgr.Green, 128);
+        CHECK_EQ(bgr.Red, 255);
+    }
+    SUBCASE("first frame dirties every row") {
+        FrameDirtyRows rows = converter.findDirtyRows(picoFb, screenPaletteMap);
+        CHECK_EQ(rows.first, 0);
+        CHECK_EQ(rows.last, 127);
+    }
+    SUBCASE("unchanged frame has no dirty rows") {
+        converter.findDirtyRows(picoFb, screenPaletteMap);
+        FrameDirtyRows rows = converter.findDirtyRows(picoFb, screenPaletteMap);
+        CHECK_FALSE(rows.any());
+        CHECK_EQ(rows.count(), 0);
+    }
+    SUBCASE("dirty rows span the changed scanlines") {
+        converter.findDirtyRows(picoFb, screenPaletteMap);
+        setPixelNibble(5, 20, 0, picoFb);
+        setPixelNibble(127, 43, 7, picoFb);
+
+        FrameDirtyRows rows = converter.findDirtyRows(picoFb, screenPaletteMap);
+        CHECK_EQ(rows.first, 20);
+        CHECK_EQ(rows.last, 43);
+
+        rows = converter.findDirtyRows(picoFb, screenPaletteMap);
+        CHECK_FALSE(rows.any());
+
+        setPixelNibble(0, 127, 1, picoFb);
+        rows = converter.findDirtyRows(picoFb, screenPaletteMap);
+        CHECK_EQ(rows.first, 127);
+        CHECK_EQ(rows.last, 127);
+    }
+    SUBCASE("palette changes dirty every row") {
+        uint8_t altPaletteMap[16] = {0};
+        uint8_t altLines[16] = {0};
+        converter.findDirtyRows(picoFb, screenPaletteMap);
+
+        screenPaletteMap[2] = 9;
+        CHECK_EQ(converter.findDirtyRows(picoFb, screenPaletteMap).count(), 128);
+        CHECK_EQ(converter.findDirtyRows(picoFb, screenPaletteMap, altPaletteMap, altLines).count(), 128);
+        CHECK_FALSE(converter.findDirtyRows(picoFb, screenPaletteMap, altPaletteMap, altLines).any());
+
+        altLines[3] = 1;
+        CHECK_EQ(converter.findDirtyRows(picoFb, screenPaletteMap, altPaletteMap, altLines).count(), 128);
+
+        converter.setHostColors(hostColors);
+        CHECK_EQ(converter.findDirtyRows(picoFb, screenPaletteMap, altPaletteMap, altLines).count(), 128);
+    }
+    SUBCASE("convertRows writes only the given rows from dest") {
+        for (int i = 0; i < 128 * 128; i++) {
+            out[i] = 0;
+        }
+        FrameDirtyRows rows = { 10, 12 };
+        converter.convertRows(picoFb, screenPaletteMap, out, 128 * sizeof(uint32_t), rows);
+
+        CHECK_EQ(out[0], hostColors[getPixelNibble(0, 10, picoFb)]);
+        CHECK_EQ(out[2 * 128 + 127], hostColors[getPixelNibble(127, 12, picoFb)]);
+        CHECK_EQ(out[3 * 128], 0);
+    }
+}
@@ -0,0 +1,89 @@
+#include "doctest.h"
+#include "../source/framePacer.h"
+
+#include <chrono>
+#include <thread>
+
+static int sleepCalls = 0;
+
+static void sleepPrecise(uint32_t microseconds) {
+    sleepCalls++;
+    std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+}
+
+//same rounding as SDL_Delay
+static void sleepWholeMilliseconds(uint32_t microseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(microseconds / 1000));
+}
+
+TEST_CASE("frame pacer") {
+    FramePacer pacer;
+
+    SUBCASE("no stats before two frames") {
+        CHECK_EQ(pacer.measuredFps(), 0);
+        pacer.markFrame();
+        CHECK_EQ(pacer.measuredFps(), 0);
+        CHECK_EQ(pacer.jitterMs(), 0);
+    }
+    SUBCASE("measures the paced rate") {
+        pacer.setTargetFps(100);
+        for (int i = 0; i < 11; i++) {
+            pacer.waitForNextFrame(sleepPrecise);
+        }
+
+        CHECK_GT(pacer.measuredFps(), 70);
+        CHECK_LT(pacer.measuredFps(), 110);
+        CHECK_EQ(pacer.missedDeadlines(), 0);
+    }
+    SUBCASE("millisecond sleeps don't drift") {
+        //60fps is 16.67ms, which a millisecond sleep can't hit frame by frame
+        pacer.setTargetFps(60);
+        pacer.waitForNextFrame(sleepWholeMilliseconds);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 30; i++) {
+            pacer.waitForNextFrame(sleepWholeMilliseconds);
+        }
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        CHECK_GT(elapsedMs, 490);
+        CHECK_LT(elapsedMs, 560);
+    }
+    SUBCASE("millisecond sleeps don't wake before the deadline") {
+        pacer.setTargetFps(60);
+        pacer.waitForNextFrame(sleepWholeMilliseconds);
+        auto start = std::chrono::steady_clock::now();
+
+        bool early = false;
+        for (int i = 1; i <= 10; i++) {
+            pacer.waitForNextFrame(sleepWholeMilliseconds);
+            double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            early |= elapsedMs < i * 1000.0 / 60;
+        }
+
+        CHECK_FALSE(early);
+    }
+    SUBCASE("precise sleeps cover all but the end of the frame") {
+        pacer.setTargetFps(100);
+        pacer.waitForNextFrame(sleepPrecise);
+        sleepCalls = 0;
+        for (int i = 0; i < 10; i++) {
+            pacer.waitForNextFrame(sleepPrecise);
+        }
+
+        //one sleep a frame, and one more for a frame the scheduler woke early
+        CHECK_LE(sleepCalls, 20);
+    }
+    SUBCASE("late frames count as missed deadlines") {
+        pacer.setTargetFps(100);
+        pacer.waitForNextFrame(sleepPrecise);
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        pacer.waitForNextFrame(sleepPrecise);
+
+        CHECK_EQ(pacer.missedDeadlines(), 1);
+
+        pacer.resetStats();
+        CHECK_EQ(pacer.missedDeadlines(), 0);
+        CHECK_EQ(pacer.measuredFps(), 0);
+    }
+}
@@ -1,11 +1,13 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <chrono>
 
 #include "doctest.h"
 #include "../source/graphics.h"
 #include "../source/fontdata.h"
 #include "../source/PicoRam.h"
+#include "../source/frameConverter.h"
 
 #include "testHelpers.h"
 
@@ -512,6 +514,62 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("circfill and ovalfill with fill pattern and bitmask cover the same pixels as plain fills") {
+        //0b0101101001011010.1 - 1x1 checkerboard with transparency
+        const uint16_t pattern = 0x5A5A;
+        uint8_t covered[128 * 128];
+
+        for (int shape = 0; shape < 12; shape++) {
+            const int ox = 40 + shape % 2;
+            const int oy = 41 + shape % 3;
+            const int r = shape + 1;
+
+            for (int pass = 0; pass < 2; pass++) {
+                if (pass == 0) {
+                    graphics->fillp(0);
+                    picoRam.hwState.colorBitmask = 0xff;
+                    graphics->cls(0);
+                }
+                else {
+                    graphics->fillp(23130.5);
+                    picoRam.hwState.colorBitmask = 0x33;
+                    graphics->cls(8);
+                }
+
+                if (shape < 6) {
+                    graphics->circfill(ox, oy, r, 7);
+                }
+                else {
+                    graphics->ovalfill(ox - r, oy - r / 2, ox + r, oy + r / 2, 7);
+                }
+
+                for (int y = 0; y < 128; y++) {
+                    for (int x = 0; x < 128; x++) {
+                        const uint8_t c = graphics->pget(x, y);
+                        if (pass == 0) {
+                            covered[y * 128 + x] = c != 0;
+                            continue;
+                        }
+
+                        const bool alt = (pattern >> (15 - ((x & 3) + 4 * (y & 3)))) & 1;
+                        //bitmask keeps the upper 2 bits of 8 and takes the lower 2 of 7
+                        const uint8_t expected = covered[y * 128 + x] && !alt ? 11 : 8;
+                        if (c != expected) {
+                            FAIL_CHECK("shape " << shape << " differs at " << x << "," << y);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    SUBCASE("ovalfill(...) entirely below the clip rect draws nothing") {
+        graphics->cls();
+        graphics->ovalfill(55, 128, 144, 138, 13);
+
+        for (int x = 0; x < 128; x++) {
+            CHECK_EQ(graphics->pget(x, 127), 0);
+        }
+    }
     SUBCASE("rect({x1}, {y1}, {x2}, {y2}) uses pen color") {
         graphics->cls();
         graphics->color(15);
@@ -742,6 +800,48 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("spr(...) draws flipped horizontal with left edge clipped") {
+        graphics->cls();
+        for(uint8_t i = 0; i < 16; i++) {
+            graphics->sset(i, 0, i);
+        }
+
+        graphics->clip(36, 0, 128, 128);
+        graphics->spr(0, 35, 100, 1.0, 1.0, true, false);
+        
+        std::vector<coloredPoint> expectedPoints = {
+            {35, 100, 0},
+            {36, 100, 6},
+            {37, 100, 5},
+            {38, 100, 4},
+            {39, 100, 3},
+            {40, 100, 2},
+            {41, 100, 1},
+            {42, 100, 0},
+            {43, 100, 0},
+        };
+
+        checkPoints(graphics, expectedPoints);
+    }
+    SUBCASE("spr(...) applies color bitmask") {
+        graphics->cls(8);
+        for(uint8_t i = 0; i < 8; i++) {
+            graphics->sset(i, 0, i == 0 ? 0 : 15);
+        }
+
+        picoRam.hwState.colorBitmask = 0xf1;
+        graphics->spr(0, 20, 30, 1.0, 1.0, false, false);
+        
+        std::vector<coloredPoint> expectedPoints = {
+            {20, 30, 8},
+            {21, 30, 9},
+            {24, 30, 9},
+            {27, 30, 9},
+            {28, 30, 8},
+        };
+
+        checkPoints(graphics, expectedPoints);
+    }
     SUBCASE("spr(...) draws to screen at odd numbered location") {
         graphics->cls();
         
@@ -1704,6 +1804,39 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("map at odd offset with camera and clip matches drawing cells with spr"){
+        for(int i = 0; i < 128; i++) {
+            for (int j = 0; j < 32; j++)
+            graphics->sset(i, j, (i + j) % 16);
+        }
+        for(int x = 0; x < 20; x++) {
+            for (int y = 0; y < 20; y++) {
+                graphics->mset(x, y, (x * 7 + y) % 5 == 0 ? 0 : (x + y * 16) % 64);
+            }
+        }
+        graphics->fset(17, 2);
+        graphics->fset(34, 2);
+
+        graphics->camera(-3, 5);
+        graphics->clip(9, 13, 101, 90);
+        graphics->map(1, 2, 7, 3, 18, 17, 0);
+
+        uint8_t mapDrawn[128 * 64];
+        memcpy(mapDrawn, picoRam.screenBuffer, sizeof(mapDrawn));
+
+        graphics->cls();
+        graphics->clip(9, 13, 101, 90);
+        for(int x = 0; x < 18; x++) {
+            for (int y = 0; y < 17; y++) {
+                uint8_t cell = graphics->mget(1 + x, 2 + y);
+                if (cell) {
+                    graphics->spr(cell, 7 + x * 8, 3 + y * 8, 1, 1, false, false);
+                }
+            }
+        }
+
+        CHECK(memcmp(mapDrawn, picoRam.screenBuffer, sizeof(mapDrawn)) == 0);
+    }
     SUBCASE("pal({c0}, {c1}) remaps draw color") {
         graphics->pal(14, 5, 0);
 
@@ -1802,6 +1935,79 @@ TEST_CASE("graphics class behaves as expected") {
         CHECK_EQ(5, graphics->getDrawPalMappedColor(14));
         CHECK_EQ(13, graphics->getScreenPalMappedColor(13));
     }
+    SUBCASE("pal({c0}, {c1}, 2) remaps secondary screen color") {
+        graphics->pal(2);
+        graphics->pal(9, 135, 2);
+
+        CHECK_EQ(135, picoRam.hwState.alternatePaletteMap[9]);
+        CHECK_EQ(3, picoRam.hwState.alternatePaletteMap[3]);
+        CHECK_EQ(9, picoRam.drawState.screenPaletteMap[9]);
+    }
+    SUBCASE("secondary screen palette is only exposed when enabled at 0x5f5f") {
+        picoRam.hwState.alternatePaletteFlag = 0;
+        CHECK(graphics->GetAltScreenPaletteMap() == nullptr);
+        CHECK(graphics->GetAltScreenPaletteLines() == nullptr);
+
+        picoRam.hwState.alternatePaletteFlag = 0x10;
+        CHECK(graphics->GetAltScreenPaletteMap() == picoRam.hwState.alternatePaletteMap);
+        CHECK(graphics->GetAltScreenPaletteLines() == picoRam.hwState.alternatePaletteScreenLineBitfield);
+    }
+    SUBCASE("secondary screen palette applies to flagged scanlines of the converted frame") {
+        //vertical color bars, each line flagged in 0x5f70 uses the 0x5f60 palette
+        for (int c = 0; c < 16; c++) {
+            graphics->rectfill(c * 8, 0, c * 8 + 7, 127, c);
+        }
+        graphics->pal(4, 130, 1);
+        for (int c = 0; c < 16; c++) {
+            picoRam.hwState.alternatePaletteMap[c] = 15 - c;
+        }
+        memset(picoRam.hwState.alternatePaletteScreenLineBitfield, 0, 16);
+        picoRam.hwState.alternatePaletteScreenLineBitfield[0] = 0x81;
+        picoRam.hwState.alternatePaletteScreenLineBitfield[9] = 0xf0;
+        picoRam.hwState.alternatePaletteScreenLineBitfield[15] = 0x80;
+        picoRam.hwState.alternatePaletteFlag = 0x10;
+
+        uint32_t hostColors[144];
+        for (int i = 0; i < 144; i++) {
+            hostColors[i] = 0xff000000 | i;
+        }
+        FrameConverter<uint32_t> converter;
+        converter.setHostColors(hostColors);
+
+        uint32_t frame[128 * 128];
+        converter.convertFrame(
+            graphics->GetP8FrameBuffer(),
+            graphics->GetScreenPaletteMap(),
+            frame,
+            128 * sizeof(uint32_t),
+            FrameTransform_None,
+            graphics->GetAltScreenPaletteMap(),
+            graphics->GetAltScreenPaletteLines());
+
+        bool matchesReference = true;
+        for (int y = 0; y < 128; y++) {
+            bool altLine = y == 0 || y == 7 || (y >= 76 && y < 80) || y == 127;
+            for (int x = 0; x < 128; x++) {
+                uint8_t c = x / 8;
+                uint8_t expected = altLine ? 15 - c : (c == 4 ? 130 : c);
+                matchesReference &= frame[y * 128 + x] == hostColors[expected];
+            }
+        }
+        CHECK(matchesReference);
+
+        picoRam.hwState.alternatePaletteFlag = 0;
+        converter.convertFrame(
+            graphics->GetP8FrameBuffer(),
+            graphics->GetScreenPaletteMap(),
+            frame,
+            128 * sizeof(uint32_t),
+            FrameTransform_None,
+            graphics->GetAltScreenPaletteMap(),
+            graphics->GetAltScreenPaletteLines());
+
+        CHECK_EQ(frame[0], hostColors[0]);
+        CHECK_EQ(frame[127 * 128 + 40], hostColors[5]);
+    }
     SUBCASE("pal changes sprite colors"){
         for(int i = 0; i < 128; i++) {
             for (int j = 0; j < 32; j++)
@@ -2045,6 +2251,56 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("fill pattern with transparency and color bitmask"){
+        //0b0101101001011010.1 - 1x1 checkerboard with transparency
+        graphics->fillp(23130.5);
+        graphics->cls(8);
+
+        //only the lower 2 bits are read and written
+        picoRam.hwState.colorBitmask = 0x33;
+        graphics->rectfill(1, 0, 6, 1, 7);
+
+        std::vector<coloredPoint> expectedPoints = {
+            { 0, 0, 8},
+            { 1, 0, 8},
+            { 2, 0,11},
+            { 3, 0, 8},
+            { 4, 0,11},
+            { 5, 0, 8},
+            { 6, 0,11},
+            { 7, 0, 8},
+            { 0, 1, 8},
+            { 1, 1,11},
+            { 2, 1, 8},
+            { 3, 1,11},
+            { 4, 1, 8},
+            { 5, 1,11},
+            { 6, 1, 8},
+            { 7, 1, 8},
+            { 1, 2, 8},
+            { 2, 2, 8}
+        };
+
+        checkPoints(graphics, expectedPoints);
+    }
+    SUBCASE("fill pattern affects vertical lines"){
+        graphics->fillp(0x5A5A);
+        graphics->cls(0);
+
+        graphics->line(3, 0, 3, 3, 0x1c);
+
+        std::vector<coloredPoint> expectedPoints = {
+            { 3, 0, 1},
+            { 3, 1,12},
+            { 3, 2, 1},
+            { 3, 3,12},
+            { 3, 4, 0},
+            { 2, 1, 0},
+            { 4, 1, 0}
+        };
+
+        checkPoints(graphics, expectedPoints);
+    }
     //TODO: allow this shorthand to work
     /*
     SUBCASE("fill pattern shorthand works"){
@@ -2188,6 +2444,45 @@ TEST_CASE("graphics class behaves as expected") {
 
         checkPoints(graphics, expectedPoints);
     }
+    SUBCASE("Remap screen to spritesheet applies to patterned fills"){
+        graphics->cls();
+        picoRam.hwState.screenDataMemMapping = 0x00;
+
+        //0b0101101001011010 - 1x1 checkerboard
+        graphics->fillp(0x5A5A);
+        graphics->rectfill(0, 0, 3, 1, 0x1c);
+
+        picoRam.hwState.screenDataMemMapping = 0x60;
+
+        //drawn to the sprite sheet, the screen is untouched
+        CHECK_EQ(graphics->sget(0, 0), 12);
+        CHECK_EQ(graphics->sget(1, 0), 1);
+        CHECK_EQ(graphics->sget(0, 1), 1);
+        CHECK_EQ(graphics->sget(3, 1), 12);
+        CHECK_EQ(graphics->sget(4, 0), 0);
+        CHECK_EQ(graphics->pget(0, 0), 0);
+        CHECK_EQ(graphics->pget(1, 0), 0);
+    }
+    SUBCASE("Remap spritesheet to screen applies to tline"){
+        graphics->cls();
+        graphics->mset(0, 0, 1);
+        //sprite 1 on the real sprite sheet is left empty
+        for (int x = 8; x < 16; x++) {
+            graphics->pset(x, 0, 9);
+        }
+
+        picoRam.hwState.spriteSheetMemMapping = 0x60;
+        graphics->tline(0, 20, 7, 20, 0, 0);
+
+        std::vector<coloredPoint> expectedPoints = {
+            {0,20,9},
+            {3,20,9},
+            {7,20,9},
+            {8,20,0}
+        };
+
+        checkPoints(graphics, expectedPoints);
+    }
     SUBCASE("change map width"){
         picoRam.data[0x5f57] = 4;
 
@@ -2428,4 +2723,38 @@ TEST_CASE("graphics class behaves as expected") {
 
     //general teardown
     delete graphics;
-}
\ No newline at end of file
+}
+
+//timing only, skipped by default. run with: ./testrunner.a -tc="map benchmark" --no-skip
+TEST_CASE("map benchmark" * doctest::skip()) {
+    std::string fontdata = get_font_data();
+    PicoRam picoRam;
+    picoRam.Reset();
+    Graphics* graphics = new Graphics(fontdata, &picoRam);
+
+    for (int i = 0; i < 128; i++) {
+        for (int j = 0; j < 64; j++) {
+            graphics->sset(i, j, (i * 3 + j) % 16);
+        }
+    }
+    //full screen of mostly filled cells, scrolling by odd amounts
+    for (int x = 0; x < 128; x++) {
+        for (int y = 0; y < 32; y++) {
+            graphics->mset(x, y, (x + y) % 7 == 0 ? 0 : 1 + (x * 5 + y) % 127);
+        }
+    }
+
+    const int frames = 2000;
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        graphics->cls();
+        graphics->camera(f % 64, (f / 3) % 32);
+        graphics->map(0, 0, 0, 0, 24, 24);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double usPerFrame = std::chrono::duration<double, std::micro>(end - start).count() / frames;
+    MESSAGE("full screen map(): " << usPerFrame << " us per frame");
+
+    delete graphics;
+}
@@ -22,8 +22,7 @@ TEST_CASE("audio stats") {
   Input * input = new Input(&picoRam);
   StubHost* stubHost = new StubHost();
   Vm* vm = new Vm(stubHost, &picoRam, graphics, input, audio);
-  initPicoApi(&picoRam, graphics,  input, vm, audio);
-  lua_State *L = luaL_newstate();
+  lua_State *L = newPicoApiState(vm->getPicoApiContext());
 
   SUBCASE("get sfx 0") {
     audio->api_sfx(5,0,0);
@@ -178,8 +177,7 @@ TEST_CASE("print") {
   Input * input = new Input(&picoRam);
   StubHost* stubHost = new StubHost();
   Vm* vm = new Vm(stubHost, &picoRam, graphics, input, audio);
-  initPicoApi(&picoRam, graphics,  input, vm, audio);
-  lua_State *L = luaL_newstate();
+  lua_State *L = newPicoApiState(vm->getPicoApiContext());
 
   SUBCASE("print puts a newline at the end implicitly") {
     lua_pushstring(L, "hello world");
@@ -197,3 +195,54 @@ TEST_CASE("print") {
     CHECK_EQ(picoRam.drawState.text_y, 0);
   }
 }
+
+TEST_CASE("cpu and memory stats") {
+  // setup
+  PicoRam picoRam;
+  picoRam.Reset();
+  Audio* audio = new Audio(&picoRam);
+  std::string fontdata = get_font_data();
+  Graphics* graphics = new Graphics(fontdata, &picoRam);
+  Input * input = new Input(&picoRam);
+  StubHost* stubHost = new StubHost();
+  Vm* vm = new Vm(stubHost, &picoRam, graphics, input, audio);
+  lua_State *L = newPicoApiState(vm->getPicoApiContext());
+
+  SUBCASE("stat 0 reports the lua heap in KB") {
+    lua_pushnumber(L, 0);
+    stat(L);
+    double before = (double)lua_tonumber(L, -1);
+    CHECK_GT(before, 0);
+
+    luaL_dostring(L, "t = {} for i=1,1000 do t[i] = {} end");
+
+    lua_pushnumber(L, 0);
+    stat(L);
+    CHECK_GT((double)lua_tonumber(L, -1), before);
+  }
+  SUBCASE("stat 1 is a fraction of the frame used so far") {
+    vm->startFrameTiming();
+
+    lua_pushnumber(L, 1);
+    stat(L);
+    double usage = (double)lua_tonumber(L, -1);
+    CHECK_GE(usage, 0);
+    CHECK_LT(usage, 1);
+  }
+  SUBCASE("stat 2 counts time spent in api calls") {
+    vm->startFrameTiming();
+
+    lua_pushnumber(L, 2);
+    stat(L);
+    CHECK_EQ((double)lua_tonumber(L, -1), 0);
+
+    //enough calls to show up at fix32 precision
+    for (int i = 0; i < 100; i++) {
+      cls(L);
+    }
+
+    lua_pushnumber(L, 2);
+    stat(L);
+    CHECK_GT((double)lua_tonumber(L, -1), 0);
+  }
+}
@@ -27,14 +27,14 @@ TEST_CASE("Print helper functions") {
 
     Vm* vm = new Vm(stubHost, memory, graphics, input, audio);
 
-    initPrintHelper(memory, graphics, vm, audio);
+    PrintHelper* printHelper = new PrintHelper(memory, graphics, vm, audio);
 
     SUBCASE("print({str}) uses current color, ignoring transparency") {
         graphics->cls();
         graphics->color(2);
         graphics->palt(2, true);
 
-        print("t");
+        printHelper->print("t");
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 2},
@@ -54,7 +54,7 @@ TEST_CASE("Print helper functions") {
         memory->drawState.text_x = 15;
         memory->drawState.text_y = 98;
 
-        print("t");
+        printHelper->print("t");
 
         std::vector<coloredPoint> expectedPoints = {
             {15, 98, 3},
@@ -73,7 +73,7 @@ TEST_CASE("Print helper functions") {
         memory->drawState.text_x = 15;
         memory->drawState.text_y = 110;
 
-        print("doesnt matter");
+        printHelper->print("doesnt matter");
 
         CHECK(memory->drawState.text_y == 116);
     }
@@ -82,7 +82,7 @@ TEST_CASE("Print helper functions") {
         memory->drawState.text_x = 3;
         memory->drawState.text_y = 4;
 
-        print("doesnt matter", 42, 99);
+        printHelper->print("doesnt matter", 42, 99);
 
         CHECK(memory->drawState.text_x == 42);
         CHECK(memory->drawState.text_y == 105);
@@ -93,7 +93,7 @@ TEST_CASE("Print helper functions") {
         memory->drawState.text_y = 4;
         memory->drawState.color = 10;
 
-        print("doesnt matter", 16, 18, 14);
+        printHelper->print("doesnt matter", 16, 18, 14);
         
         CHECK(memory->drawState.text_x == 16);
         CHECK(memory->drawState.text_y == 24);
@@ -105,7 +105,7 @@ TEST_CASE("Print helper functions") {
         memory->drawState.text_y = 4;
         memory->drawState.color = 10;
 
-        print("doesnt\nmatter\nwell\nkinda\ndoes", 19, 18, 14);
+        printHelper->print("doesnt\nmatter\nwell\nkinda\ndoes", 19, 18, 14);
         
         CHECK(memory->drawState.text_x == 19);
         CHECK(memory->drawState.text_y == 48);
@@ -115,7 +115,7 @@ TEST_CASE("Print helper functions") {
         graphics->color(2);
         graphics->pal(2, 12, 0);
 
-        print("t");
+        printHelper->print("t");
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 12},
@@ -133,7 +133,7 @@ TEST_CASE("Print helper functions") {
     {
         graphics->cls();
         graphics->camera(-100, -100);
-        print("t");
+        printHelper->print("t");
         graphics->camera();
 
         std::vector<coloredPoint> expectedPoints = {
@@ -152,7 +152,7 @@ TEST_CASE("Print helper functions") {
         graphics->cls();
         graphics->clip(101, 101, 27, 27);
         graphics->camera(-100, -100);
-        print("t");
+        printHelper->print("t");
         graphics->camera();
 
         std::vector<coloredPoint> expectedPoints = {
@@ -170,7 +170,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii tab character advances to next x multiple of 16 (default tab size)") {
         graphics->cls();
 
-        print("a\t:", 0, 0);
+        printHelper->print("a\t:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {17, 0, 0},
@@ -185,7 +185,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii backspace character moves cursor backward 4 pixels (doesn't erase)") {
         graphics->cls();
 
-        print("i\b-", 0, 0);
+        printHelper->print("i\b-", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 6}, {1, 0, 6}, {2, 0, 6},
@@ -200,7 +200,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii carriage return character moves cursor back to current cursor x(doesn't erase)") {
         graphics->cls();
 
-        print("i\r-", 10, 0);
+        printHelper->print("i\r-", 10, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {10, 0, 6}, {11, 0, 6}, {12, 0, 6},
@@ -215,7 +215,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii repeat character (\\*) draws character x number of times") {
         graphics->cls();
 
-        print("\x01""5:", 0, 0);
+        printHelper->print("\x01""5:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {17, 0, 0},
@@ -230,7 +230,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii bg color character (\\#) changes bg color") {
         graphics->cls();
 
-        print("\x02""1:", 0, 0);
+        printHelper->print("\x02""1:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 1},
@@ -245,7 +245,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii fg color character (\\f) changes bg color") {
         graphics->cls();
 
-        print("\x0c""2:", 0, 0);
+        printHelper->print("\x0c""2:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -260,7 +260,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii bg color character (\\#) changes bg color using hex") {
         graphics->cls();
 
-        print("\x02""c:", 0, 0);
+        printHelper->print("\x02""c:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 12},
@@ -275,7 +275,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii horizontal move character (\\-) changes x location") {
         graphics->cls();
 
-        print("\x03""a:", 10, 0);
+        printHelper->print("\x03""a:", 10, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {5, 0, 0},
@@ -290,7 +290,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii vertical move character (\\|) changes y location") {
         graphics->cls();
 
-        print("\x05""ab:", 6, 5);
+        printHelper->print("\x05""ab:", 6, 5);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -305,9 +305,9 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code clear screen(\\^c) ") {
         graphics->cls(2);
 
-        print("88888");
+        printHelper->print("88888");
 
-        print("\x06""c3", 0, 0);
+        printHelper->print("\x06""c3", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 3},
@@ -322,7 +322,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code home the cursor(\\^g) ") {
         graphics->cls();
 
-        print("\n\n\nstuff\x06""g:", 0, 0);
+        printHelper->print("\n\n\nstuff\x06""g:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -337,7 +337,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code update cursor home(\\^h) ") {
         graphics->cls();
 
-        print("\n\n\n\x06""h\n\n\nmorestuff\x06""g:", 0, 0);
+        printHelper->print("\n\n\n\x06""h\n\n\nmorestuff\x06""g:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 18, 0},
@@ -353,7 +353,7 @@ TEST_CASE("Print helper functions") {
         graphics->cls();
 
         // coordinates x=40 ("a" = 10, 10 * 4 = 40), y=48 ("c" = 12, 12 * 4 = 48)
-        print("\x06""jac:", 0, 0);
+        printHelper->print("\x06""jac:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {41, 48, 0},
@@ -381,7 +381,7 @@ TEST_CASE("Print helper functions") {
  --print one more ":"
     */
         // coordinates x=40 ("a" = 10, 10 * 4 = 40), y=48 ("c" = 12, 12 * 4 = 48)
-        print("\x06""j87\x03""f\x04""a\x06""h\x0c""7:\x06""je8:\n:", 0, 0);
+        printHelper->print("\x06""j87\x03""f\x04""a\x06""h\x0c""7:\x06""je8:\n:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {32, 22, 0},
@@ -402,7 +402,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code tab stop width(\\^s) ") {
         graphics->cls();
 
-        print("\x06""sc \t:", 0, 0);
+        printHelper->print("\x06""sc \t:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {49, 0, 0},
@@ -417,7 +417,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for rhs wrap(\\^r) ") {
         graphics->cls();
 
-        print("\x06""rsthis is a long string that should wrap somewhere", 0, 0);
+        printHelper->print("\x06""rsthis is a long string that should wrap somewhere", 0, 0);
 
         //the "h" in "should" is the first character to wrap
         std::vector<coloredPoint> expectedPoints = {
@@ -434,7 +434,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for char width(\\^x) ") {
         graphics->cls();
 
-        print("\x06""x7 :", 0, 0);
+        printHelper->print("\x06""x7 :", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {8, 0, 0},
@@ -449,7 +449,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for char width(\\^x) affects bg color ") {
         graphics->cls();
 
-        print("\x06""xz\x06""j00\x02""9 ", 0, 0);
+        printHelper->print("\x06""xz\x06""j00\x02""9 ", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {30, 0, 9},
@@ -465,7 +465,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for wide character(\\^w) ") {
         graphics->cls();
 
-        print("\x06""w::", 0, 0);
+        printHelper->print("\x06""w::", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {2, 0, 0}, {3, 0, 0},    {10, 0, 0}, {11, 0, 0},
@@ -480,7 +480,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for char height(\\^t) ") {
         graphics->cls();
 
-        print("\x06""t:\n:", 0, 0);
+        printHelper->print("\x06""t:\n:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -513,7 +513,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for wide character with stripey option(\\^w\\^=) ") {
         graphics->cls();
 
-        print("\x06""w""\x06""=:", 0, 0);
+        printHelper->print("\x06""w""\x06""=:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {2, 0, 0}, {3, 0, 0},
@@ -528,7 +528,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for char height with stripey option(\\^t\\^=) ") {
         graphics->cls();
 
-        print("\x06""t""\x06""=:", 0, 0);
+        printHelper->print("\x06""t""\x06""=:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -548,7 +548,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for pinball option(\\^p) ") {
         graphics->cls();
 
-        print("\x06""p:", 0, 0);
+        printHelper->print("\x06""p:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {2, 0, 0}, {3, 0, 0},
@@ -568,7 +568,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code to turn off options(\\^-) ") {
         graphics->cls();
 
-        print("\x06""w""\x06""t8" "\x06""-w""\x06""-t:", 0, 0);
+        printHelper->print("\x06""w""\x06""t8" "\x06""-w""\x06""-t:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {9, 0, 0},
@@ -583,8 +583,8 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code to turn off options uses biggest line height(\\^-) ") {
         graphics->cls();
 
-        print("\x06""w""\x06""t8" "\x06""-w""\x06""-t:", 0, 0);
-        print(":");
+        printHelper->print("\x06""w""\x06""t8" "\x06""-w""\x06""-t:", 0, 0);
+        printHelper->print(":");
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 12, 0},
@@ -599,7 +599,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for one off character(\\^:) (colored)") {
         graphics->cls();
 
-        print("\x0c""2\x06"":447cb67c3e7f0106", 0, 0);
+        printHelper->print("\x0c""2\x06"":447cb67c3e7f0106", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 0},
@@ -633,7 +633,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for one off character(\\^:) (pinballed with bg)") {
         graphics->cls();
 
-        print("\x02""4\x06""p\x06"":447cb67c3e7f0106", 0, 0);
+        printHelper->print("\x02""4\x06""p\x06"":447cb67c3e7f0106", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 4},
@@ -660,7 +660,7 @@ TEST_CASE("Print helper functions") {
         //not turned on
         //                   wide  tall  dotty/stripey
         vm->vm_poke(0x5f58, (0x4 | 0x8 | 0x40));
-        print(":", 0, 0);
+        printHelper->print(":", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -677,7 +677,7 @@ TEST_CASE("Print helper functions") {
 
         //                  on    wide  tall  dotty/stripey
         vm->vm_poke(0x5f58, (0x1 | 0x4 | 0x8 | 0x40));
-        print(":", 0, 0);
+        printHelper->print(":", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {2, 0, 0}, {3, 0, 0},
@@ -697,7 +697,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for char width(\\^x) and char height (\\^y) limit rendering ") {
         graphics->cls();
 
-        print("\x06""x2\x06""y3a", 0, 0);
+        printHelper->print("\x06""x2\x06""y3a", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 6},
@@ -726,21 +726,21 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for char height (\\^y) sets line height correctly when lower") {
         graphics->cls();
 
-        print("\x06""y3a", 0, 0);
+        printHelper->print("\x06""y3a", 0, 0);
 
         CHECK_EQ(memory->drawState.text_y, 3);
     }
     SUBCASE("p8scii special control code for char height (\\^y) sets line height correctly when higher") {
         graphics->cls();
 
-        print("\x06""y9a", 0, 0);
+        printHelper->print("\x06""y9a", 0, 0);
 
         CHECK_EQ(memory->drawState.text_y, 9);
     }
     SUBCASE("p8scii audio control codes not printed(\\a)") {
         graphics->cls();
 
-        print("\x07""aceg :", 0, 0);
+        printHelper->print("\x07""aceg :", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {1, 0, 0},
@@ -755,7 +755,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii control code for decorating prev char (\\v)") {
         graphics->cls();
 
-        print("\n:\x0b""b:", 0, 0);
+        printHelper->print("\n:\x0b""b:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {2, 0, 0},
@@ -786,7 +786,7 @@ TEST_CASE("Print helper functions") {
         memory->data[0x5687] = 255; //########
 
         //print char 16 with custom font
-        print("\x0e""\x10""\x0f""", 0, 0);
+        printHelper->print("\x0e""\x10""\x0f""", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 6}, {1, 0, 0},
@@ -806,7 +806,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for inverting colors(\\^i) ") {
         graphics->cls(2);
 
-        print("\x06""i:", 0, 0);
+        printHelper->print("\x06""i:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 6}, {1, 0, 6}, {2, 0, 6},
@@ -821,7 +821,7 @@ TEST_CASE("Print helper functions") {
     SUBCASE("p8scii special control code for solid background(\\^#) ") {
         graphics->cls(2);
 
-        print("\x06""#:", 0, 0);
+        printHelper->print("\x06""#:", 0, 0);
 
         std::vector<coloredPoint> expectedPoints = {
             {0, 0, 0}, {1, 0, 0}, {2, 0, 0},
@@ -840,6 +840,7 @@ TEST_CASE("Print helper functions") {
     delete input;
     delete audio;
 
+    delete printHelper;
     delete vm;
 
     delete memory;
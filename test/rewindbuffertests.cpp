@@ -0,0 +1,228 @@
+#include <string.h>
+
+#include <string>
+
+#include "doctest.h"
+#include "../source/rewindBuffer.h"
+#include "../source/PicoRam.h"
+
+//a frame of a running cart: some memory moving around, a sound playing and
+//a lua state that changes length as it goes
+static void setTestFrame(PicoRam& ram, audioState_t& audio, std::string& lua, int frame) {
+    memset(ram.data, 0, sizeof(ram.data));
+    for (int i = 0; i < 0x2000; i++) {
+        ram.spriteSheetData[i] = (uint8_t)(i * 7 + (i >> 5));
+    }
+    ram.screenBuffer[frame * 13 % sizeof(ram.screenBuffer)] = (uint8_t)frame;
+    ram.drawState.camera_x = (int16_t)frame;
+
+    audio = audioState_t();
+    audio._sfxChannels[1].sfxId = (int16_t)(frame % 64);
+    audio._sfxChannels[1].offset = frame * 0.25f;
+
+    lua = "globals";
+    for (int i = 0; i < 200; i++) {
+        lua += (char)(i + frame);
+    }
+    lua += "score " + std::to_string(frame * 37);
+    lua.append(300, (char)frame);
+}
+
+static void checkTestFrame(const PicoRam& ram, const audioState_t& audio, const std::string* lua, int frame) {
+    static PicoRam expectedRam;
+    audioState_t expectedAudio;
+    std::string expectedLua;
+    setTestFrame(expectedRam, expectedAudio, expectedLua, frame);
+
+    CHECK_EQ(memcmp(ram.data, expectedRam.data, sizeof(ram.data)), 0);
+    CHECK_EQ(audio._sfxChannels[1].sfxId, expectedAudio._sfxChannels[1].sfxId);
+    CHECK_EQ(audio._sfxChannels[1].offset, expectedAudio._sfxChannels[1].offset);
+    if (lua) {
+        CHECK_EQ(*lua, expectedLua);
+    }
+}
+
+static void checkTestFrame(const PicoRam& ram, const audioState_t& audio, const std::string& lua, int frame) {
+    checkTestFrame(ram, audio, &lua, frame);
+}
+
+//steps back in a buffer where every snapshot is a keyframe
+static bool stepBackKeyframe(RewindBuffer& rewind, PicoRam& ram, audioState_t& audio, std::string& lua) {
+    if (!rewind.stepBack(ram, audio)) {
+        return false;
+    }
+
+    CHECK(rewind.atKeyframe());
+    lua = rewind.keyframeLua();
+    return true;
+}
+
+TEST_CASE("rewind buffer") {
+    static PicoRam ram;
+    audioState_t audio;
+    std::string lua;
+
+    SUBCASE("steps back through every snapshot in order") {
+        RewindBuffer rewind(1024 * 1024, 1);
+        for (int frame = 0; frame < 120; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            rewind.capture(ram, audio, lua);
+        }
+        CHECK_EQ(rewind.stepsAvailable(), 119);
+
+        for (int frame = 118; frame >= 0; frame--) {
+            REQUIRE(stepBackKeyframe(rewind, ram, audio, lua));
+            checkTestFrame(ram, audio, lua, frame);
+        }
+        CHECK_FALSE(stepBackKeyframe(rewind, ram, audio, lua));
+    }
+    SUBCASE("entries only hold what changed") {
+        RewindBuffer rewind(1024 * 1024, 1);
+        for (int frame = 0; frame < 11; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            rewind.capture(ram, audio, lua);
+        }
+        //a frame of lua and memory is more than 64k, the changes are a few
+        //hundred bytes of lua and some pairs of memory
+        CHECK_LT(rewind.bytesUsed(), 10 * 1024);
+    }
+    SUBCASE("snapshots are captured every interval frames") {
+        RewindBuffer rewind(1024 * 1024, 4);
+        int captures = 0;
+        for (int frame = 0; frame < 40; frame++) {
+            if (rewind.tick()) {
+                captures++;
+            }
+        }
+        CHECK_EQ(captures, 10);
+    }
+    SUBCASE("the oldest snapshots are dropped to stay in the budget") {
+        const size_t budget = 16 * 1024;
+        RewindBuffer rewind(budget, 1);
+        for (int frame = 0; frame < 1000; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            rewind.capture(ram, audio, lua);
+            CHECK_LE(rewind.bytesUsed(), budget);
+        }
+        const size_t steps = rewind.stepsAvailable();
+        CHECK_GT(steps, 10);
+        CHECK_LT(steps, 999);
+
+        for (size_t i = 1; i <= steps; i++) {
+            REQUIRE(stepBackKeyframe(rewind, ram, audio, lua));
+            checkTestFrame(ram, audio, lua, 999 - (int)i);
+        }
+        CHECK_FALSE(stepBackKeyframe(rewind, ram, audio, lua));
+    }
+    SUBCASE("capturing after stepping back carries on from there") {
+        RewindBuffer rewind(1024 * 1024, 1);
+        for (int frame = 0; frame < 10; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            rewind.capture(ram, audio, lua);
+        }
+        for (int i = 0; i < 5; i++) {
+            REQUIRE(stepBackKeyframe(rewind, ram, audio, lua));
+        }
+        setTestFrame(ram, audio, lua, 50);
+        rewind.capture(ram, audio, lua);
+        CHECK_EQ(rewind.stepsAvailable(), 5);
+
+        REQUIRE(stepBackKeyframe(rewind, ram, audio, lua));
+        checkTestFrame(ram, audio, lua, 4);
+    }
+    SUBCASE("lua states too different in length to line up") {
+        RewindBuffer rewind(1024 * 1024, 1);
+        setTestFrame(ram, audio, lua, 0);
+        rewind.capture(ram, audio, lua);
+        rewind.capture(ram, audio, "x");
+
+        REQUIRE(stepBackKeyframe(rewind, ram, audio, lua));
+        checkTestFrame(ram, audio, lua, 0);
+    }
+    SUBCASE("only keyframes hold the lua state") {
+        RewindBuffer rewind(1024 * 1024, 1, 4);
+        for (int frame = 0; frame <= 20; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            CHECK_EQ(rewind.keyframeDue(), frame % 4 == 0);
+            if (rewind.keyframeDue()) {
+                rewind.capture(ram, audio, lua);
+            }
+            else {
+                rewind.capture(ram, audio);
+            }
+        }
+        CHECK_EQ(rewind.stepsAvailable(), 20);
+
+        for (int frame = 19; frame >= 0; frame--) {
+            REQUIRE(rewind.stepBack(ram, audio));
+            CHECK_EQ(rewind.atKeyframe(), frame % 4 == 0);
+            checkTestFrame(ram, audio, rewind.atKeyframe() ? &rewind.keyframeLua() : nullptr, frame);
+        }
+    }
+    SUBCASE("snapshots without the lua state wait for a keyframe") {
+        RewindBuffer rewind(1024 * 1024, 1, 4);
+        setTestFrame(ram, audio, lua, 0);
+        rewind.capture(ram, audio);
+        rewind.capture(ram, audio);
+        CHECK_EQ(rewind.stepsAvailable(), 0);
+        CHECK_FALSE(rewind.atKeyframe());
+        CHECK(rewind.keyframeDue());
+    }
+    SUBCASE("the oldest snapshot kept is a keyframe") {
+        RewindBuffer rewind(16 * 1024, 1, 4);
+        for (int frame = 0; frame < 1000; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            if (rewind.keyframeDue()) {
+                rewind.capture(ram, audio, lua);
+            }
+            else {
+                rewind.capture(ram, audio);
+            }
+        }
+        const size_t steps = rewind.stepsAvailable();
+        CHECK_GT(steps, 10);
+
+        for (size_t i = 1; i <= steps; i++) {
+            REQUIRE(rewind.stepBack(ram, audio));
+        }
+        CHECK(rewind.atKeyframe());
+        checkTestFrame(ram, audio, rewind.keyframeLua(), 999 - (int)steps);
+        CHECK_FALSE(rewind.stepBack(ram, audio));
+    }
+    SUBCASE("capturing after stepping back to a keyframe keeps the keyframe spacing") {
+        RewindBuffer rewind(1024 * 1024, 1, 4);
+        for (int frame = 0; frame < 10; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            if (rewind.keyframeDue()) {
+                rewind.capture(ram, audio, lua);
+            }
+            else {
+                rewind.capture(ram, audio);
+            }
+        }
+        //back to the keyframe of frame 4
+        for (int i = 0; i < 5; i++) {
+            REQUIRE(rewind.stepBack(ram, audio));
+        }
+        REQUIRE(rewind.atKeyframe());
+
+        for (int frame = 5; frame < 8; frame++) {
+            CHECK_FALSE(rewind.keyframeDue());
+            setTestFrame(ram, audio, lua, frame);
+            rewind.capture(ram, audio);
+        }
+        CHECK(rewind.keyframeDue());
+    }
+    SUBCASE("clearing forgets every snapshot") {
+        RewindBuffer rewind(1024 * 1024, 1);
+        for (int frame = 0; frame < 5; frame++) {
+            setTestFrame(ram, audio, lua, frame);
+            rewind.capture(ram, audio, lua);
+        }
+        rewind.clear();
+        CHECK_EQ(rewind.stepsAvailable(), 0);
+        CHECK_FALSE(rewind.stepBack(ram, audio));
+        CHECK_FALSE(rewind.atKeyframe());
+        CHECK(rewind.tick());
+    }
+}
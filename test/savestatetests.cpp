@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include <string>
+
+#include "doctest.h"
+#include "../source/saveState.h"
+#include "../source/PicoRam.h"
+
+static void fillTestRam(PicoRam& ram) {
+    memset(ram.data, 0, sizeof(ram.data));
+    for (int i = 0; i < 0x2000; i++) {
+        ram.spriteSheetData[i] = (uint8_t)(i * 7 + (i >> 5));
+    }
+    ram.drawState.camera_x = -12;
+    ram.hwState.colorBitmask = 0xff;
+    ram.screenBuffer[100] = 0x3c;
+    ram.userData[0x7fff] = 1;
+}
+
+TEST_CASE("savestates") {
+    static PicoRam ram;
+    static PicoRam decoded;
+    fillTestRam(ram);
+
+    SUBCASE("ram round trips and compresses the empty parts") {
+        std::string encoded;
+        encodeSaveStateRam(encoded, ram.data, nullptr, sizeof(ram.data));
+
+        CHECK_LT(encoded.length(), 0x2000 + 256);
+        REQUIRE(decodeSaveStateRam((const uint8_t*)encoded.data(), encoded.length(), decoded.data, nullptr, sizeof(decoded.data)));
+        CHECK_EQ(memcmp(ram.data, decoded.data, sizeof(ram.data)), 0);
+    }
+    SUBCASE("ram with no empty parts stays within the bound") {
+        for (size_t i = 0; i < sizeof(ram.data); i++) {
+            //zero runs just too short to be worth a pair
+            ram.data[i] = i % (SAVESTATE_ZERO_RUN_MIN + 1) == 0 ? 1 : 0;
+        }
+        std::string encoded;
+        encodeSaveStateRam(encoded, ram.data, nullptr, sizeof(ram.data));
+
+        CHECK_LE(encoded.length(), SAVESTATE_RAM_BOUND(sizeof(ram.data)));
+        REQUIRE(decodeSaveStateRam((const uint8_t*)encoded.data(), encoded.length(), decoded.data, nullptr, sizeof(decoded.data)));
+        CHECK_EQ(memcmp(ram.data, decoded.data, sizeof(ram.data)), 0);
+    }
+    SUBCASE("ram encoded against a reference only holds the changes") {
+        static PicoRam previous;
+        memcpy(previous.data, ram.data, sizeof(ram.data));
+        ram.screenBuffer[5] ^= 0xff;
+        ram.spriteSheetData[300] = 0;
+
+        std::string encoded;
+        encodeSaveStateRam(encoded, ram.data, previous.data, sizeof(ram.data));
+
+        CHECK_LT(encoded.length(), 16);
+        REQUIRE(decodeSaveStateRam((const uint8_t*)encoded.data(), encoded.length(), decoded.data, previous.data, sizeof(decoded.data)));
+        CHECK_EQ(memcmp(ram.data, decoded.data, sizeof(ram.data)), 0);
+    }
+    SUBCASE("audio channels are written field by field") {
+        audioState_t audio;
+        audio._musicChannel.pattern = 12;
+        audio._musicChannel.volume = 0.5f;
+        audio._sfxChannels[2].sfxId = 7;
+        audio._sfxChannels[2].offset = 3.25f;
+        audio._sfxChannels[2].is_music = true;
+        audio._sfxChannels[2].current_note.n.data[1] = 0x5a;
+        audio._sfxChannels[3].customInstrumentChannel.sfxId = 4;
+        audio._sfxChannels[3].prevInstrumentChannel.current_note.phi = 0.75f;
+
+        std::string encoded;
+        writeSaveStateAudio(encoded, audio);
+        CHECK_EQ(encoded.length(), SAVESTATE_AUDIO_BYTES);
+
+        audioState_t loaded;
+        REQUIRE(readSaveStateAudio((const uint8_t*)encoded.data(), encoded.length(), loaded));
+        CHECK_EQ(loaded._musicChannel.pattern, 12);
+        CHECK_EQ(loaded._musicChannel.volume, 0.5f);
+        CHECK_EQ(loaded._sfxChannels[2].sfxId, 7);
+        CHECK_EQ(loaded._sfxChannels[2].offset, 3.25f);
+        CHECK(loaded._sfxChannels[2].is_music);
+        CHECK_EQ(loaded._sfxChannels[2].current_note.n.data[1], 0x5a);
+        CHECK_EQ(loaded._sfxChannels[3].customInstrumentChannel.sfxId, 4);
+        CHECK_EQ(loaded._sfxChannels[3].prevInstrumentChannel.current_note.phi, 0.75f);
+        //the loaded channels still point at their own child channels
+        CHECK_EQ(loaded._sfxChannels[3].getChildChannel(), &loaded._sfxChannels[3].customInstrumentChannel);
+    }
+    SUBCASE("whole states round trip and ignore frontend padding") {
+        audioState_t audio;
+        audio._sfxChannels[0].sfxId = 9;
+        std::string lua = std::string("eris\0state", 10);
+
+        std::string state;
+        writeSaveState(state, ram, audio, lua);
+        CHECK_LE(state.length(), SAVESTATE_BOUND(lua.length()));
+        state.append(100, '\0');
+
+        audioState_t loadedAudio;
+        std::string loadedLua;
+        REQUIRE(readSaveState(state.data(), state.length(), decoded, loadedAudio, loadedLua));
+        CHECK_EQ(memcmp(ram.data, decoded.data, sizeof(ram.data)), 0);
+        CHECK_EQ(loadedAudio._sfxChannels[0].sfxId, 9);
+        CHECK_EQ(loadedLua, lua);
+    }
+    SUBCASE("truncated, corrupt and other version states are rejected") {
+        audioState_t audio;
+        std::string state;
+        writeSaveState(state, ram, audio, "lua");
+
+        audioState_t loadedAudio;
+        std::string loadedLua;
+        CHECK_FALSE(readSaveState(state.data(), state.length() - 1, decoded, loadedAudio, loadedLua));
+        CHECK_FALSE(readSaveState(state.data(), 6, decoded, loadedAudio, loadedLua));
+
+        std::string otherVersion = state;
+        otherVersion[4] = SAVESTATE_FORMAT + 1;
+        CHECK_FALSE(readSaveState(otherVersion.data(), otherVersion.length(), decoded, loadedAudio, loadedLua));
+
+        //ram section claiming more bytes than pico 8 memory has
+        std::string corrupt = state;
+        const size_t ramStart = 8 + 4 + SAVESTATE_AUDIO_BYTES + 4;
+        corrupt[ramStart] = (char)0xff;
+        corrupt[ramStart + 1] = (char)0xff;
+        corrupt[ramStart + 2] = 0x7f;
+        CHECK_FALSE(readSaveState(corrupt.data(), corrupt.length(), decoded, loadedAudio, loadedLua));
+    }
+}
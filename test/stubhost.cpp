@@ -19,6 +19,11 @@ static uint8_t stubCurrKHeld;
 static bool stubCurrKBdown = false;
 static std::string stubCurrKBkey = "";
 
+#define STUB_AUDIO_BLOCK 256
+static bool stubAudioEnabled = false;
+static AudioRingBuffer stubAudioRing(4096);
+static uint32_t stubAudioBuffer[STUB_AUDIO_BLOCK];
+
 
 
 Host::Host() { }
@@ -50,6 +55,15 @@ void StubHost::stubInput(uint8_t kdown, uint8_t kheld) {
     stubCurrKHeld = kheld;
 }
 
+void StubHost::stubAudio(bool enabled) {
+    stubAudioEnabled = enabled;
+    stubAudioRing.clear();
+}
+
+AudioRingBuffer& StubHost::audioRing() {
+    return stubAudioRing;
+}
+
 InputState_t Host::scanInput(){
     return InputState_t {stubCurrKDown, stubCurrKHeld, 0, 0, 0, stubCurrKBdown, stubCurrKBkey};
 }
@@ -63,24 +77,24 @@ void Host::waitForTargetFps(){
 }
 
 
-void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t screenMode){
+void Host::drawFrame(uint8_t* picoFb, uint8_t* screenPaletteMap, uint8_t screenMode, uint8_t* altScreenPaletteMap, uint8_t* altScreenPaletteLines){
     
 }
 
 bool Host::shouldFillAudioBuff(){
-    return false;
+    return stubAudioEnabled && stubAudioRing.freeSpace() >= STUB_AUDIO_BLOCK;
 }
 
 void* Host::getAudioBufferPointer(){
-    return nullptr;
+    return stubAudioBuffer;
 }
 
 size_t Host::getAudioBufferSize(){
-    return 0;
+    return STUB_AUDIO_BLOCK;
 }
 
 void Host::playFilledAudioBuffer(){
-
+    stubAudioRing.write(stubAudioBuffer, STUB_AUDIO_BLOCK);
 }
 
 bool Host::shouldRunMainLoop(){
@@ -131,6 +145,10 @@ std::string Host::getCartDirectory() {
     return "carts";
 }
 
+std::string Host::getCartCacheDirectory() {
+    return "";
+}
+
 
 void Host::setUpPaletteColors(){
     _paletteColors[0] = COLOR_00;
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "../source/host.h"
+#include "../source/audioRingBuffer.h"
 
 class StubHost : public Host { 
     public:
     StubHost();      
     void stubInput(uint8_t kdown, uint8_t kheld);
+    //when enabled the vm renders audio into a ring, like the sdl2 hosts
+    void stubAudio(bool enabled);
+    AudioRingBuffer& audioRing();
 };
\ No newline at end of file
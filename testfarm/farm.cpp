@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "../source/host.h"
+#include "../source/vm.h"
+#include "../source/filehelpers.h"
+
+#include "farmhost.h"
+#include "workStealingPool.h"
+
+//headless regression farm. Runs every cart in a directory for a scripted
+//number of frames, with scripted input, spread over a thread pool with one
+//vm per cart, and compares a hash of the final frame with the expected one.
+//
+//usage: cartfarm [--threads n] [--frames n] [--record] [--json file] cartdir [hashfile]
+//
+//the hash file (cartdir/farmhashes.txt by default) has one cart per line:
+//
+//    <cart> <frames> <hash> [input script]
+//
+//a hash of - means none recorded yet. The input script is a comma separated
+//list of frame:buttons, each holding until the next one, with buttons from
+//lrudox (player 1) or - for none, e.g. 0:-,30:x,32:-,60:lu
+//
+//--record runs everything and writes the hashes back to the file, adding any
+//new carts with the default frame count. Otherwise the exit code is non zero
+//when any cart fails, errors or has no hash recorded yet.
+
+//rnd() seed for every cart, so runs are reproducible
+#define FARM_RNG_SEED 0x46414b45
+
+typedef chrono::steady_clock farmClock;
+
+enum FarmStatus {
+    Farm_Pass,
+    Farm_Fail,
+    Farm_New,
+    Farm_Error
+};
+
+struct InputStep {
+    int frame;
+    uint8_t buttons;
+};
+
+struct FarmCart {
+    string cart;
+    int frames;
+    string expectedHash;
+    string inputScript;
+    vector<InputStep> input;
+
+    FarmStatus status;
+    string hash;
+    string error;
+    int framesRun;
+    double loadMs;
+    double runMs;
+};
+
+static const char* statusNames[] = { "PASS", "FAIL", "NEW", "ERROR" };
+
+static double elapsedMs(farmClock::time_point start, farmClock::time_point end) {
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+static bool parseInputScript(string script, vector<InputStep>& steps) {
+    const char* buttonNames = "lrudox";
+    stringstream stream(script);
+    string step;
+
+    while (getline(stream, step, ',')) {
+        size_t colon = step.find(':');
+        if (colon == string::npos || colon == 0) {
+            return false;
+        }
+
+        InputStep inputStep;
+        inputStep.frame = atoi(step.substr(0, colon).c_str());
+        inputStep.buttons = 0;
+        for (char c : step.substr(colon + 1)) {
+            if (c == '-') {
+                continue;
+            }
+            const char* button = strchr(buttonNames, c);
+            if (button == nullptr) {
+                return false;
+            }
+            inputStep.buttons |= 1 << (button - buttonNames);
+        }
+
+        steps.push_back(inputStep);
+    }
+
+    sort(steps.begin(), steps.end(), [](const InputStep& a, const InputStep& b) {
+        return a.frame < b.frame;
+    });
+
+    return true;
+}
+
+static vector<FarmCart> readHashFile(string filename, string& error) {
+    vector<FarmCart> carts;
+    ifstream file(filename);
+    string line;
+    int lineNumber = 0;
+
+    while (getline(file, line)) {
+        lineNumber++;
+        if (line.length() > 0 && line[line.length() - 1] == '\r') {
+            line.pop_back();
+        }
+
+        stringstream stream(line);
+        FarmCart cart;
+        if (!(stream >> cart.cart) || cart.cart[0] == '#') {
+            continue;
+        }
+        if (!(stream >> cart.frames >> cart.expectedHash)) {
+            error = filename + ":" + to_string(lineNumber) + ": expected <cart> <frames> <hash>";
+            return carts;
+        }
+        stream >> cart.inputScript;
+        if (!parseInputScript(cart.inputScript, cart.input)) {
+            error = filename + ":" + to_string(lineNumber) + ": bad input script " + cart.inputScript;
+            return carts;
+        }
+        if (cart.expectedHash == "-") {
+            cart.expectedHash = "";
+        }
+
+        carts.push_back(cart);
+    }
+
+    return carts;
+}
+
+static bool writeHashFile(string filename, const vector<FarmCart>& carts) {
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "# cart frames hash [input script], written by cartfarm --record\n");
+    for (const FarmCart& cart : carts) {
+        string hash = cart.status == Farm_Error ? cart.expectedHash : cart.hash;
+        fprintf(file, "%s %d %s%s%s\n",
+            cart.cart.c_str(),
+            cart.frames,
+            hash.length() > 0 ? hash.c_str() : "-",
+            cart.inputScript.length() > 0 ? " " : "",
+            cart.inputScript.c_str());
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+static vector<string> listCartsInDirectory(string directory) {
+    vector<string> carts;
+
+    DIR *dir;
+    struct dirent *ent;
+    if ((dir = opendir(directory.c_str())) != NULL) {
+        while ((ent = readdir(dir)) != NULL) {
+            string name = ent->d_name;
+            if (isCartFile(name) && !isHiddenFile(name)) {
+                carts.push_back(name);
+            }
+        }
+        closedir(dir);
+    }
+
+    sort(carts.begin(), carts.end());
+
+    return carts;
+}
+
+//64 bit FNV-1a of the screen and the screen palette, i.e. what would be shown
+static string hashFrame(Vm* vm) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint8_t* buffers[] = { vm->GetPicoInteralFb(), vm->GetScreenPaletteMap() };
+    const size_t sizes[] = { 128 * 64, 16 };
+
+    for (int b = 0; b < 2; b++) {
+        for (size_t i = 0; i < sizes[b]; i++) {
+            hash ^= buffers[b][i];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
+}
+
+static void runCart(FarmCart* cart, string directory) {
+    cart->framesRun = 0;
+    cart->loadMs = 0;
+    cart->runMs = 0;
+
+    InputState_t input = {0, 0, 0, 0, 0, false, ""};
+    setScriptedInput(&input);
+
+    Host* host = new Host();
+    Vm* vm = new Vm(host);
+    vm->SetFixedRngSeed(FARM_RNG_SEED);
+
+    auto loadStart = farmClock::now();
+    vm->LoadCart(directory + "/" + cart->cart, false);
+    auto runStart = farmClock::now();
+    cart->error = vm->GetBiosError();
+
+    size_t nextStep = 0;
+    for (int i = 0; i < cart->frames && cart->error.length() == 0; i++) {
+        while (nextStep < cart->input.size() && cart->input[nextStep].frame <= i) {
+            uint8_t held = cart->input[nextStep].buttons;
+            input.KDown = held & ~input.KHeld;
+            input.KHeld = held;
+            nextStep++;
+        }
+
+        vm->UpdateAndDraw();
+        cart->framesRun++;
+        cart->error = vm->GetBiosError();
+
+        //a press only counts as down for one frame
+        input.KDown = 0;
+    }
+    auto runEnd = farmClock::now();
+
+    cart->loadMs = elapsedMs(loadStart, runStart);
+    cart->runMs = elapsedMs(runStart, runEnd);
+
+    if (cart->error.length() > 0) {
+        cart->status = Farm_Error;
+    }
+    else {
+        cart->hash = hashFrame(vm);
+        if (cart->expectedHash.length() == 0) {
+            cart->status = Farm_New;
+        }
+        else {
+            cart->status = cart->hash == cart->expectedHash ? Farm_Pass : Farm_Fail;
+        }
+    }
+
+    delete vm;
+    delete host;
+
+    setScriptedInput(nullptr);
+}
+
+static string jsonEscape(const string& str) {
+    string result;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        }
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            result += buf;
+        }
+        else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+static void writeJson(FILE* out, const vector<FarmCart>& carts, size_t threads, double wallMs) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"version\": \"%s\",\n", VER_STR);
+    fprintf(out, "  \"threads\": %zu,\n", threads);
+    fprintf(out, "  \"wall_ms\": %.2f,\n", wallMs);
+    fprintf(out, "  \"carts\": [\n");
+    for (size_t i = 0; i < carts.size(); i++) {
+        const FarmCart& cart = carts[i];
+        fprintf(out, "    { \"cart\": \"%s\", \"status\": \"%s\", \"frames\": %d, \"hash\": \"%s\", \"expected\": \"%s\", \"load_ms\": %.2f, \"run_ms\": %.2f, \"error\": \"%s\" }%s\n",
+            jsonEscape(cart.cart).c_str(),
+            statusNames[cart.status],
+            cart.framesRun,
+            cart.hash.c_str(),
+            jsonEscape(cart.expectedHash).c_str(),
+            cart.loadMs,
+            cart.runMs,
+            jsonEscape(cart.error).c_str(),
+            i == carts.size() - 1 ? "" : ",");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char* argv[]) {
+    size_t threads = 0;
+    int defaultFrames = 60;
+    bool record = false;
+    string jsonFile = "";
+    vector<string> positional;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            defaultFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--record") == 0) {
+            record = true;
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+        else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.size() == 0 || positional.size() > 2) {
+        fprintf(stderr, "usage: cartfarm [--threads n] [--frames n] [--record] [--json file] cartdir [hashfile]\n");
+        return 2;
+    }
+
+    string directory = positional[0];
+    string hashFile = positional.size() > 1 ? positional[1] : directory + "/farmhashes.txt";
+
+    string error = "";
+    vector<FarmCart> carts = readHashFile(hashFile, error);
+    if (error.length() > 0) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    //carts without a line yet run with the defaults
+    map<string, bool> listed;
+    for (const FarmCart& cart : carts) {
+        listed[cart.cart] = true;
+    }
+    for (string name : listCartsInDirectory(directory)) {
+        if (!listed[name]) {
+            FarmCart cart;
+            cart.cart = name;
+            cart.frames = defaultFrames;
+            carts.push_back(cart);
+        }
+    }
+
+    WorkStealingPool pool(threads);
+    for (FarmCart& cart : carts) {
+        FarmCart* cartPtr = &cart;
+        pool.add([cartPtr, directory]() {
+            runCart(cartPtr, directory);
+        });
+    }
+
+    auto wallStart = farmClock::now();
+    pool.run();
+    double wallMs = elapsedMs(wallStart, farmClock::now());
+
+    int counts[4] = {0, 0, 0, 0};
+    double cartMs = 0;
+    for (const FarmCart& cart : carts) {
+        counts[cart.status]++;
+        cartMs += cart.loadMs + cart.runMs;
+
+        printf("%-5s %-40s %4d frames %9.2f ms", statusNames[cart.status], cart.cart.c_str(), cart.framesRun, cart.loadMs + cart.runMs);
+        if (cart.status == Farm_Fail) {
+            printf("  expected %s got %s", cart.expectedHash.c_str(), cart.hash.c_str());
+        }
+        else if (cart.status == Farm_Error) {
+            string firstLine = cart.error.substr(0, cart.error.find('\n'));
+            printf("  %s", firstLine.c_str());
+        }
+        printf("\n");
+    }
+
+    printf("\n%zu carts: %d passed, %d failed, %d new, %d errors\n",
+        carts.size(), counts[Farm_Pass], counts[Farm_Fail], counts[Farm_New], counts[Farm_Error]);
+    printf("%.0f ms on %zu threads (%.0f ms of cart time)\n", wallMs, pool.threadCount(), cartMs);
+
+    if (jsonFile.length() > 0) {
+        FILE* out = fopen(jsonFile.c_str(), "w");
+        if (out == nullptr) {
+            fprintf(stderr, "could not open %s\n", jsonFile.c_str());
+            return 2;
+        }
+        writeJson(out, carts, pool.threadCount(), wallMs);
+        fclose(out);
+    }
+
+    if (record) {
+        if (!writeHashFile(hashFile, carts)) {
+            fprintf(stderr, "could not write %s\n", hashFile.c_str());
+            return 2;
+        }
+        printf("hashes written to %s\n", hashFile.c_str());
+        return 0;
+    }
+
+    if (counts[Farm_New] > 0) {
+        printf("carts without a hash count as failures, run with --record to write them\n");
+    }
+
+    return counts[Farm_Fail] + counts[Farm_Error] + counts[Farm_New] > 0 ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../source/hostVmShared.h"
+
+//sets the input Host::scanInput returns on the calling thread, nullptr for
+//no buttons. The pointer must stay valid while the thread's vm runs
+void setScriptedInput(const InputState_t* input);
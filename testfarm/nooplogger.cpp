@@ -0,0 +1,25 @@
+#include <strings.h>
+#include <stdarg.h>
+
+#include "logger.h"
+
+
+void Logger_Initialize()
+{
+}
+
+void Logger_LogOutput(const char * func, size_t line, const char * format, ...)
+{
+}
+
+void Logger_Write(const char * format, ...)
+{
+}
+
+void Logger_WriteUnformatted(const char * message)
+{
+}
+
+void Logger_Exit()
+{
+}
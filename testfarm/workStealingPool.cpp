@@ -0,0 +1,76 @@
+#include <thread>
+
+#include "workStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(size_t threadCount) :
+    _nextQueue(0)
+{
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        _queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+}
+
+size_t WorkStealingPool::threadCount() const {
+    return _queues.size();
+}
+
+void WorkStealingPool::add(std::function<void()> job) {
+    WorkerQueue& queue = *_queues[_nextQueue];
+    _nextQueue = (_nextQueue + 1) % _queues.size();
+
+    std::lock_guard<std::mutex> guard(queue.lock);
+    queue.jobs.push_back(job);
+}
+
+bool WorkStealingPool::popLocal(size_t worker, std::function<void()>& job) {
+    WorkerQueue& queue = *_queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.jobs.empty()) {
+        return false;
+    }
+
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t worker, std::function<void()>& job) {
+    for (size_t i = 1; i < _queues.size(); i++) {
+        WorkerQueue& queue = *_queues[(worker + i) % _queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (!queue.jobs.empty()) {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::workerLoop(size_t worker) {
+    std::function<void()> job;
+
+    //no job adds more jobs, so once every queue is empty the worker is done
+    while (popLocal(worker, job) || steal(worker, job)) {
+        job();
+    }
+}
+
+void WorkStealingPool::run() {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < _queues.size(); i++) {
+        threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//runs a fixed batch of jobs on a set of threads. Jobs are dealt out round
+//robin up front; each worker takes from the back of its own queue and, once
+//that is empty, steals from the front of the others. Carts vary a lot in how
+//long they take, so a worker stuck on a slow cart doesn't hold up the jobs
+//that were dealt to it
+class WorkStealingPool {
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    size_t _nextQueue;
+
+    bool popLocal(size_t worker, std::function<void()>& job);
+    bool steal(size_t worker, std::function<void()>& job);
+    void workerLoop(size_t worker);
+
+    public:
+    //threadCount 0 uses one thread per hardware thread
+    WorkStealingPool(size_t threadCount = 0);
+
+    size_t threadCount() const;
+
+    void add(std::function<void()> job);
+
+    //runs every added job and returns once all have finished
+    void run();
+};